@@ -6,6 +6,18 @@ const std = @import("std");
 // for defining build steps and express dependencies between them, allowing the
 // build runner to parallelize the build automatically (and the cache system to
 // know when a step doesn't need to be re-run).
+const cpp_flags: []const []const u8 = &.{
+    "-std=c++23",
+    "-Wall",
+    "-Wextra",
+    "-DVULKAN_HPP_NO_STRUCT_CONSTRUCTORS",
+    "-DVULKAN_HPP_DISPATCH_LOADER_DYNAMIC=1",
+    "-Wno-nullability-completeness",
+    "-Wno-nullability-extension",
+    "-Wno-unused-private-field",
+    "-Wno-unknown-pragmas",
+};
+
 pub fn build(b: *std.Build) void {
     const target = b.standardTargetOptions(.{});
     const optimize = b.standardOptimizeOption(.{});
@@ -21,32 +33,33 @@ pub fn build(b: *std.Build) void {
             "src/main.cpp",
 
             "src/camera/camera.cpp",
+            "src/camera/camerapath.cpp",
 
             "src/screen/computescreen.cpp",
+            "src/screen/governor.cpp",
 
+            "src/tree/raycast.cpp",
             "src/tree/tree.cpp",
+            "src/tree/tree_bake.cpp",
+            "src/tree/tree_edit.cpp",
+            "src/tree/tree_budget.cpp",
+            "src/tree/tree_gpu.cpp",
             "src/tree/tree_stale.cpp",
             "src/tree/tree_util.cpp",
+            "src/tree/treebuild.cpp",
+            "src/tree/treeedit.cpp",
 
             "src/uniforms/frame.cpp",
             "src/uniforms/render.cpp",
 
             "src/vulkan/context.cpp",
             "src/vulkan/pipeline.cpp",
+            "src/vulkan/pipelinecache.cpp",
+            "src/vulkan/profiler.cpp",
             "src/vulkan/swapchain.cpp",
             "src/vulkan/sync.cpp",
         },
-        .flags = &.{
-            "-std=c++23",
-            "-Wall",
-            "-Wextra",
-            "-DVULKAN_HPP_NO_STRUCT_CONSTRUCTORS",
-            "-DVULKAN_HPP_DISPATCH_LOADER_DYNAMIC=1",
-            "-Wno-nullability-completeness",
-            "-Wno-nullability-extension",
-            "-Wno-unused-private-field",
-            "-Wno-unknown-pragmas",
-        },
+        .flags = cpp_flags,
     });
 
     // Link C++ standard library
@@ -137,12 +150,36 @@ pub fn build(b: *std.Build) void {
         "spirv_1_4",
         "-emit-spirv-directly",
         "-fvk-use-entrypoint-name",
+        // images without a [format] are written without one, for BGRA swapchain images
+        "-default-image-format-unknown",
         "-entry",
         "vertMain",
         "-entry",
         "fragMain",
         "-entry",
         "computeMain",
+        "-entry",
+        "foveaResolve",
+        "-entry",
+        "checkerboardResolve",
+        "-entry",
+        "reprojectStartDistances",
+        "-entry",
+        "coneStartDistances",
+        "-entry",
+        "lightingShadows",
+        "-entry",
+        "lightingResolve",
+        "-entry",
+        "lightingShadowQueue",
+        "-entry",
+        "computePersistent",
+        "-entry",
+        "stepHeatmap",
+        "-entry",
+        "cullLights",
+        "-entry",
+        "presentToSwapchain",
         "-o",
         shader_output_path,
     });
@@ -155,6 +192,44 @@ pub fn build(b: *std.Build) void {
 
     shader_cmd.step.dependOn(&ensure_dir.step);
     compile_shaders.dependOn(&shader_cmd.step);
+
+    // The compute shader tree build, its own module so the main shader doesn't carry its bindings
+    const tree_build_shader_cmd = b.addSystemCommand(&.{slangc_path});
+    tree_build_shader_cmd.addArgs(&.{
+        "src/shaders/treebuild.slang",
+        "-target",
+        "spirv",
+        "-profile",
+        "spirv_1_4",
+        "-emit-spirv-directly",
+        "-fvk-use-entrypoint-name",
+        "-entry",
+        "seedTreeBuild",
+        "-entry",
+        "buildTreeLevel",
+        "-o",
+        b.pathJoin(&.{ b.install_prefix, "bin", "shaders", "treebuild.spv" }),
+    });
+    tree_build_shader_cmd.step.dependOn(&ensure_dir.step);
+    compile_shaders.dependOn(&tree_build_shader_cmd.step);
+
+    // Edits applied to the tree's buffers in place, its own module for the same reason
+    const tree_edit_shader_cmd = b.addSystemCommand(&.{slangc_path});
+    tree_edit_shader_cmd.addArgs(&.{
+        "src/shaders/treeedit.slang",
+        "-target",
+        "spirv",
+        "-profile",
+        "spirv_1_4",
+        "-emit-spirv-directly",
+        "-fvk-use-entrypoint-name",
+        "-entry",
+        "applyEdit",
+        "-o",
+        b.pathJoin(&.{ b.install_prefix, "bin", "shaders", "treeedit.spv" }),
+    });
+    tree_edit_shader_cmd.step.dependOn(&ensure_dir.step);
+    compile_shaders.dependOn(&tree_edit_shader_cmd.step);
     b.getInstallStep().dependOn(compile_shaders);
 
     // Install the executable
@@ -172,6 +247,277 @@ pub fn build(b: *std.Build) void {
     const run_step = b.step("run", "Run the application");
     run_step.dependOn(&run_cmd.step);
 
+    // Headless CPU benchmark, runs computeCPU from cpu.slang compiled to C++ (see src/bench)
+    const cpu_shader_cmd = b.addSystemCommand(&.{slangc_path});
+    cpu_shader_cmd.addArgs(&.{
+        "src/shaders/cpu.slang",
+        "-target",
+        "cpp",
+        "-entry",
+        "computeCPU",
+        "-stage",
+        "compute",
+        "-o",
+    });
+    const cpu_shader_source = cpu_shader_cmd.addOutputFileArg("shader_cpu.cpp");
+
+    const bench = b.addExecutable(.{ .name = "AftermathCPUBench", .root_module = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+    }) });
+
+    bench.addCSourceFiles(.{
+        .files = &.{
+            "src/bench/cpubench.cpp",
+
+            "src/tree/tree.cpp",
+            "src/tree/tree_bake.cpp",
+            "src/tree/tree_edit.cpp",
+            "src/tree/tree_budget.cpp",
+            "src/tree/tree_stale.cpp",
+            "src/tree/tree_util.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    // generated code, warnings aren't ours to fix
+    bench.addCSourceFile(.{ .file = cpu_shader_source, .flags = &.{"-std=c++23"} });
+    bench.linkLibCpp();
+
+    // the tree sources include vma & vulkan headers, the slang C++ prelude lives in the SDK include dir
+    if (vulkan_sdk) |sdk| {
+        bench.addLibraryPath(.{ .cwd_relative = b.fmt("{s}/Lib", .{sdk}) });
+        bench.addIncludePath(.{ .cwd_relative = b.fmt("{s}/Include", .{sdk}) });
+        bench.addIncludePath(.{ .cwd_relative = b.fmt("{s}/include", .{sdk}) });
+    }
+    bench.addLibraryPath(.{ .cwd_relative = b.fmt("{s}/lib", .{vcpkg_path}) });
+    bench.addIncludePath(.{ .cwd_relative = b.fmt("{s}/include", .{vcpkg_path}) });
+    bench.linkSystemLibrary(vulkan_lib_name);
+
+    const install_bench = b.addInstallArtifact(bench, .{});
+
+    const bench_cmd = b.addRunArtifact(bench);
+    bench_cmd.step.dependOn(&install_bench.step);
+    if (b.args) |args| {
+        bench_cmd.addArgs(args);
+    }
+
+    const bench_step = b.step("cpu-bench", "Run the ray marching shader on the CPU & print timings");
+    bench_step.dependOn(&bench_cmd.step);
+
+    // RayCaster against raymarch() from the shaders, raymarchCPU in cpu.slang compiled to C++
+    const raymarch_shader_cmd = b.addSystemCommand(&.{slangc_path});
+    raymarch_shader_cmd.addArgs(&.{
+        "src/shaders/cpu.slang",
+        "-target",
+        "cpp",
+        "-entry",
+        "raymarchCPU",
+        "-stage",
+        "compute",
+        "-o",
+    });
+    const raymarch_shader_source = raymarch_shader_cmd.addOutputFileArg("shader_raymarch_cpu.cpp");
+
+    const raycast_test = b.addExecutable(.{ .name = "AftermathRaycastTest", .root_module = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+    }) });
+
+    raycast_test.addCSourceFiles(.{
+        .files = &.{
+            "src/tree/raycast_test.cpp",
+            "src/tree/raycast.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    // generated code, warnings aren't ours to fix
+    raycast_test.addCSourceFile(.{ .file = raymarch_shader_source, .flags = &.{"-std=c++23"} });
+    raycast_test.linkLibCpp();
+
+    // the tree headers include vma & vulkan headers, the slang C++ prelude lives in the SDK include dir
+    if (vulkan_sdk) |sdk| {
+        raycast_test.addIncludePath(.{ .cwd_relative = b.fmt("{s}/Include", .{sdk}) });
+        raycast_test.addIncludePath(.{ .cwd_relative = b.fmt("{s}/include", .{sdk}) });
+    }
+    raycast_test.addIncludePath(.{ .cwd_relative = b.fmt("{s}/include", .{vcpkg_path}) });
+
+    const raycast_test_cmd = b.addRunArtifact(raycast_test);
+
+    const raycast_test_step = b.step("raycast-test", "Check the CPU ray caster against the shader's raymarch()");
+    raycast_test_step.dependOn(&raycast_test_cmd.step);
+
+    // Channel against RingChannel (src/util) with 1 to 64 producers & consumers, header only
+    const channel_bench = b.addExecutable(.{ .name = "AftermathChannelBench", .root_module = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+    }) });
+    channel_bench.addCSourceFiles(.{
+        .files = &.{"src/bench/channelbench.cpp"},
+        .flags = cpp_flags,
+    });
+    channel_bench.linkLibCpp();
+
+    const install_channel_bench = b.addInstallArtifact(channel_bench, .{});
+
+    const channel_bench_cmd = b.addRunArtifact(channel_bench);
+    channel_bench_cmd.step.dependOn(&install_channel_bench.step);
+    if (b.args) |args| {
+        channel_bench_cmd.addArgs(args);
+    }
+
+    const channel_bench_step = b.step("channel-bench", "Compare Channel & RingChannel throughput & print it");
+    channel_bench_step.dependOn(&channel_bench_cmd.step);
+
+    // TaskGraph & Scheduler (src/util/task.hpp), header only
+    const task_test = b.addExecutable(.{ .name = "AftermathTaskTest", .root_module = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+    }) });
+    task_test.addCSourceFiles(.{
+        .files = &.{"src/util/task_test.cpp"},
+        .flags = cpp_flags,
+    });
+    task_test.linkLibCpp();
+
+    const task_test_cmd = b.addRunArtifact(task_test);
+
+    const task_test_step = b.step("task-test", "Check the task graph's stage order, cancel, exceptions & main thread stages");
+    task_test_step.dependOn(&task_test_cmd.step);
+
+    // Headless GPU benchmark, renders the compute passes offscreen without a window (see src/bench).
+    // Runs on lavapipe, for machines without a GPU
+    const gpu_bench = b.addExecutable(.{ .name = "AftermathGPUBench", .root_module = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+    }) });
+
+    gpu_bench.addCSourceFiles(.{
+        .files = &.{
+            "src/bench/gpubench.cpp",
+
+            "src/camera/camerapath.cpp",
+
+            "src/screen/computescreen.cpp",
+
+            "src/tree/tree.cpp",
+            "src/tree/tree_bake.cpp",
+            "src/tree/tree_edit.cpp",
+            "src/tree/tree_budget.cpp",
+            "src/tree/tree_gpu.cpp",
+            "src/tree/tree_stale.cpp",
+            "src/tree/tree_util.cpp",
+            "src/tree/treebuild.cpp",
+            "src/tree/treeedit.cpp",
+
+            "src/uniforms/frame.cpp",
+            "src/uniforms/render.cpp",
+
+            "src/vulkan/context.cpp",
+            "src/vulkan/pipeline.cpp",
+            "src/vulkan/profiler.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    gpu_bench.linkLibCpp();
+
+    if (vulkan_sdk) |sdk| {
+        gpu_bench.addLibraryPath(.{ .cwd_relative = b.fmt("{s}/Lib", .{sdk}) });
+        gpu_bench.addIncludePath(.{ .cwd_relative = b.fmt("{s}/Include", .{sdk}) });
+    }
+    gpu_bench.addLibraryPath(.{ .cwd_relative = b.fmt("{s}/lib", .{vcpkg_path}) });
+    gpu_bench.addIncludePath(.{ .cwd_relative = b.fmt("{s}/include", .{vcpkg_path}) });
+    gpu_bench.linkSystemLibrary(vulkan_lib_name);
+    // the context still links against GLFW, it's never initialized in headless mode
+    gpu_bench.linkSystemLibrary("glfw3");
+
+    const install_gpu_bench = b.addInstallArtifact(gpu_bench, .{});
+
+    const gpu_bench_cmd = b.addRunArtifact(gpu_bench);
+    gpu_bench_cmd.step.dependOn(&install_gpu_bench.step);
+    gpu_bench_cmd.step.dependOn(compile_shaders);
+    gpu_bench_cmd.setCwd(.{ .cwd_relative = "zig-out/bin" });
+    if (b.args) |args| {
+        gpu_bench_cmd.addArgs(args);
+    }
+
+    const gpu_bench_step = b.step("gpu-bench", "Render the compute passes offscreen without a window & print timings");
+    gpu_bench_step.dependOn(&gpu_bench_cmd.step);
+
+    // Compares the compute shader tree build with the CPU one, headless so it runs on lavapipe
+    const tree_gpu_test = b.addExecutable(.{ .name = "AftermathTreeGPUTest", .root_module = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+    }) });
+
+    tree_gpu_test.addCSourceFiles(.{
+        .files = &.{
+            "src/tree/tree_gpu_test.cpp",
+
+            "src/tree/tree.cpp",
+            "src/tree/tree_edit.cpp",
+            "src/tree/tree_budget.cpp",
+            "src/tree/tree_gpu.cpp",
+            "src/tree/tree_stale.cpp",
+            "src/tree/tree_util.cpp",
+            "src/tree/treebuild.cpp",
+            "src/tree/treeedit.cpp",
+
+            "src/vulkan/context.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    tree_gpu_test.linkLibCpp();
+
+    if (vulkan_sdk) |sdk| {
+        tree_gpu_test.addLibraryPath(.{ .cwd_relative = b.fmt("{s}/Lib", .{sdk}) });
+        tree_gpu_test.addIncludePath(.{ .cwd_relative = b.fmt("{s}/Include", .{sdk}) });
+    }
+    tree_gpu_test.addLibraryPath(.{ .cwd_relative = b.fmt("{s}/lib", .{vcpkg_path}) });
+    tree_gpu_test.addIncludePath(.{ .cwd_relative = b.fmt("{s}/include", .{vcpkg_path}) });
+    tree_gpu_test.linkSystemLibrary(vulkan_lib_name);
+    tree_gpu_test.linkSystemLibrary("glfw3");
+
+    const install_tree_gpu_test = b.addInstallArtifact(tree_gpu_test, .{});
+
+    const tree_gpu_test_cmd = b.addRunArtifact(tree_gpu_test);
+    tree_gpu_test_cmd.step.dependOn(&install_tree_gpu_test.step);
+    tree_gpu_test_cmd.step.dependOn(compile_shaders);
+    tree_gpu_test_cmd.setCwd(.{ .cwd_relative = "zig-out/bin" });
+
+    const tree_gpu_test_step = b.step("tree-gpu-test", "Check the compute shader tree build & edits against the CPU");
+    tree_gpu_test_step.dependOn(&tree_gpu_test_cmd.step);
+
+    // Feeds FrameGovernor synthetic frame times, no GPU needed
+    const governor_test = b.addExecutable(.{ .name = "AftermathGovernorTest", .root_module = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+    }) });
+
+    governor_test.addCSourceFiles(.{
+        .files = &.{
+            "src/screen/governor_test.cpp",
+            "src/screen/governor.cpp",
+
+            "src/uniforms/render.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    governor_test.linkLibCpp();
+
+    // render.cpp holds the presets next to their uniform buffers, so this links vulkan & vma too
+    if (vulkan_sdk) |sdk| {
+        governor_test.addLibraryPath(.{ .cwd_relative = b.fmt("{s}/Lib", .{sdk}) });
+        governor_test.addIncludePath(.{ .cwd_relative = b.fmt("{s}/Include", .{sdk}) });
+    }
+    governor_test.addLibraryPath(.{ .cwd_relative = b.fmt("{s}/lib", .{vcpkg_path}) });
+    governor_test.addIncludePath(.{ .cwd_relative = b.fmt("{s}/include", .{vcpkg_path}) });
+    governor_test.linkSystemLibrary(vulkan_lib_name);
+
+    const governor_test_cmd = b.addRunArtifact(governor_test);
+
+    const governor_test_step = b.step("governor-test", "Check the frame time governor settles without oscillating");
+    governor_test_step.dependOn(&governor_test_cmd.step);
+
     // Generate compile_commands.json
     generateCompileCommands(b, target) catch |err| {
         std.debug.print("Failed to generate compile_commands.json: {}\n", .{err});
@@ -221,16 +567,34 @@ fn generateCompileCommands(b: *std.Build, target: std.Build.ResolvedTarget) !voi
     const sources = [_][]const u8{
         "src/main.cpp",
         "src/camera/camera.cpp",
+        "src/camera/camerapath.cpp",
         "src/screen/computescreen.cpp",
+        "src/screen/governor.cpp",
+        "src/tree/raycast.cpp",
         "src/tree/tree.cpp",
+        "src/tree/tree_bake.cpp",
+        "src/tree/tree_edit.cpp",
+        "src/tree/tree_budget.cpp",
+        "src/tree/tree_gpu.cpp",
         "src/tree/tree_stale.cpp",
         "src/tree/tree_util.cpp",
+        "src/tree/treebuild.cpp",
+        "src/tree/treeedit.cpp",
         "src/uniforms/frame.cpp",
         "src/uniforms/render.cpp",
         "src/vulkan/context.cpp",
         "src/vulkan/pipeline.cpp",
+        "src/vulkan/pipelinecache.cpp",
+        "src/vulkan/profiler.cpp",
         "src/vulkan/swapchain.cpp",
         "src/vulkan/sync.cpp",
+        "src/bench/cpubench.cpp",
+        "src/bench/gpubench.cpp",
+        "src/bench/channelbench.cpp",
+        "src/tree/tree_gpu_test.cpp",
+        "src/tree/raycast_test.cpp",
+        "src/screen/governor_test.cpp",
+        "src/util/task_test.cpp",
     };
 
     var compile_commands = try std.ArrayList(u8).initCapacity(b.allocator, 4096);
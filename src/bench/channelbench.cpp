@@ -0,0 +1,209 @@
+#include "../util/channel.hpp"
+#include "../util/ring.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Throughput of Channel & RingChannel with the producer & consumer counts of a thread pool, every producer
+// sends its share of the items in batches with sendMany, the consumers take them until the queue is closed.
+// Checks every item arrived exactly once.
+
+struct BenchOptions {
+    uint64_t items = 1 << 22;
+    uint32_t batch = 64;
+    uint32_t capacity = 1024;
+    uint32_t maxThreads = 64;
+    uint32_t runs = 3;
+};
+
+static void printUsage() {
+    std::cout << "usage: AftermathChannelBench [options]\n"
+        << "  --items <n>          items sent per run (default 4194304)\n"
+        << "  --batch <n>          items per sendMany & receiveMany (default 64)\n"
+        << "  --capacity <n>       RingChannel capacity, rounded up to a power of 2 (default 1024)\n"
+        << "  --max-threads <n>    most producers & consumers (default 64)\n"
+        << "  --runs <n>           runs per configuration, the fastest counts (default 3)\n";
+}
+
+static BenchOptions parseOptions(int argc, char** argv) {
+    BenchOptions options;
+
+    auto next = [&](int& i) -> std::string {
+        if (i + 1 >= argc) {
+            throw std::runtime_error(std::string("missing value for ") + argv[i]);
+        }
+        return argv[++i];
+    };
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--items") options.items = std::stoull(next(i));
+        else if (arg == "--batch") options.batch = std::stoul(next(i));
+        else if (arg == "--capacity") options.capacity = std::stoul(next(i));
+        else if (arg == "--max-threads") options.maxThreads = std::stoul(next(i));
+        else if (arg == "--runs") options.runs = std::stoul(next(i));
+        else if (arg == "--help" || arg == "-h") {
+            printUsage();
+            std::exit(EXIT_SUCCESS);
+        }
+        else {
+            printUsage();
+            throw std::runtime_error("unknown option: " + arg);
+        }
+    }
+
+    if (options.items == 0 || options.batch == 0 || options.capacity == 0 || options.maxThreads == 0 || options.runs == 0) {
+        throw std::runtime_error("items, batch, capacity, max-threads & runs must be larger than 0");
+    }
+
+    return options;
+}
+
+// Channel has no batch receive, its consumers take one item at a time the way the tree's workers do
+struct ChannelQueue {
+    Channel<uint64_t> channel;
+
+    explicit ChannelQueue(const BenchOptions&) {}
+    void sendMany(const std::vector<uint64_t>& values) { channel.sendMany(values); }
+    size_t receiveMany(std::vector<uint64_t>& out, size_t) {
+        uint64_t value;
+        if (!channel.receive(value)) {
+            return 0;
+        }
+        out.push_back(value);
+        return 1;
+    }
+    void close() { channel.close(); }
+};
+
+struct RingQueue {
+    RingChannel<uint64_t> ring;
+
+    explicit RingQueue(const BenchOptions& options) : ring(options.capacity) {}
+    void sendMany(const std::vector<uint64_t>& values) { ring.sendMany(values); }
+    size_t receiveMany(std::vector<uint64_t>& out, size_t max) { return ring.receiveMany(out, max); }
+    void close() { ring.close(); }
+};
+
+// Millions of items per second of one run, throws if an item got lost or duplicated
+template <typename Queue>
+static double runOnce(const BenchOptions& options, uint32_t producers, uint32_t consumers) {
+    Queue queue(options);
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<bool> start{false};
+
+    std::vector<std::thread> consumerThreads;
+    for (uint32_t c = 0; c < consumers; c++) {
+        consumerThreads.emplace_back([&]() {
+            std::vector<uint64_t> values;
+            values.reserve(options.batch);
+            uint64_t count = 0, total = 0;
+            for (;;) {
+                values.clear();
+                if (queue.receiveMany(values, options.batch) == 0) {
+                    break;
+                }
+                for (uint64_t value : values) {
+                    total += value;
+                }
+                count += values.size();
+            }
+            received += count;
+            sum += total;
+        });
+    }
+
+    std::vector<std::thread> producerThreads;
+    for (uint32_t p = 0; p < producers; p++) {
+        producerThreads.emplace_back([&, p]() {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            std::vector<uint64_t> values;
+            values.reserve(options.batch);
+            // items 1..n, every producer sends those with its index modulo the producer count
+            for (uint64_t item = p + 1; item <= options.items; item += producers) {
+                values.push_back(item);
+                if (values.size() == options.batch) {
+                    queue.sendMany(values);
+                    values.clear();
+                }
+            }
+            if (!values.empty()) {
+                queue.sendMany(values);
+            }
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (std::thread& thread : producerThreads) {
+        thread.join();
+    }
+    queue.close();
+    for (std::thread& thread : consumerThreads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    uint64_t expectedSum = options.items * (options.items + 1) / 2;
+    if (received != options.items || sum != expectedSum) {
+        throw std::runtime_error("received " + std::to_string(received.load()) + " of " +
+            std::to_string(options.items) + " items, with the wrong sum");
+    }
+    return double(options.items) / seconds / 1e6;
+}
+
+template <typename Queue>
+static double runBest(const BenchOptions& options, uint32_t producers, uint32_t consumers) {
+    double best = 0.0;
+    for (uint32_t run = 0; run < options.runs; run++) {
+        best = std::max(best, runOnce<Queue>(options, producers, consumers));
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    try {
+        BenchOptions options = parseOptions(argc, argv);
+
+        // as many producers as consumers, & one of either against many of the other
+        std::vector<std::pair<uint32_t, uint32_t>> configurations;
+        for (uint32_t n = 1; n <= options.maxThreads; n *= 2) {
+            configurations.push_back({ n, n });
+            if (n > 1) {
+                configurations.push_back({ 1, n });
+                configurations.push_back({ n, 1 });
+            }
+        }
+
+        std::cout << options.items << " items, batches of " << options.batch << ", ring capacity "
+            << RingChannel<uint64_t>(options.capacity).capacity() << ", "
+            << std::thread::hardware_concurrency() << " cores" << std::endl;
+        std::cout << "producers consumers   Channel Mitems/s   RingChannel Mitems/s   speedup" << std::endl;
+        for (auto [producers, consumers] : configurations) {
+            double channel = runBest<ChannelQueue>(options, producers, consumers);
+            double ring = runBest<RingQueue>(options, producers, consumers);
+            std::cout << std::setw(9) << producers << std::setw(10) << consumers
+                << std::fixed << std::setprecision(2)
+                << std::setw(21) << channel << std::setw(23) << ring << std::setw(9) << ring / channel << "x"
+                << std::endl;
+        }
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,422 @@
+// Headless CPU benchmark for the ray marching compute pass.
+//
+// Runs computeCPU from shaders/cpu.slang (compiled to C++ by slangc, see the `cpu-bench` step in build.zig)
+// over a baked tree, tiled across worker threads. Writes the image & per-pixel step counts, and prints
+// deterministic step counts & time per frame, so ray march regressions show up without a GPU.
+
+#define VMA_IMPLEMENTATION
+#include "vma/vk_mem_alloc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../tree/tree.hpp"
+#include "../util/channel.hpp"
+#include "../util/waitgroup.hpp"
+
+// Host side view of the shader parameters, in the layout Slang uses for CPU targets:
+// StructuredBuffer<T> is { T* data; size_t count; }, ConstantBuffer<T> is a T*,
+// vectors are tightly packed. Field order must match the globals in cpu.slang.
+template <typename T>
+struct CPUBuffer {
+    T* data;
+    size_t count;
+};
+
+struct CPUFrameUniforms {
+    float time;
+    float aperture;
+    float focusDistance;
+    float fov;
+    float cameraPosition[3];
+    float cameraDirection[3];
+    float foveaCenter[2];
+    float foveaRadius;
+    float foveaFalloff;
+    uint32_t foveaLevels;
+    uint32_t frameNumber;
+    uint32_t checkerboard;
+    float previousCameraPosition[3];
+    float previousCameraDirection[3];
+    uint32_t renderSize[2];
+    uint32_t reprojectStart;
+    uint32_t coneStart;
+    uint32_t lightingScale;
+    uint32_t wavefront;
+    uint32_t stepHeatmap;
+    uint32_t lightCount;
+    // pointers are plain pointers on CPU targets
+    const TreeNode* treeNodes;
+    const TreeLeaf* treeLeaves;
+};
+
+// RenderUniforms in shading.slang
+struct CPURenderUniforms {
+    float maxDistance;
+    float epsilon;
+    float shadowMaxDistance;
+    float shadowBias;
+};
+
+struct CPUDispatch {
+    uint32_t width;
+    uint32_t height;
+};
+
+struct CPUColor {
+    float r, g, b, a;
+};
+
+struct CPUShaderGlobals {
+    const CPUFrameUniforms* frameUniforms;
+    const CPURenderUniforms* renderUniforms;
+    const CPUDispatch* dispatch;
+    CPUBuffer<CPUColor> outputColor;
+    CPUBuffer<uint32_t> outputSteps;
+    CPUBuffer<float> outputDepth;
+    CPUBuffer<float> outputAO;
+    CPUBuffer<const float> startDistances;
+};
+
+// ComputeVaryingInput from slang-cpp-types.h, the range of workgroups to run
+struct CPUVaryingInput {
+    uint32_t startGroupID[3];
+    uint32_t endGroupID[3];
+};
+
+extern "C" void computeCPU(CPUVaryingInput* varyingInput, void* entryPointParams, void* globalParams);
+
+static const uint32_t groupSize = 16; // [numthreads(16, 16, 1)] in cpu.slang
+
+struct BenchOptions {
+    std::string treePath;
+    std::string bakePath;
+    std::string outputPrefix = "cpubench";
+    uint32_t width = 640;
+    uint32_t height = 360;
+    uint32_t frames = 10;
+    unsigned int threads = 0;
+    float cameraPosition[3] = { 0.0f, 0.0f, 0.0f };
+    float cameraDirection[3] = { 1.0f, 0.0f, 0.0f };
+    bool reprojectStart = false;
+};
+
+static void printUsage() {
+    std::cout << "usage: AftermathCPUBench [options]\n"
+        << "  --tree <file>        load a baked tree instead of generating one\n"
+        << "  --bake <file>        save the generated tree, for use with --tree\n"
+        << "  --width <px>         image width (default 640)\n"
+        << "  --height <px>        image height (default 360)\n"
+        << "  --frames <n>         frames to render (default 10)\n"
+        << "  --threads <n>        worker threads (default: all cores)\n"
+        << "  --camera x y z dx dy dz\n"
+        << "  --reproject-start    start every frame's rays at the previous frame's depth, & check the ambient\n"
+        << "                       occlusion matches the first frame's, which marched the whole rays\n"
+        << "  --out <prefix>       output prefix for <prefix>.ppm & <prefix>_steps.pgm\n";
+}
+
+// What reprojectStartDistances & startDistanceBound in the shaders compute, for a camera that doesn't move:
+// every pixel starts a bit before the nearest depth of the 3x3 pixels around it in the previous frame.
+static void computeStartDistances(const std::vector<float>& depth, std::vector<float>& start, uint32_t width, uint32_t height) {
+    const float safety = 0.9f; // START_DISTANCE_SAFETY in reprojection.slang
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            float nearest = depth[y * width + x];
+            for (uint32_t ny = (y > 0 ? y - 1 : y); ny <= std::min(y + 1, height - 1); ny++) {
+                for (uint32_t nx = (x > 0 ? x - 1 : x); nx <= std::min(x + 1, width - 1); nx++) {
+                    nearest = std::min(nearest, depth[ny * width + nx]);
+                }
+            }
+            start[y * width + x] = nearest * safety;
+        }
+    }
+}
+
+// Start distances only skip empty space, so the last frame must shade like the first, which marched every ray
+// from the camera. Compares the ambient occlusion of the pixels that hit the same surface in both, a few may
+// differ where the hit lies on a voxel boundary & the AO samples land in the neighbouring voxel
+static void checkStartAO(const std::vector<float>& fullDepth, const std::vector<float>& fullAO,
+    const std::vector<float>& startDepth, const std::vector<float>& startAO) {
+    const float depthTolerance = 0.001f; // relative
+    const float aoTolerance = 0.01f;
+    const double maxMismatchFraction = 0.005;
+
+    size_t compared = 0, mismatched = 0;
+    float maxDifference = 0.0f;
+    for (size_t i = 0; i < fullDepth.size(); i++) {
+        if (std::abs(startDepth[i] - fullDepth[i]) > depthTolerance * std::max(fullDepth[i], 1.0f)) {
+            continue;
+        }
+        compared++;
+        float difference = std::abs(startAO[i] - fullAO[i]);
+        maxDifference = std::max(maxDifference, difference);
+        if (difference > aoTolerance) {
+            mismatched++;
+        }
+    }
+
+    std::cout << "start AO:     " << mismatched << " of " << compared << " pixels differ by more than " << aoTolerance
+        << " from full rays, max " << maxDifference << std::endl;
+    if (compared == 0 || double(mismatched) > maxMismatchFraction * double(compared)) {
+        throw std::runtime_error("ambient occlusion with start distances doesn't match the full rays");
+    }
+}
+
+static BenchOptions parseOptions(int argc, char** argv) {
+    BenchOptions options;
+
+    auto next = [&](int& i) -> std::string {
+        if (i + 1 >= argc) {
+            throw std::runtime_error(std::string("missing value for ") + argv[i]);
+        }
+        return argv[++i];
+    };
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tree") options.treePath = next(i);
+        else if (arg == "--bake") options.bakePath = next(i);
+        else if (arg == "--out") options.outputPrefix = next(i);
+        else if (arg == "--width") options.width = std::stoul(next(i));
+        else if (arg == "--height") options.height = std::stoul(next(i));
+        else if (arg == "--frames") options.frames = std::stoul(next(i));
+        else if (arg == "--threads") options.threads = std::stoul(next(i));
+        else if (arg == "--camera") {
+            for (float& v : options.cameraPosition) v = std::stof(next(i));
+            for (float& v : options.cameraDirection) v = std::stof(next(i));
+        }
+        else if (arg == "--reproject-start") options.reprojectStart = true;
+        else if (arg == "--help" || arg == "-h") {
+            printUsage();
+            std::exit(EXIT_SUCCESS);
+        }
+        else {
+            printUsage();
+            throw std::runtime_error("unknown option: " + arg);
+        }
+    }
+
+    if (options.width == 0 || options.height == 0 || options.frames == 0) {
+        throw std::runtime_error("width, height & frames must be larger than 0");
+    }
+
+    return options;
+}
+
+// Runs one dispatch of computeCPU, one 16x16 workgroup per tile, tiles handed out to the workers
+class TiledDispatcher {
+public:
+    TiledDispatcher(CPUShaderGlobals* globals, uint32_t groupsX, uint32_t groupsY, unsigned int numThreads)
+        : globals(globals)
+        , groupsX(groupsX)
+        , groupsY(groupsY)
+    {
+        if (numThreads == 0) numThreads = std::thread::hardware_concurrency();
+        if (numThreads == 0) numThreads = 4;
+
+        tiles.resize(groupsX * groupsY);
+        std::iota(tiles.begin(), tiles.end(), 0);
+
+        workers.reserve(numThreads);
+        for (unsigned int i = 0; i < numThreads; i++) {
+            workers.emplace_back(&TiledDispatcher::workerThread, this);
+        }
+    }
+
+    ~TiledDispatcher() {
+        queue.close();
+        for (auto& worker : workers) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    unsigned int threadCount() const { return workers.size(); }
+
+    void dispatch() {
+        wg.add(tiles.size());
+        queue.sendMany(tiles);
+        wg.wait();
+    }
+
+private:
+    CPUShaderGlobals* globals;
+    uint32_t groupsX, groupsY;
+
+    std::vector<uint32_t> tiles;
+    std::vector<std::thread> workers;
+    Channel<uint32_t> queue;
+    WaitGroup wg;
+
+    void workerThread() {
+        uint32_t tile;
+        while (queue.receive(tile)) {
+            uint32_t x = tile % groupsX;
+            uint32_t y = tile / groupsX;
+
+            CPUVaryingInput input{
+                .startGroupID = { x, y, 0 },
+                .endGroupID = { x + 1, y + 1, 1 },
+            };
+            computeCPU(&input, nullptr, globals);
+            wg.done();
+        }
+    }
+};
+
+static uint8_t toByte(float v) {
+    return uint8_t(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static void writeImage(const std::string& path, const std::vector<CPUColor>& pixels, uint32_t width, uint32_t height) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file for writing: " + path);
+    }
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (const CPUColor& pixel : pixels) {
+        uint8_t rgb[3] = { toByte(pixel.r), toByte(pixel.g), toByte(pixel.b) };
+        file.write(reinterpret_cast<const char*>(rgb), sizeof(rgb));
+    }
+}
+
+// 16 bit PGM, so step counts are stored exactly
+static void writeSteps(const std::string& path, const std::vector<uint32_t>& steps, uint32_t width, uint32_t height) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file for writing: " + path);
+    }
+
+    file << "P5\n" << width << " " << height << "\n65535\n";
+    for (uint32_t count : steps) {
+        uint16_t value = uint16_t(std::min<uint32_t>(count, 65535));
+        uint8_t bigEndian[2] = { uint8_t(value >> 8), uint8_t(value & 0xff) };
+        file.write(reinterpret_cast<const char*>(bigEndian), sizeof(bigEndian));
+    }
+}
+
+static int run(const BenchOptions& options) {
+    TreeManager treeManager;
+    if (!options.treePath.empty()) {
+        treeManager.loadFromFile(options.treePath);
+    } else {
+        treeManager.createTestTree();
+        if (!options.bakePath.empty()) {
+            treeManager.saveToFile(options.bakePath);
+            std::cout << "Baked tree to " << options.bakePath << std::endl;
+        }
+    }
+
+    uint32_t pixelCount = options.width * options.height;
+    std::vector<CPUColor> color(pixelCount);
+    std::vector<uint32_t> steps(pixelCount);
+    std::vector<float> depth(pixelCount);
+    std::vector<float> ao(pixelCount);
+    std::vector<float> startDistances(pixelCount, 0.0f);
+
+    // time is fixed, it seeds the depth of field sample pattern & would make runs differ
+    CPUFrameUniforms frame{
+        .time = 0.0f,
+        .aperture = 0.001f,
+        .focusDistance = 3.5f,
+        .fov = 1.5f,
+        .cameraPosition = { options.cameraPosition[0], options.cameraPosition[1], options.cameraPosition[2] },
+        .cameraDirection = { options.cameraDirection[0], options.cameraDirection[1], options.cameraDirection[2] },
+        .foveaCenter = { 0.5f, 0.5f },
+        .foveaLevels = 0, // computeCPU traces every pixel
+        .checkerboard = 0,
+        .renderSize = { options.width, options.height },
+        .treeNodes = treeManager.nodes.data(),
+        .treeLeaves = treeManager.leaves.data(),
+    };
+    // the high quality preset from uniforms/render.cpp, specialization constants keep their defaults on the CPU target
+    CPURenderUniforms render{
+        .maxDistance = 100000.0f,
+        .epsilon = 0.0001f,
+        .shadowMaxDistance = 1000.0f,
+        .shadowBias = 0.02f,
+    };
+    CPUDispatch dispatch{ .width = options.width, .height = options.height };
+
+    CPUShaderGlobals globals{
+        .frameUniforms = &frame,
+        .renderUniforms = &render,
+        .dispatch = &dispatch,
+        .outputColor = { color.data(), color.size() },
+        .outputSteps = { steps.data(), steps.size() },
+        .outputDepth = { depth.data(), depth.size() },
+        .outputAO = { ao.data(), ao.size() },
+        .startDistances = { startDistances.data(), startDistances.size() },
+    };
+
+    uint32_t groupsX = (options.width + groupSize - 1) / groupSize;
+    uint32_t groupsY = (options.height + groupSize - 1) / groupSize;
+    TiledDispatcher dispatcher(&globals, groupsX, groupsY, options.threads);
+
+    std::cout << "Rendering " << options.frames << " frames at " << options.width << "x" << options.height
+        << " on " << dispatcher.threadCount() << " threads" << std::endl;
+
+    std::vector<double> frameTimes;
+    frameTimes.reserve(options.frames);
+    uint64_t firstFrameSteps = 0;
+    std::vector<float> firstFrameDepth;
+    std::vector<float> firstFrameAO;
+    for (uint32_t i = 0; i < options.frames; i++) {
+        auto start = std::chrono::steady_clock::now();
+        dispatcher.dispatch();
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+        if (i == 0) {
+            firstFrameSteps = std::accumulate(steps.begin(), steps.end(), uint64_t(0));
+            firstFrameDepth = depth;
+            firstFrameAO = ao;
+        }
+        // outside of the timed part, on the GPU this is its own pass
+        if (options.reprojectStart) {
+            computeStartDistances(depth, startDistances, options.width, options.height);
+        }
+    }
+
+    uint64_t totalSteps = std::accumulate(steps.begin(), steps.end(), uint64_t(0));
+    uint32_t maxSteps = *std::max_element(steps.begin(), steps.end());
+    double minTime = *std::min_element(frameTimes.begin(), frameTimes.end());
+    double avgTime = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / frameTimes.size();
+
+    std::cout << "steps/frame:  " << totalSteps << std::endl;
+    std::cout << "steps/pixel:  avg " << double(totalSteps) / pixelCount << ", max " << maxSteps << std::endl;
+    if (options.reprojectStart) {
+        std::cout << "steps/pixel:  avg " << double(firstFrameSteps) / pixelCount << " in the first frame, without start distances" << std::endl;
+    }
+    std::cout << "ms/frame:     avg " << avgTime << ", min " << minTime << std::endl;
+    if (options.reprojectStart && options.frames > 1) {
+        checkStartAO(firstFrameDepth, firstFrameAO, depth, ao);
+    }
+
+    writeImage(options.outputPrefix + ".ppm", color, options.width, options.height);
+    writeSteps(options.outputPrefix + "_steps.pgm", steps, options.width, options.height);
+    std::cout << "Wrote " << options.outputPrefix << ".ppm & " << options.outputPrefix << "_steps.pgm" << std::endl;
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return run(parseOptions(argc, argv));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,404 @@
+// Headless GPU benchmark for the compute passes.
+//
+// Creates a Vulkan device without a window or surface and renders the same compute passes as the game into
+// the offscreen compute image, for a fixed number of frames along a scripted or recorded camera path. Prints the GPU
+// profiler's timings per pass, writes the time of every frame to <prefix>_timings.csv and optionally the
+// frames as PNG, so render benchmarks & golden image checks can run on machines without a GPU (lavapipe).
+
+#include <vulkan/vulkan_raii.hpp>
+#include <glm/glm.hpp>
+
+#define VMA_IMPLEMENTATION
+#include "vma/vk_mem_alloc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../camera/camerapath.hpp"
+#include "../screen/computescreen.hpp"
+#include "../util/png.hpp"
+#include "../vulkan/context.hpp"
+#include "../vulkan/pipeline.hpp"
+#include "../vulkan/profiler.hpp"
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+struct BenchOptions {
+    std::string treePath;
+    // compute shader tree build instead of the CPU one, e.g. shaders/treebuild.spv
+    std::string treeBuildShader;
+    std::string shaderPath = "shaders/slang.spv";
+    std::string outputPrefix = "gpubench";
+    uint32_t width = 640;
+    uint32_t height = 360;
+    uint32_t frames = 100;
+    RenderQuality quality = RenderQuality::High;
+    glm::vec3 cameraPosition = { 0.0f, 0.0f, 0.0f };
+    // FPSCamera's starting direction
+    glm::vec3 cameraDirection = { 0.0f, 0.0f, 1.0f };
+    // scripted camera path, per frame
+    float speed = 0.0f;
+    float turnDegrees = 0.0f;
+    // camera path recorded in the game, replaces the scripted one & the frame count
+    std::string cameraPath;
+    // 0 writes no PNGs
+    uint32_t pngEvery = 0;
+    bool validation = false;
+};
+
+static void printUsage() {
+    std::cout << "usage: AftermathGPUBench [options]\n"
+        << "  --tree <file>        load a baked tree instead of generating one\n"
+        << "  --gpu-tree <file>    build the tree with compute shaders (shaders/treebuild.spv)\n"
+        << "  --shaders <file>     compiled shaders (default shaders/slang.spv)\n"
+        << "  --width <px>         image width (default 640)\n"
+        << "  --height <px>        image height (default 360)\n"
+        << "  --frames <n>         frames to render (default 100)\n"
+        << "  --quality <preset>   low, medium or high (default high)\n"
+        << "  --camera x y z dx dy dz\n"
+        << "  --speed <units>      camera movement along its direction per frame\n"
+        << "  --turn <degrees>     camera rotation around the y axis per frame\n"
+        << "  --path <file>        replay a camera path recorded in the game (K) instead\n"
+        << "  --png-every <n>      write every nth frame & the last one as <prefix>_<frame>.png\n"
+        << "  --validation         enable the validation layers\n"
+        << "  --out <prefix>       output prefix for <prefix>_timings.csv & the PNGs\n";
+}
+
+static BenchOptions parseOptions(int argc, char** argv) {
+    BenchOptions options;
+
+    auto next = [&](int& i) -> std::string {
+        if (i + 1 >= argc) {
+            throw std::runtime_error(std::string("missing value for ") + argv[i]);
+        }
+        return argv[++i];
+    };
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tree") options.treePath = next(i);
+        else if (arg == "--gpu-tree") options.treeBuildShader = next(i);
+        else if (arg == "--shaders") options.shaderPath = next(i);
+        else if (arg == "--out") options.outputPrefix = next(i);
+        else if (arg == "--width") options.width = std::stoul(next(i));
+        else if (arg == "--height") options.height = std::stoul(next(i));
+        else if (arg == "--frames") options.frames = std::stoul(next(i));
+        else if (arg == "--quality") {
+            std::string name = next(i);
+            bool found = false;
+            for (RenderQuality quality : { RenderQuality::Low, RenderQuality::Medium, RenderQuality::High }) {
+                if (name == getRenderQualityName(quality)) {
+                    options.quality = quality;
+                    found = true;
+                }
+            }
+            if (!found) {
+                throw std::runtime_error("unknown quality: " + name);
+            }
+        }
+        else if (arg == "--camera") {
+            for (int c = 0; c < 3; c++) options.cameraPosition[c] = std::stof(next(i));
+            for (int c = 0; c < 3; c++) options.cameraDirection[c] = std::stof(next(i));
+        }
+        else if (arg == "--speed") options.speed = std::stof(next(i));
+        else if (arg == "--turn") options.turnDegrees = std::stof(next(i));
+        else if (arg == "--path") options.cameraPath = next(i);
+        else if (arg == "--png-every") options.pngEvery = std::stoul(next(i));
+        else if (arg == "--validation") options.validation = true;
+        else if (arg == "--help" || arg == "-h") {
+            printUsage();
+            std::exit(EXIT_SUCCESS);
+        }
+        else {
+            printUsage();
+            throw std::runtime_error("unknown option: " + arg);
+        }
+    }
+
+    if (options.width == 0 || options.height == 0 || options.frames == 0) {
+        throw std::runtime_error("width, height & frames must be larger than 0");
+    }
+    if (glm::length(options.cameraDirection) == 0.0f) {
+        throw std::runtime_error("camera direction can't be 0");
+    }
+
+    return options;
+}
+
+// Host visible copy of the compute image, for the PNGs
+struct Readback {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    void* mapped = nullptr;
+};
+
+static Readback createReadback(VmaAllocator allocator, uint32_t width, uint32_t height) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = VkDeviceSize(width) * height * 4;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    Readback readback;
+    VmaAllocationInfo info{};
+    if (vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &readback.buffer, &readback.allocation, &info) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create readback buffer");
+    }
+    readback.mapped = info.pMappedData;
+    return readback;
+}
+
+static void recordReadback(const vk::raii::CommandBuffer& cmd, const ComputeToScreen& computeScreen, const Readback& readback) {
+    vk::BufferImageCopy region;
+    region.imageSubresource = { vk::ImageAspectFlagBits::eColor, 0, 0, 1 };
+    region.imageExtent = vk::Extent3D{ computeScreen.renderWidth, computeScreen.renderHeight, 1 };
+
+    // recordCompute without raster leaves the image in GENERAL, visible to transfer reads
+    cmd.copyImageToBuffer(computeScreen.image, vk::ImageLayout::eGeneral, readback.buffer, region);
+
+    vk::MemoryBarrier hostBarrier;
+    hostBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    hostBarrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
+
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eHost,
+        vk::DependencyFlags{},
+        hostBarrier,
+        nullptr,
+        nullptr
+    );
+}
+
+// The fullscreen pass shows the compute image turned by 180 degrees & the swapchain encodes it as sRGB, the PNGs
+// get both so they match the screen
+static void writeFrame(const std::string& path, VmaAllocator allocator, const Readback& readback, uint32_t width, uint32_t height) {
+    vmaInvalidateAllocation(allocator, readback.allocation, 0, VK_WHOLE_SIZE);
+
+    const uint8_t* pixels = static_cast<const uint8_t*>(readback.mapped);
+    std::vector<uint8_t> rgba(size_t(width) * height * 4);
+    size_t pixelCount = size_t(width) * height;
+    for (size_t i = 0; i < pixelCount; i++) {
+        std::copy_n(pixels + (pixelCount - 1 - i) * 4, 4, rgba.data() + i * 4);
+    }
+    png::encodeSrgb(rgba.data(), pixelCount);
+    png::write(path, rgba.data(), width, height);
+}
+
+static int run(BenchOptions options) {
+    CameraPath path;
+    if (!options.cameraPath.empty()) {
+        path.load(options.cameraPath);
+        if (path.empty()) {
+            throw std::runtime_error("Camera path has no frames: " + options.cameraPath);
+        }
+        options.frames = uint32_t(path.size());
+    }
+
+    VulkanContext context;
+    context.createInstance(options.validation, true);
+    context.init(VK_NULL_HANDLE);
+    const vk::raii::Device& device = context.getDevice();
+
+    // one frame in flight, every frame is waited on before the next one is recorded
+    ComputeToScreen computeScreen;
+    computeScreen.create(context.getAllocator(), device, context.getGraphicsQueueIndex(), options.width, options.height, 1);
+    computeScreen.loadTree(context.getAllocator(), device, context.getGraphicsQueueIndex(), options.treePath,
+        options.treeBuildShader);
+
+    RenderPreset preset = getRenderPreset(options.quality);
+    RenderPipeline renderPipeline;
+    renderPipeline.createComputePipeline(context, options.shaderPath, *computeScreen.computePipelineLayout, nullptr,
+        preset.specialization.constants());
+
+    GpuProfiler profiler;
+    profiler.create(context, 1, 32, options.frames);
+    if (!profiler.isEnabled()) {
+        std::cout << "No timestamp support, only CPU times are measured" << std::endl;
+    }
+
+    vk::raii::CommandPool commandPool(device, vk::CommandPoolCreateInfo{
+        .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+        .queueFamilyIndex = context.getGraphicsQueueIndex(),
+    });
+    vk::raii::CommandBuffers commandBuffers(device, vk::CommandBufferAllocateInfo{
+        .commandPool = *commandPool,
+        .level = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = 1,
+    });
+    const vk::raii::CommandBuffer& cmd = commandBuffers[0];
+    vk::raii::Fence fence(device, vk::FenceCreateInfo{});
+
+    Readback readback = createReadback(context.getAllocator(), options.width, options.height);
+
+    auto submitAndWait = [&]() {
+        vk::SubmitInfo submitInfo{
+            .commandBufferCount = 1,
+            .pCommandBuffers = &*cmd,
+        };
+        context.getGraphicsQueue().submit(submitInfo, *fence);
+        if (device.waitForFences(*fence, vk::True, UINT64_MAX) != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to wait for the frame fence");
+        }
+        device.resetFences(*fence);
+    };
+
+    uint32_t lightCount = computeScreen.treeManager.getLightCount();
+    ComputePasses passes{
+        .trace = &renderPipeline.getComputePipeline(preset.specialization.constants(), "computeMain"),
+        .reprojectStart = &renderPipeline.getComputePipeline({}, "reprojectStartDistances"),
+        .coneStart = &renderPipeline.getComputePipeline({}, "coneStartDistances"),
+        .binLights = lightCount > 0 ? &renderPipeline.getComputePipeline({}, "binLights") : nullptr,
+        .cullLights = lightCount > 0 ? &renderPipeline.getComputePipeline({}, "cullLights") : nullptr,
+        .raster = false,
+    };
+
+    std::cout << "Rendering " << options.frames << " frames" << (path.empty() ? "" : " of " + options.cameraPath) << " at " << options.width << "x" << options.height
+        << ", " << getRenderQualityName(options.quality) << " quality" << std::endl;
+
+    glm::vec3 position = options.cameraPosition;
+    glm::vec3 direction = glm::normalize(options.cameraDirection);
+    glm::vec3 previousPosition = position;
+    glm::vec3 previousDirection = direction;
+    float turn = options.turnDegrees * 3.14159265f / 180.0f;
+
+    ReplayTimings timings(options.frames);
+
+    for (uint32_t frame = 0; frame < options.frames; frame++) {
+        if (!path.empty()) {
+            position = path[frame].position;
+            direction = path[frame].direction;
+            if (frame == 0) {
+                previousPosition = position;
+                previousDirection = direction;
+            }
+            if (path[frame].observerMoved) {
+                glm::vec3 observer = path[frame].observer;
+                computeScreen.treeManager.moveObserver({ observer.x, observer.y, observer.z });
+            }
+            // without the edit pass, takeTreeEdits rebuilds & uploads them on the CPU
+            for (const CameraPathEdit& edit : path[frame].edits) {
+                computeScreen.treeManager.applyEdit(EditBrush{
+                    .center = { edit.center.x, edit.center.y, edit.center.z },
+                    .radius = edit.radius,
+                    .operation = edit.operation,
+                    .material = edit.material,
+                });
+            }
+            if (!path[frame].edits.empty()) {
+                computeScreen.takeTreeEdits();
+            }
+        }
+
+        computeScreen.frameData.update(0, FrameUniforms{
+            // from the frame number, so runs are repeatable
+            .time = frame * CameraPath::fixedTimestep,
+            .aperture = 0.001,
+            .focusDistance = 3.5,
+            .fov = 1.5,
+            .cameraPosition = position,
+            .cameraDirection = direction,
+            .foveaCenter = { 0.5f, 0.5f },
+            .frameNumber = frame,
+            .previousCameraPosition = previousPosition,
+            .previousCameraDirection = previousDirection,
+            .renderSize = { computeScreen.renderWidth, computeScreen.renderHeight },
+            .reprojectStart = 1,
+            .coneStart = 1,
+            .lightingScale = 1,
+            .lightCount = lightCount,
+            .treeNodes = computeScreen.treeManager.getNodeAddress(),
+            .treeLeaves = computeScreen.treeManager.getLeafAddress(),
+        });
+        computeScreen.renderData.update(0, preset.uniforms);
+
+        bool writePng = options.pngEvery > 0 && (frame % options.pngEvery == 0 || frame + 1 == options.frames);
+
+        cmd.reset();
+        cmd.begin({});
+        // collects the previous frame's timestamps, its fence was waited on
+        profiler.beginFrame(cmd, 0);
+        if (frame > 0 && profiler.isEnabled()) {
+            timings.setGpu(int64_t(frame) - 1, profiler.getStats("frame").last);
+        }
+        uint32_t frameScope = profiler.beginScope(cmd, "frame");
+        computeScreen.recordCompute(cmd, passes, 0, &profiler);
+        profiler.endScope(cmd, frameScope);
+        if (writePng) {
+            recordReadback(cmd, computeScreen, readback);
+        }
+        cmd.end();
+
+        auto start = std::chrono::steady_clock::now();
+        submitAndWait();
+        timings.setCpu(frame, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+        if (writePng) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "_%05u.png", frame);
+            writeFrame(options.outputPrefix + name, context.getAllocator(), readback, computeScreen.renderWidth,
+                computeScreen.renderHeight);
+        }
+
+        previousPosition = position;
+        previousDirection = direction;
+        position += direction * options.speed;
+        direction = glm::vec3(
+            direction.x * std::cos(turn) + direction.z * std::sin(turn),
+            direction.y,
+            -direction.x * std::sin(turn) + direction.z * std::cos(turn));
+    }
+
+    // one more beginFrame reads back the last frame's timestamps
+    if (profiler.isEnabled()) {
+        cmd.reset();
+        cmd.begin({});
+        profiler.beginFrame(cmd, 0);
+        cmd.end();
+        submitAndWait();
+        timings.setGpu(int64_t(options.frames) - 1, profiler.getStats("frame").last);
+    }
+
+    timings.writeCSV(options.outputPrefix + "_timings.csv");
+
+    // the CPU time is submit to fence
+    std::cout << timings.summary() << std::endl;
+    if (profiler.isEnabled()) {
+        std::cout << profiler.summary() << std::endl;
+    }
+    std::cout << "Wrote " << options.outputPrefix << "_timings.csv" << std::endl;
+
+    device.waitIdle();
+    vmaDestroyBuffer(context.getAllocator(), readback.buffer, readback.allocation);
+    profiler.destroy();
+    renderPipeline.cleanup();
+    computeScreen.destroy(context.getAllocator());
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return run(parseOptions(argc, argv));
+    }
+    catch (const vk::SystemError& e) {
+        std::cerr << "Vulkan error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,153 @@
+#include "camerapath.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+void CameraPath::addFrame(glm::vec3 position, glm::vec3 direction) {
+    frames.push_back({ .position = position, .direction = direction });
+}
+
+void CameraPath::addObserver(glm::vec3 observer) {
+    if (frames.empty()) {
+        throw std::runtime_error("Observer recorded before the first camera frame");
+    }
+    frames.back().observerMoved = true;
+    frames.back().observer = observer;
+}
+
+void CameraPath::addEdit(const CameraPathEdit& edit) {
+    if (frames.empty()) {
+        throw std::runtime_error("Edit recorded before the first camera frame");
+    }
+    frames.back().edits.push_back(edit);
+}
+
+void CameraPath::save(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file for writing: " + path);
+    }
+
+    // enough digits that floats survive the round trip exactly
+    file.precision(9);
+    file << "# camera path, " << frames.size() << " frames\n";
+    for (size_t i = 0; i < frames.size(); i++) {
+        const CameraPathFrame& frame = frames[i];
+        file << "camera " << i << " " << frame.position.x << " " << frame.position.y << " " << frame.position.z << " "
+            << frame.direction.x << " " << frame.direction.y << " " << frame.direction.z << "\n";
+        if (frame.observerMoved) {
+            file << "observer " << i << " " << frame.observer.x << " " << frame.observer.y << " " << frame.observer.z << "\n";
+        }
+        for (const CameraPathEdit& edit : frame.edits) {
+            file << "edit " << i << " " << edit.center.x << " " << edit.center.y << " " << edit.center.z << " "
+                << edit.radius << " " << edit.operation << " " << edit.material << "\n";
+        }
+    }
+}
+
+void CameraPath::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open camera path: " + path);
+    }
+
+    frames.clear();
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream stream(line);
+        std::string kind;
+        size_t frame = 0;
+        stream >> kind >> frame;
+
+        bool valid = !stream.fail();
+        if (kind == "camera") {
+            glm::vec3 position, direction;
+            stream >> position.x >> position.y >> position.z >> direction.x >> direction.y >> direction.z;
+            // frames are numbered in order, a gap means a broken file
+            valid = valid && !stream.fail() && frame == frames.size();
+            if (valid) {
+                addFrame(position, direction);
+            }
+        } else if (kind == "observer") {
+            glm::vec3 observer;
+            stream >> observer.x >> observer.y >> observer.z;
+            valid = valid && !stream.fail() && frame + 1 == frames.size();
+            if (valid) {
+                addObserver(observer);
+            }
+        } else if (kind == "edit") {
+            CameraPathEdit edit;
+            stream >> edit.center.x >> edit.center.y >> edit.center.z >> edit.radius >> edit.operation >> edit.material;
+            valid = valid && !stream.fail() && frame + 1 == frames.size();
+            if (valid) {
+                addEdit(edit);
+            }
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": can't parse '" + line + "'");
+        }
+    }
+}
+
+void ReplayTimings::setCpu(int64_t frame, double ms) {
+    if (frame >= 0 && size_t(frame) < cpuMs.size()) {
+        cpuMs[frame] = ms;
+    }
+}
+
+void ReplayTimings::setGpu(int64_t frame, double ms) {
+    if (frame >= 0 && size_t(frame) < gpuMs.size()) {
+        gpuMs[frame] = ms;
+    }
+}
+
+void ReplayTimings::writeCSV(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file for writing: " + path);
+    }
+
+    file << "frame,cpu_ms,gpu_ms\n";
+    for (size_t i = 0; i < cpuMs.size(); i++) {
+        file << i << "," << cpuMs[i] << "," << gpuMs[i] << "\n";
+    }
+}
+
+static std::string summarize(const char* name, const std::vector<double>& values) {
+    if (values.empty()) {
+        return std::string(name) + ": no frames";
+    }
+
+    std::vector<double> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    // nearest rank
+    auto percentile = [&](double fraction) {
+        size_t rank = size_t(std::ceil(fraction * sorted.size()));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    };
+    double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    size_t worst = std::max_element(values.begin(), values.end()) - values.begin();
+
+    std::ostringstream out;
+    out.precision(3);
+    out << std::fixed << name << " ms: mean " << mean << ", p95 " << percentile(0.95) << ", p99 " << percentile(0.99)
+        << ", worst " << values[worst] << " (frame " << worst << ")";
+    return out.str();
+}
+
+std::string ReplayTimings::summary() const {
+    return summarize("CPU", cpuMs) + "\n" + summarize("GPU", gpuMs);
+}
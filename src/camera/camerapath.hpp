@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A sphere carved out of or filled into the tree, where the raycast put it. The fields of the tree's EditBrush,
+// so the camera code doesn't depend on the tree
+struct CameraPathEdit {
+    glm::vec3 center;
+    float radius;
+    // EDIT_CARVE or EDIT_FILL
+    uint32_t operation;
+    // MaterialType of filled voxels
+    uint32_t material;
+};
+
+// What happened in one frame of a recording: where the camera was, whether the tree's observer moved & the
+// edits made that frame
+struct CameraPathFrame {
+    glm::vec3 position;
+    glm::vec3 direction;
+    bool observerMoved = false;
+    glm::vec3 observer = glm::vec3(0.0f);
+    std::vector<CameraPathEdit> edits;
+};
+
+// A recorded camera path, replayed one frame per frame at a fixed timestep, so every replay renders
+// the exact same frames. Stored as text, one event per line:
+//
+//   camera <frame> <x> <y> <z> <dx> <dy> <dz>
+//   observer <frame> <x> <y> <z>
+//   edit <frame> <x> <y> <z> <radius> <operation> <material>
+//
+// Every frame has a camera line, observer lines only appear in the frames that moved it, edit lines in the
+// frames that edited the tree, one per edit. Lines starting with # are comments.
+class CameraPath {
+public:
+    // replays advance time by this much per frame, whatever the recording's frame rate was
+    static constexpr float fixedTimestep = 1.0f / 60.0f;
+
+    void clear() { frames.clear(); }
+    // starts a new frame, the observer & edits can be added to it until the next one
+    void addFrame(glm::vec3 position, glm::vec3 direction);
+    void addObserver(glm::vec3 observer);
+    void addEdit(const CameraPathEdit& edit);
+
+    void save(const std::string& path) const;
+    // throws on a file that can't be read or parsed
+    void load(const std::string& path);
+
+    size_t size() const { return frames.size(); }
+    bool empty() const { return frames.empty(); }
+    const CameraPathFrame& operator[](size_t frame) const { return frames[frame]; }
+
+private:
+    std::vector<CameraPathFrame> frames;
+};
+
+// CPU & GPU time of every frame of a replay, written as CSV with a summary of the worst frames
+class ReplayTimings {
+public:
+    explicit ReplayTimings(size_t frameCount) : cpuMs(frameCount, 0.0), gpuMs(frameCount, 0.0) {}
+
+    // frames outside of the replay are ignored, e.g. the warmup or the frames flushing the GPU timings
+    void setCpu(int64_t frame, double ms);
+    void setGpu(int64_t frame, double ms);
+
+    void writeCSV(const std::string& path) const;
+    // mean, p95, p99 & the worst frame, of the CPU & the GPU times
+    std::string summary() const;
+
+private:
+    std::vector<double> cpuMs;
+    std::vector<double> gpuMs;
+};
@@ -9,14 +9,25 @@
 
 #include <chrono>
 #include <cstdlib>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "camera/camera.hpp"
+#include "camera/camerapath.hpp"
 #include "screen/computescreen.hpp"
+#include "screen/governor.hpp"
+#include "tree/raycast.hpp"
+#include "util/task.hpp"
+#include "util/task_vulkan.hpp"
 #include "vulkan/context.hpp"
 #include "vulkan/pipeline.hpp"
+#include "vulkan/pipelinecache.hpp"
+#include "vulkan/profiler.hpp"
 #include "vulkan/swapchain.hpp"
 #include "vulkan/sync.hpp"
 
@@ -48,11 +59,30 @@ const std::vector<Vertex> vertices = {
 const std::vector<uint16_t> indices = { 0, 1, 2, 2, 3, 0 };
 
 const bool dev = true;
+// falls back to blit, then raster, if the surface or device doesn't support it
+const PresentPath preferredPresentPath = PresentPath::Storage;
+// compute shaders build the tree, falls back to the CPU build if that fails
+const std::string treeBuildShader = "shaders/treebuild.spv";
+// applies edits to the tree's GPU buffers in place, falls back to CPU uploads if that fails
+const std::string treeEditShader = "shaders/treeedit.spv";
 const std::vector<char const*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
-constexpr int MAX_FRAMES_IN_FLIGHT = 1;
+constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+
+// Command line options of the game
+struct AppOptions {
+    // replay a recorded camera path instead of reading input, then write the timings & quit
+    std::string replayPath;
+    std::string timingsPath = "replay_timings.csv";
+    // where K saves the recording
+    std::string recordPath = "camera_path.txt";
+    // fraction of the device memory budget the tree coarsens its farthest detail to stay under
+    float memoryBudgetFraction = 0.85f;
+};
 
 class MainApplication {
 public:
+    explicit MainApplication(AppOptions options) : options(std::move(options)) {}
+
     void run() {
 		std::cout << "initializing window" << std::endl;
         initWindow();
@@ -73,6 +103,7 @@ private:
 	SwapChainManager swapchainManager;
 
 	RenderPipeline renderPipeline;
+	PipelineCache pipelineCache;
     vk::raii::PipelineLayout graphicsPipelineLayout = nullptr;
 
     ComputeToScreen computeScreen;
@@ -83,14 +114,81 @@ private:
     vk::raii::DeviceMemory indexBufferMemory = nullptr;
 
     vk::raii::CommandPool commandPool = nullptr;
+    // per frame in flight: the compute passes, & the present pass that waits for the acquired image
     vk::raii::CommandBuffers commandBuffers = nullptr;
+    vk::raii::CommandBuffers presentCommandBuffers = nullptr;
 
     vk::raii::CommandPool transferCommandPool = nullptr;
 
     SyncObjects syncObjects;
 
+    GpuProfiler gpuProfiler;
+
     bool framebufferResized = false;
 
+    RenderQuality renderQuality = RenderQuality::High;
+    FoveaSettings fovea;
+    // trace half of the pixels every frame & reproject the rest
+    bool checkerboard = false;
+    // start primary rays at the reprojected depth of the previous frame
+    bool reprojectStart = true;
+    bool reprojectKeyDown = false;
+    // start primary rays where a cone marched per tile stopped
+    bool coneStart = true;
+    bool coneKeyDown = false;
+    bool lightingKeyDown = false;
+    // split the trace into visibility, queued shadow rays & shading passes
+    bool wavefront = false;
+    bool wavefrontKeyDown = false;
+    // trace with a fixed number of workgroups pulling tiles, & the ray march steps per tile overlaid
+    bool persistent = false;
+    bool persistentKeyDown = false;
+    bool stepHeatmap = false;
+    bool heatmapKeyDown = false;
+    // adjusts the render scale & step budget to hold the GPU frame time target
+    FrameGovernor governor;
+    bool governorEnabled = false;
+    bool governorKeyDown = false;
+    // E carves & F fills a sphere where the camera looks
+    bool carveKeyDown = false;
+    bool fillKeyDown = false;
+    uint64_t treeVersion = 0;
+    // device local memory as of this frame, printed every second
+    VulkanContext::MemoryBudget memoryBudget;
+
+    AppOptions options;
+    // K starts & stops recording the camera path
+    CameraPath recording;
+    bool recordingPath = false;
+    bool recordKeyDown = false;
+    // replay drives the camera from the path one frame per frame, replayFrame counts on past its end
+    // until the GPU timings of the last frames are read back
+    CameraPath replay;
+    std::unique_ptr<ReplayTimings> replayTimings;
+    size_t replayFrame = 0;
+
+    // the stages of drawFrame, see buildFrameGraph. Two workers, the tree's rebuilds have a pool of their own
+    Scheduler frameScheduler{ 2 };
+    TaskGraph frameGraph;
+    // what the frame graph's stages hand each other, reset every frame
+    struct FrameState {
+        uint32_t frameIndex = 0;
+        uint32_t imageIndex = 0;
+        // the swapchain has to be recreated, the stages after acquire were skipped
+        bool swapchainStale = false;
+        std::chrono::time_point<std::chrono::high_resolution_clock> currentTime;
+        float time = 0.0f;
+        glm::vec3 cameraPosition;
+        glm::vec3 cameraDirection;
+        // EDIT_CARVE or EDIT_FILL if the key was just pressed
+        std::optional<uint32_t> editOperation;
+    };
+    FrameState frameState;
+
+    uint32_t frameNumber = 0;
+    glm::vec3 previousCameraPosition;
+    glm::vec3 previousCameraDirection;
+
     FPSCamera camera = nullptr;
 
     uint32_t frameCounter = 0;
@@ -116,6 +214,8 @@ private:
 
     void cleanup() {
         swapchainManager.cleanupSwapChain();
+        gpuProfiler.destroy();
+        pipelineCache.destroy();
         computeScreen.destroy(context.getAllocator());
         vmaDestroyAllocator(context.getAllocator());
         glfwDestroyWindow(window);
@@ -132,26 +232,68 @@ private:
 		std::cout << "initializing swap chain" << std::endl;
 		int width = 0, height = 0;
     	glfwGetFramebufferSize(window, &width, &height);
-        swapchainManager.init(context, width, height, *surface);
+        swapchainManager.init(context, width, height, *surface, preferredPresentPath);
 		std::cout << "creating command pool" << std::endl;
         createCommandPool();
 		std::cout << "creating command buffers" << std::endl;
         createCommandBuffers();
 		std::cout << "creating compute screen" << std::endl;
-        // TODO: initialTransition on computeScreen
-        computeScreen.create(context.getAllocator(), context.getDevice(), context.getGraphicsQueueIndex(), swapchainManager.getSwapChainExtent().width, swapchainManager.getSwapChainExtent().height);
-		std::cout << "creating compute pipeline" << std::endl;
-        renderPipeline.createComputePipeline(context, "shaders/slang.spv", *computeScreen.computePipelineLayout);
-		std::cout << "creating graphics pipeline" << std::endl;
-		vk::SurfaceFormatKHR swapChainSurfaceFormat = swapchainManager.getSwapChainSurfaceFormat();
-        renderPipeline.createGraphicsPipeline(context, "shaders/slang.spv", *computeScreen.graphicsPipelineLayout, swapChainSurfaceFormat.format, Vertex::getBindingDescription(), Vertex::getAttributeDescriptions());
+        computeScreen.create(context.getAllocator(), context.getDevice(), context.getGraphicsQueueIndex(), swapchainManager.getSwapChainExtent().width, swapchainManager.getSwapChainExtent().height, MAX_FRAMES_IN_FLIGHT);
+        computeScreen.updateSwapchainDescriptors(context.getDevice(), swapchainManager.getSwapChainImageViews());
+		std::cout << "loading pipeline cache" << std::endl;
+        pipelineCache.load(context, "pipeline_cache.bin");
+        // pipeline compilation only needs the layouts, it runs in the background while the tree is built & uploaded
+		std::cout << "creating pipelines in the background" << std::endl;
+        std::future<void> pipelinesReady = std::async(std::launch::async, [this]() { createPipelines(); });
+		std::cout << "loading tree" << std::endl;
+        auto treeStart = std::chrono::steady_clock::now();
+        computeScreen.loadTree(context.getAllocator(), context.getDevice(), context.getGraphicsQueueIndex(), {}, treeBuildShader);
+        std::cout << "tree ready after " << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - treeStart).count() << "ms" << std::endl;
+        computeScreen.createTreeEditor(context.getAllocator(), context.getDevice(), treeEditShader, MAX_FRAMES_IN_FLIGHT);
+        computeScreen.treeManager.setMemoryBudgetFraction(options.memoryBudgetFraction);
+        if (!context.supportsMemoryBudget()) {
+            std::cout << "VK_EXT_memory_budget unsupported, the tree's memory budget is estimated from the heap sizes" << std::endl;
+        }
+        pipelinesReady.get(); // rethrows pipeline creation errors
+        pipelineCache.save(context);
 		std::cout << "creating vertex buffer" << std::endl;
         createVertexBuffer();
 		std::cout << "creating index buffer" << std::endl;
         createIndexBuffer();
 		std::cout << "creating synchronization objects" << std::endl;
         syncObjects.create(context, swapchainManager.getSwapChainImages().size(), MAX_FRAMES_IN_FLIGHT);
+		std::cout << "creating GPU profiler" << std::endl;
+        gpuProfiler.create(context, MAX_FRAMES_IN_FLIGHT);
         camera = FPSCamera(window);
+        buildFrameGraph();
+    }
+
+    void createPipelines() {
+        auto start = std::chrono::steady_clock::now();
+
+        renderPipeline.createComputePipeline(context, "shaders/slang.spv", *computeScreen.computePipelineLayout, &pipelineCache.get(), getRenderPreset(renderQuality).specialization.constants());
+        // compile every quality variant up front, switching presets never stalls a frame & they all end up in the pipeline cache
+        for (RenderQuality quality : { RenderQuality::Low, RenderQuality::Medium, RenderQuality::High }) {
+            renderPipeline.getComputePipeline(getRenderPreset(quality).specialization.constants());
+            renderPipeline.getComputePipeline(getRenderPreset(quality).specialization.constants(), "computePersistent");
+            renderPipeline.getComputePipeline(getRenderPreset(quality).specialization.constants(), "stepHeatmap");
+        }
+        renderPipeline.getComputePipeline({}, "foveaResolve");
+        renderPipeline.getComputePipeline({}, "checkerboardResolve");
+        renderPipeline.getComputePipeline({}, "reprojectStartDistances");
+        renderPipeline.getComputePipeline({}, "coneStartDistances");
+        renderPipeline.getComputePipeline({}, "binLights");
+        renderPipeline.getComputePipeline({}, "cullLights");
+        if (swapchainManager.getPresentPath() == PresentPath::Storage) {
+            renderPipeline.getComputePipeline({}, "presentToSwapchain");
+        }
+        renderPipeline.getComputePipeline({}, "lightingShadows");
+        renderPipeline.getComputePipeline({}, "lightingResolve");
+        renderPipeline.getComputePipeline({}, "lightingShadowQueue");
+		vk::SurfaceFormatKHR swapChainSurfaceFormat = swapchainManager.getSwapChainSurfaceFormat();
+        renderPipeline.createGraphicsPipeline(context, "shaders/slang.spv", *computeScreen.graphicsPipelineLayout, swapChainSurfaceFormat.format, Vertex::getBindingDescription(), Vertex::getAttributeDescriptions(), &pipelineCache.get());
+
+        std::cout << "pipelines ready after " << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() << "ms" << std::endl;
     }
 
     void createSurface() {
@@ -227,31 +369,120 @@ private:
             .commandBufferCount = MAX_FRAMES_IN_FLIGHT
         };
         commandBuffers = vk::raii::CommandBuffers(context.getDevice(), allocInfo);
+        presentCommandBuffers = vk::raii::CommandBuffers(context.getDevice(), allocInfo);
     }
 
     void recordCommandBuffer(uint32_t imageIndex) {
     	int currentFrame = syncObjects.getCurrentFrame();
     	commandBuffers[currentFrame].begin({});
 
+        // reads back the timings this frame slot recorded last time, its fence was already waited on
+        gpuProfiler.beginFrame(commandBuffers[currentFrame], currentFrame);
+        uint32_t frameScope = gpuProfiler.beginScope(commandBuffers[currentFrame], "frame");
+        PresentPath presentPath = swapchainManager.getPresentPath();
+
         // Run compute shader
-        computeScreen.recordCompute(commandBuffers[currentFrame], renderPipeline.getComputePipeline());
+        ComputePasses passes{
+            .trace = &renderPipeline.getComputePipeline(getRenderPreset(renderQuality).specialization.constants(),
+                persistent ? "computePersistent" : "computeMain"),
+            .foveaResolve = !checkerboard && fovea.levels > 0 ? &renderPipeline.getComputePipeline({}, "foveaResolve") : nullptr,
+            .checkerboardResolve = checkerboard ? &renderPipeline.getComputePipeline({}, "checkerboardResolve") : nullptr,
+            .reprojectStart = reprojectStart ? &renderPipeline.getComputePipeline({}, "reprojectStartDistances") : nullptr,
+            .coneStart = coneStart ? &renderPipeline.getComputePipeline({}, "coneStartDistances") : nullptr,
+            .lightingShadows = !wavefront && computeScreen.lightingScale > 1 ? &renderPipeline.getComputePipeline({}, "lightingShadows") : nullptr,
+            .lightingResolve = wavefront || computeScreen.lightingScale > 1 ? &renderPipeline.getComputePipeline({}, "lightingResolve") : nullptr,
+            .lightingShadowQueue = wavefront ? &renderPipeline.getComputePipeline({}, "lightingShadowQueue") : nullptr,
+            // PRIMARY_MAX_STEPS scales the heatmap colors
+            .stepHeatmap = stepHeatmap ? &renderPipeline.getComputePipeline(getRenderPreset(renderQuality).specialization.constants(), "stepHeatmap") : nullptr,
+            .binLights = computeScreen.treeManager.getLightCount() > 0 ? &renderPipeline.getComputePipeline({}, "binLights") : nullptr,
+            .cullLights = computeScreen.treeManager.getLightCount() > 0 ? &renderPipeline.getComputePipeline({}, "cullLights") : nullptr,
+            .persistent = persistent,
+            .raster = presentPath == PresentPath::Raster,
+        };
+        computeScreen.recordCompute(commandBuffers[currentFrame], passes, currentFrame, &gpuProfiler);
+        commandBuffers[currentFrame].end();
+
+        // everything that touches the swapchain image goes in its own command buffer, only its submit waits for
+        // the acquire, so the compute passes above don't
+        const vk::raii::CommandBuffer& presentCmd = presentCommandBuffers[currentFrame];
+        presentCmd.begin({});
+        uint32_t scope = gpuProfiler.beginScope(presentCmd, "swapchain barrier");
+
+        // how the present path writes the swapchain image
+        vk::PipelineStageFlags2 writeStage = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+        vk::AccessFlags2 writeAccess = vk::AccessFlagBits2::eColorAttachmentWrite;
+        vk::ImageLayout writeLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        if (presentPath == PresentPath::Storage) {
+            writeStage = vk::PipelineStageFlagBits2::eComputeShader;
+            writeAccess = vk::AccessFlagBits2::eShaderStorageWrite;
+            writeLayout = vk::ImageLayout::eGeneral;
+        } else if (presentPath == PresentPath::Blit) {
+            writeStage = vk::PipelineStageFlagBits2::eBlit;
+            writeAccess = vk::AccessFlagBits2::eTransferWrite;
+            writeLayout = vk::ImageLayout::eTransferDstOptimal;
+        }
 
-        // Transition swapchain image
+        // Transition swapchain image, after the acquire semaphore's wait stage on the direct paths
         vk::ImageMemoryBarrier2 barrier{
-            .srcStageMask = vk::PipelineStageFlagBits2::eTopOfPipe,
-            .dstStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-            .dstAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite,
+            .srcStageMask = presentPath == PresentPath::Raster ? vk::PipelineStageFlagBits2::eTopOfPipe : writeStage,
+            .dstStageMask = writeStage,
+            .dstAccessMask = writeAccess,
             .oldLayout = vk::ImageLayout::eUndefined,
-            .newLayout = vk::ImageLayout::eColorAttachmentOptimal,
+            .newLayout = writeLayout,
             .image = swapchainManager.getSwapChainImages()[imageIndex],
             .subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 }
         };
-        commandBuffers[currentFrame].pipelineBarrier2(vk::DependencyInfo{
+        presentCmd.pipelineBarrier2(vk::DependencyInfo{
             .imageMemoryBarrierCount = 1,
             .pImageMemoryBarriers = &barrier
             });
+        gpuProfiler.endScope(presentCmd, scope);
+
+        vk::Extent2D swapChainExtent = swapchainManager.getSwapChainExtent();
+
+        if (presentPath == PresentPath::Storage) {
+            scope = gpuProfiler.beginScope(presentCmd, "present store");
+            computeScreen.storeToSwapchain(presentCmd, renderPipeline.getComputePipeline({}, "presentToSwapchain"),
+                imageIndex, swapChainExtent);
+            gpuProfiler.endScope(presentCmd, scope);
+        } else if (presentPath == PresentPath::Blit) {
+            scope = gpuProfiler.beginScope(presentCmd, "present blit");
+            computeScreen.blitToSwapchain(presentCmd, swapchainManager.getSwapChainImages()[imageIndex],
+                swapChainExtent);
+            gpuProfiler.endScope(presentCmd, scope);
+        } else {
+            recordRaster(imageIndex);
+        }
+
+        // Transition to present
+        scope = gpuProfiler.beginScope(presentCmd, "present barrier");
+        barrier.srcStageMask = writeStage;
+        barrier.srcAccessMask = writeAccess;
+        barrier.dstStageMask = vk::PipelineStageFlagBits2::eBottomOfPipe;
+        barrier.dstAccessMask = {};
+        barrier.oldLayout = writeLayout;
+        barrier.newLayout = vk::ImageLayout::ePresentSrcKHR;
+        presentCmd.pipelineBarrier2(vk::DependencyInfo{
+            .imageMemoryBarrierCount = 1,
+            .pImageMemoryBarriers = &barrier
+            });
+        gpuProfiler.endScope(presentCmd, scope);
+
+        // the direct paths leave the compute image in GENERAL, storeToSwapchain & blitToSwapchain end with the
+        // barrier that orders their read before the next frame's writes
+        if (presentPath == PresentPath::Raster) {
+            computeScreen.transitionBack(presentCmd, &gpuProfiler);
+        }
+
+        // the frame scope spans both command buffers, they run in submission order
+        gpuProfiler.endScope(presentCmd, frameScope);
+        presentCmd.end();
+    }
+
+    // Fullscreen quad sampling the compute image, the fallback present path
+    void recordRaster(uint32_t imageIndex) {
+        int currentFrame = syncObjects.getCurrentFrame();
 
-        // Render pass
         vk::RenderingAttachmentInfo colorAttachment{
             .imageView = *swapchainManager.getSwapChainImageViews()[imageIndex],
             .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
@@ -269,107 +500,427 @@ private:
             .pColorAttachments = &colorAttachment
         };
 
-        commandBuffers[currentFrame].beginRendering(renderingInfo);
-        commandBuffers[currentFrame].bindPipeline(vk::PipelineBindPoint::eGraphics, *renderPipeline.getGraphicsPipeline());
-        commandBuffers[currentFrame].bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+        uint32_t scope = gpuProfiler.beginScope(presentCommandBuffers[currentFrame], "raster");
+        presentCommandBuffers[currentFrame].beginRendering(renderingInfo);
+        presentCommandBuffers[currentFrame].bindPipeline(vk::PipelineBindPoint::eGraphics, *renderPipeline.getGraphicsPipeline());
+        presentCommandBuffers[currentFrame].bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
             *computeScreen.graphicsPipelineLayout, 0, computeScreen.graphicsSet, {});
-        commandBuffers[currentFrame].bindVertexBuffers(0, *vertexBuffer, { 0 });
-        commandBuffers[currentFrame].bindIndexBuffer(*indexBuffer, 0, vk::IndexType::eUint16);
-        commandBuffers[currentFrame].setViewport(0, vk::Viewport{
+        presentCommandBuffers[currentFrame].pushConstants<ScreenPushConstants>(*computeScreen.graphicsPipelineLayout,
+            vk::ShaderStageFlagBits::eFragment, 0, computeScreen.getScreenPushConstants());
+        presentCommandBuffers[currentFrame].bindVertexBuffers(0, *vertexBuffer, { 0 });
+        presentCommandBuffers[currentFrame].bindIndexBuffer(*indexBuffer, 0, vk::IndexType::eUint16);
+        presentCommandBuffers[currentFrame].setViewport(0, vk::Viewport{
             0, 0, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height), 0, 1
             });
-        commandBuffers[currentFrame].setScissor(0, vk::Rect2D{ {0, 0}, swapChainExtent });
-        commandBuffers[currentFrame].drawIndexed(indices.size(), 1, 0, 0, 0);
-        commandBuffers[currentFrame].endRendering();
+        presentCommandBuffers[currentFrame].setScissor(0, vk::Rect2D{ {0, 0}, swapChainExtent });
+        presentCommandBuffers[currentFrame].drawIndexed(indices.size(), 1, 0, 0, 0);
+        presentCommandBuffers[currentFrame].endRendering();
+        gpuProfiler.endScope(presentCommandBuffers[currentFrame], scope);
+    }
 
-        // Transition to present
-        barrier.srcStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
-        barrier.srcAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite;
-        barrier.dstStageMask = vk::PipelineStageFlagBits2::eBottomOfPipe;
-        barrier.dstAccessMask = {};
-        barrier.oldLayout = vk::ImageLayout::eColorAttachmentOptimal;
-        barrier.newLayout = vk::ImageLayout::ePresentSrcKHR;
-        commandBuffers[currentFrame].pipelineBarrier2(vk::DependencyInfo{
-            .imageMemoryBarrierCount = 1,
-            .pImageMemoryBarriers = &barrier
-            });
+    // 1, 2 & 3 switch between the low, medium & high quality presets
+    void updateRenderQuality() {
+        RenderQuality quality = renderQuality;
+        if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) quality = RenderQuality::Low;
+        if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) quality = RenderQuality::Medium;
+        if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) quality = RenderQuality::High;
+
+        if (quality != renderQuality) {
+            renderQuality = quality;
+            std::cout << "render quality: " << getRenderQualityName(renderQuality) << std::endl;
+            restartGovernor();
+        }
+    }
 
-        computeScreen.transitionBack(commandBuffers[currentFrame]);
-        commandBuffers[currentFrame].end();
+    // A manual scale or preset change while the governor is on becomes its new starting point, otherwise
+    // its next step would be taken from the values it last chose & undo the key press
+    void restartGovernor() {
+        if (governorEnabled) {
+            governor.reset(computeScreen.renderScale, renderQuality);
+        }
     }
 
-    void drawFrame() {
-   	    const vk::raii::Fence& fence = syncObjects.getCurrentFence();
-        const vk::raii::Semaphore& presentSemaphore = syncObjects.getCurrentPresentSemaphore();
+    // G toggles the frame time governor, which then owns the render scale & quality preset
+    void updateGovernor() {
+        bool governorKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+        if (governorKey && !governorKeyDown) {
+            governorEnabled = !governorEnabled;
+            governor.reset(computeScreen.renderScale, renderQuality);
+            std::cout << "frame time governor: " << (governorEnabled ? "on" : "off")
+                << ", target " << governor.getSettings().targetMs << "ms" << std::endl;
+        }
+        governorKeyDown = governorKey;
 
-        int currentFrame = syncObjects.getCurrentFrame();
+        // the profiler reads back one frame per frame, without timestamps there's nothing to go by
+        GpuPassStats frame = gpuProfiler.getStats("frame");
+        if (!governorEnabled || frame.samples == 0) {
+            return;
+        }
 
-        context.getDevice().waitForFences(*fence, vk::True, UINT64_MAX);
+        const GovernorDecision& decision = governor.update(frame.last);
+        if (decision.action == GovernorAction::Hold) {
+            return;
+        }
+        renderQuality = decision.quality;
+        computeScreen.setRenderScale(decision.renderScale);
+        std::cout << decision.describe() << " (" << computeScreen.renderWidth << "x" << computeScreen.renderHeight << ")" << std::endl;
+    }
 
-        auto [result, imageIndex] = swapchainManager.getSwapChain().acquireNextImage(UINT64_MAX, *presentSemaphore, nullptr);
-        if (result == vk::Result::eErrorOutOfDateKHR || framebufferResized) {
-            framebufferResized = false;
+    // 0 turns foveated rendering off, 7, 8 & 9 trace up to 1, 2 & 3 rings of lower density
+    void updateFovea() {
+        FoveaSettings settings = fovea;
+        if (glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS) settings = FoveaSettings{ .levels = 0 };
+        if (glfwGetKey(window, GLFW_KEY_7) == GLFW_PRESS) settings = FoveaSettings{ .radius = 0.35f, .falloff = 0.25f, .levels = 1 };
+        if (glfwGetKey(window, GLFW_KEY_8) == GLFW_PRESS) settings = FoveaSettings{ .radius = 0.25f, .falloff = 0.15f, .levels = 2 };
+        if (glfwGetKey(window, GLFW_KEY_9) == GLFW_PRESS) settings = FoveaSettings{ .radius = 0.15f, .falloff = 0.1f, .levels = 3 };
+
+        if (settings.levels != fovea.levels) {
+            fovea = settings;
+            std::cout << "foveation: " << fovea.levels << " levels, radius " << fovea.radius << ", falloff " << fovea.falloff << std::endl;
+        }
+    }
 
-            int width = 0, height = 0;
-            glfwGetFramebufferSize(window, &width, &height);
-            while (width == 0 || height == 0) {
-                glfwGetFramebufferSize(window, &width, &height);
-                glfwWaitEvents();
+    // 4 traces every pixel, 5 half of them in a checkerboard, 6 renders at half the pixel count & upscales
+    void updateTraceMode() {
+        bool newCheckerboard = checkerboard;
+        float newScale = computeScreen.renderScale;
+        if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) { newCheckerboard = false; newScale = 1.0f; }
+        if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS) { newCheckerboard = true; newScale = 1.0f; }
+        if (glfwGetKey(window, GLFW_KEY_6) == GLFW_PRESS) { newCheckerboard = false; newScale = 0.7071f; }
+
+        // R toggles reprojected start distances
+        bool reprojectKey = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+        if (reprojectKey && !reprojectKeyDown) {
+            reprojectStart = !reprojectStart;
+            if (reprojectStart && !checkerboard) {
+                computeScreen.historyInvalid = true;
             }
-            swapchainManager.recreateSwapChain(context, width, height);
+            std::cout << "reprojected start distances: " << (reprojectStart ? "on" : "off") << std::endl;
+        }
+        reprojectKeyDown = reprojectKey;
 
-            computeScreen.resize(context.getAllocator(), context.getDevice(), context.getGraphicsQueueIndex(), swapchainManager.getSwapChainExtent().width, swapchainManager.getSwapChainExtent().height);
-            // TODO: reset semaphore in syncObjects
-            //presentCompleteSemaphores[semaphoreIndex] = vk::raii::Semaphore(context.getDevice(), vk::SemaphoreCreateInfo{});
-            return;
+        // C toggles the cone pre-pass
+        bool coneKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+        if (coneKey && !coneKeyDown) {
+            coneStart = !coneStart;
+            std::cout << "cone start distances: " << (coneStart ? "on" : "off") << std::endl;
         }
+        coneKeyDown = coneKey;
 
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
+        // L cycles the lighting resolution through full, half & quarter
+        bool lightingKey = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+        if (lightingKey && !lightingKeyDown) {
+            computeScreen.setLightingScale(computeScreen.lightingScale == 4 ? 1 : computeScreen.lightingScale * 2);
+            std::cout << "lighting resolution: 1/" << computeScreen.lightingScale << std::endl;
+        }
+        lightingKeyDown = lightingKey;
+
+        // Q toggles the wavefront split, compare its per pass timings with the single trace kernel
+        bool wavefrontKey = glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS;
+        if (wavefrontKey && !wavefrontKeyDown) {
+            wavefront = !wavefront;
+            std::cout << "wavefront shadow queue: " << (wavefront ? "on" : "off") << std::endl;
+        }
+        wavefrontKeyDown = wavefrontKey;
+
+        // P toggles the persistent trace, H the step heatmap
+        bool persistentKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+        if (persistentKey && !persistentKeyDown) {
+            persistent = !persistent;
+            std::cout << "persistent threads: " << (persistent ? "on" : "off") << std::endl;
+        }
+        persistentKeyDown = persistentKey;
+
+        bool heatmapKey = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+        if (heatmapKey && !heatmapKeyDown) {
+            stepHeatmap = !stepHeatmap;
+            std::cout << "step heatmap: " << (stepHeatmap ? "on" : "off") << std::endl;
+        }
+        heatmapKeyDown = heatmapKey;
+
+        if (newCheckerboard != checkerboard || newScale != computeScreen.renderScale) {
+            if (newCheckerboard && !checkerboard && !reprojectStart) {
+                // the history is only kept up to date while checkerboard or reprojected start distances are on
+                computeScreen.historyInvalid = true;
+            }
+            checkerboard = newCheckerboard;
+            computeScreen.setRenderScale(newScale);
+            std::cout << "trace mode: " << (checkerboard ? "checkerboard" : "every pixel") << ", render scale " << computeScreen.renderScale
+                << " (" << computeScreen.renderWidth << "x" << computeScreen.renderHeight << ")" << std::endl;
+            restartGovernor();
+        }
+    }
 
-        float time = std::chrono::duration<float>(currentTime - startTime).count();
+    // E carves a sphere out of the tree where the camera looks, F fills one with stone. Only polls the keys,
+    // updateEdits applies the edit once the tree is free to touch
+    std::optional<uint32_t> pollEditKeys() {
+        bool carveKey = glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+        bool fillKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+        bool carve = carveKey && !carveKeyDown;
+        bool fill = fillKey && !fillKeyDown;
+        carveKeyDown = carveKey;
+        fillKeyDown = fillKey;
+        if (carve) return EDIT_CARVE;
+        if (fill) return EDIT_FILL;
+        return std::nullopt;
+    }
 
-        camera.update(deltaTime);
+    void updateEdits(glm::vec3 cameraPosition, glm::vec3 cameraDirection, uint32_t operation) {
+        RayCaster caster(computeScreen.treeManager, 1);
+        RayHit hit = caster.cast(Ray{ .origin = cameraPosition, .direction = glm::normalize(cameraDirection) });
+        if (!hit.hit) {
+            return;
+        }
+        // fill on top of the surface, carve into it
+        CameraPathEdit edit{
+            .center = operation == EDIT_FILL ? hit.position + hit.normal * 1.5f : hit.position,
+            .radius = 2.0f,
+            .operation = operation,
+            .material = uint32_t(MaterialType::Stone),
+        };
+        applyEdit(edit);
+        if (recordingPath) {
+            recording.addEdit(edit);
+        }
+    }
 
-        // computeScreen.treeManager.moveObserver({
-        //     camera.getPosition().x,
-        //     camera.getPosition().y,
-        //     camera.getPosition().z,
-        // });
+    // an edit made with E or F, or one replayed from a camera path
+    void applyEdit(const CameraPathEdit& edit) {
+        computeScreen.treeManager.applyEdit(EditBrush{
+            .center = { edit.center.x, edit.center.y, edit.center.z },
+            .radius = edit.radius,
+            .operation = edit.operation,
+            .material = edit.material,
+        });
+    }
 
-        if (lastSecond + std::chrono::seconds(1) <= std::chrono::steady_clock::now()) {
-            std::cout << "FPS: " << frameCounter << std::endl;
-            std::cout << camera.getPosition().x << ", " << camera.getPosition().y << ", " << camera.getPosition().z << std::endl;
-            frameCounter = 0;
-            lastSecond = std::chrono::steady_clock::now();
+    // Coarsens the detail farthest from the camera while the device memory in use approaches the budget
+    void updateMemoryBudget(glm::vec3 cameraPosition) {
+        memoryBudget = context.getMemoryBudget(frameNumber);
+        TreeBudgetReport report = computeScreen.treeManager.enforceMemoryBudget(
+            { cameraPosition.x, cameraPosition.y, cameraPosition.z }, memoryBudget.usage, memoryBudget.budget);
+        if (report.coarsened > 0) {
+            std::cout << "VRAM " << memoryBudget.usage / (1024 * 1024) << " of " << memoryBudget.budget / (1024 * 1024)
+                << " MiB, coarsened " << report.coarsened << " subtrees, evicted " << report.evictedNodes << " nodes & "
+                << report.evictedLeaves << " leaves, " << report.reusableBytes / 1024 << " KiB free for reuse" << std::endl;
         }
+    }
 
-        computeScreen.frameData.update(FrameUniforms{
-            .time = time,
-            .aperture = 0.001,
-            .focusDistance = 3.5,
-            .fov = 1.5,
-            .cameraPosition = camera.getPosition(),
-            .cameraDirection = camera.getDirection(),
+    // Stages of drawFrame, built once & run every frame. Input stays on the main thread with GLFW, the edit
+    // requests this frame slot's compute pass recorded are read back & rebuilt on a worker meanwhile. The tree is
+    // only touched by the readback & tree stages, one after the other
+    void buildFrameGraph() {
+        using Affinity = TaskGraph::Affinity;
+
+        TaskGraph::StageId fenceStage = frameGraph.add("fence", [this]() -> Task<> {
+            VkResult result = co_await waitFence(frameScheduler, static_cast<VkDevice>(*context.getDevice()),
+                static_cast<VkFence>(*syncObjects.getCurrentFence()));
+            if (result != VK_SUCCESS) {
+                throw std::runtime_error("failed to wait for the frame's fence!");
+            }
         });
 
-        context.getDevice().resetFences(*fence);
-        commandBuffers[currentFrame].reset();
-        recordCommandBuffer(imageIndex);
+        TaskGraph::StageId acquireStage = frameGraph.add("acquire", [this]() {
+            auto [result, imageIndex] = swapchainManager.getSwapChain().acquireNextImage(UINT64_MAX,
+                *syncObjects.getCurrentPresentSemaphore(), nullptr);
+            if (result == vk::Result::eErrorOutOfDateKHR || framebufferResized) {
+                frameState.swapchainStale = true;
+                frameGraph.cancel();
+                return;
+            }
+            frameState.imageIndex = imageIndex;
+        }, { fenceStage }, Affinity::Main);
+
+        // takeRequests forgets the slot's brushes, so a frame cancelled after this ran doesn't rebuild them twice
+        TaskGraph::StageId readbackStage = frameGraph.add("tree readback", [this]() {
+            computeScreen.rebuildTreeEdits(frameState.frameIndex);
+        }, { fenceStage });
+
+        TaskGraph::StageId inputStage = frameGraph.add("input", [this]() {
+            frameState.currentTime = std::chrono::high_resolution_clock::now();
+            float deltaTime = std::chrono::duration<float>(frameState.currentTime - lastTime).count();
+            frameState.time = std::chrono::duration<float>(frameState.currentTime - startTime).count();
+
+            if (replayTimings) {
+                // the last frames repeat the end of the path while their GPU timings are read back
+                const CameraPathFrame& frame = replay[std::min(replayFrame, replay.size() - 1)];
+                frameState.cameraPosition = frame.position;
+                frameState.cameraDirection = frame.direction;
+                frameState.time = replayFrame * CameraPath::fixedTimestep;
+                // deltaTime is how long the previous frame took
+                replayTimings->setCpu(int64_t(replayFrame) - 1, deltaTime * 1000.0);
+            } else {
+                camera.update(deltaTime);
+                frameState.cameraPosition = camera.getPosition();
+                frameState.cameraDirection = camera.getDirection();
+            }
+            updateRecording(frameState.cameraPosition, frameState.cameraDirection);
+            updateRenderQuality();
+            updateFovea();
+            updateTraceMode();
+            updateGovernor();
+            if (!replayTimings) {
+                frameState.editOperation = pollEditKeys();
+            }
+        }, { acquireStage }, Affinity::Main);
+
+        TaskGraph::StageId treeStage = frameGraph.add("tree", [this]() {
+            glm::vec3 cameraPosition = frameState.cameraPosition;
+            if (replayTimings && replayFrame < replay.size()) {
+                const CameraPathFrame& frame = replay[replayFrame];
+                if (frame.observerMoved) {
+                    computeScreen.treeManager.moveObserver({ frame.observer.x, frame.observer.y, frame.observer.z });
+                }
+                // the recorded spheres, not raycast again, so the replay makes the same edits
+                for (const CameraPathEdit& edit : frame.edits) {
+                    applyEdit(edit);
+                }
+            }
+            if (frameState.editOperation) {
+                updateEdits(cameraPosition, frameState.cameraDirection, *frameState.editOperation);
+            }
+            computeScreen.takeTreeEdits();
+            updateMemoryBudget(cameraPosition);
 
-        const vk::raii::Semaphore& renderSemaphore = syncObjects.getCurrentRenderSemaphore();
+            // reprojected start distances could skip over voxels that were added since the last frame
+            if (computeScreen.treeManager.getGPUVersion() != treeVersion) {
+                treeVersion = computeScreen.treeManager.getGPUVersion();
+                computeScreen.historyInvalid = true;
+            }
 
+            // tree uploads are separate submits, they're timed by the tree buffers themselves
+            double uploadMs = 0.0;
+            if (computeScreen.treeManager.takeUploadTime(uploadMs)) {
+                gpuProfiler.addSample("tree upload", uploadMs);
+            }
+        }, { inputStage, readbackStage });
+
+        TaskGraph::StageId uniformsStage = frameGraph.add("uniforms", [this]() {
+            glm::vec3 cameraPosition = frameState.cameraPosition;
+            glm::vec3 cameraDirection = frameState.cameraDirection;
+
+            if (lastSecond + std::chrono::seconds(1) <= std::chrono::steady_clock::now()) {
+                std::cout << "FPS: " << frameCounter << std::endl;
+                std::cout << gpuProfiler.summary() << std::endl;
+                std::cout << "VRAM: " << memoryBudget.usage / (1024 * 1024) << " of " << memoryBudget.budget / (1024 * 1024) << " MiB" << std::endl;
+                std::cout << cameraPosition.x << ", " << cameraPosition.y << ", " << cameraPosition.z << std::endl;
+                frameCounter = 0;
+                lastSecond = std::chrono::steady_clock::now();
+            }
+
+            if (frameNumber == 0) {
+                previousCameraPosition = cameraPosition;
+                previousCameraDirection = cameraDirection;
+            }
+
+            // this frame's fence was waited on, so its uniform buffer is free to overwrite
+            computeScreen.frameData.update(frameState.frameIndex, FrameUniforms{
+                .time = frameState.time,
+                .aperture = 0.001,
+                .focusDistance = 3.5,
+                .fov = 1.5,
+                .cameraPosition = cameraPosition,
+                .cameraDirection = cameraDirection,
+                .foveaCenter = fovea.center,
+                .foveaRadius = fovea.radius,
+                .foveaFalloff = fovea.falloff,
+                // foveation & checkerboard don't combine, checkerboard wins
+                .foveaLevels = checkerboard ? 0 : fovea.levels,
+                .frameNumber = frameNumber,
+                .checkerboard = checkerboard,
+                .previousCameraPosition = previousCameraPosition,
+                .previousCameraDirection = previousCameraDirection,
+                .renderSize = { computeScreen.renderWidth, computeScreen.renderHeight },
+                .reprojectStart = reprojectStart,
+                .coneStart = coneStart,
+                .lightingScale = computeScreen.lightingScale,
+                .wavefront = wavefront,
+                .stepHeatmap = stepHeatmap,
+                .lightCount = computeScreen.treeManager.getLightCount(),
+                // after the tree stage, the buffers may have been replaced growing
+                .treeNodes = computeScreen.treeManager.getNodeAddress(),
+                .treeLeaves = computeScreen.treeManager.getLeafAddress(),
+            });
+            computeScreen.renderData.update(frameState.frameIndex, getRenderPreset(renderQuality).uniforms);
+            previousCameraPosition = cameraPosition;
+            previousCameraDirection = cameraDirection;
+            frameNumber++;
+        }, { treeStage });
+
+        frameGraph.add("record", [this]() {
+            context.getDevice().resetFences(*syncObjects.getCurrentFence());
+            commandBuffers[frameState.frameIndex].reset();
+            presentCommandBuffers[frameState.frameIndex].reset();
+            recordCommandBuffer(frameState.imageIndex);
+        }, { uniformsStage }, Affinity::Main);
+    }
+
+    void recreateSwapChain() {
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        while (width == 0 || height == 0) {
+            glfwGetFramebufferSize(window, &width, &height);
+            glfwWaitEvents();
+        }
+        swapchainManager.recreateSwapChain(context, width, height);
+
+        computeScreen.resize(context.getAllocator(), context.getDevice(), context.getGraphicsQueueIndex(), swapchainManager.getSwapChainExtent().width, swapchainManager.getSwapChainExtent().height);
+        computeScreen.updateSwapchainDescriptors(context.getDevice(), swapchainManager.getSwapChainImageViews());
+    }
+
+    void drawFrame() {
+        frameState = FrameState{ .frameIndex = syncObjects.getCurrentFrame() };
+        frameGraph.run(frameScheduler);
+
+        if (frameState.swapchainStale) {
+            framebufferResized = false;
+            recreateSwapChain();
+            // TODO: reset semaphore in syncObjects
+            //presentCompleteSemaphores[semaphoreIndex] = vk::raii::Semaphore(context.getDevice(), vk::SemaphoreCreateInfo{});
+            return;
+        }
+
+        const vk::raii::Fence& fence = syncObjects.getCurrentFence();
+        const vk::raii::Semaphore& presentSemaphore = syncObjects.getCurrentPresentSemaphore();
+        int currentFrame = frameState.frameIndex;
+        uint32_t imageIndex = frameState.imageIndex;
+
+        if (replayTimings) {
+            // beginFrame just read back the timestamps this frame slot recorded MAX_FRAMES_IN_FLIGHT frames ago
+            replayTimings->setGpu(int64_t(replayFrame) - MAX_FRAMES_IN_FLIGHT, gpuProfiler.getStats("frame").last);
+            replayFrame++;
+            if (replayFrame > replay.size() + MAX_FRAMES_IN_FLIGHT) {
+                finishReplay();
+            }
+        }
+
+        const vk::raii::Semaphore& renderSemaphore = syncObjects.getRenderSemaphore(imageIndex);
+
+        // the direct present paths write the swapchain image from the compute or transfer stage, so that's where
+        // they wait for it. Only the second batch waits, the first one starts tracing before the image is acquired
         vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        vk::SubmitInfo submitInfo{
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &*presentSemaphore,
-            .pWaitDstStageMask = &waitStage,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &*commandBuffers[currentFrame],
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores = &*renderSemaphore,
+        if (swapchainManager.getPresentPath() == PresentPath::Storage) {
+            waitStage = vk::PipelineStageFlagBits::eComputeShader;
+        } else if (swapchainManager.getPresentPath() == PresentPath::Blit) {
+            waitStage = vk::PipelineStageFlagBits::eTransfer;
+        }
+        std::array<vk::SubmitInfo, 2> submitInfos = {
+            vk::SubmitInfo{
+                .commandBufferCount = 1,
+                .pCommandBuffers = &*commandBuffers[currentFrame],
+            },
+            vk::SubmitInfo{
+                .waitSemaphoreCount = 1,
+                .pWaitSemaphores = &*presentSemaphore,
+                .pWaitDstStageMask = &waitStage,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &*presentCommandBuffers[currentFrame],
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &*renderSemaphore,
+            },
         };
-        context.getGraphicsQueue().submit(submitInfo, *fence);
+        // the fence signals once both batches are done
+        context.getGraphicsQueue().submit(submitInfos, *fence);
 
         const vk::raii::SwapchainKHR& swapChain = swapchainManager.getSwapChain();
 
@@ -382,41 +933,74 @@ private:
         };
 
         try {
-            result = context.getPresentQueue().presentKHR(presentInfo);
+            vk::Result result = context.getPresentQueue().presentKHR(presentInfo);
             if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR || framebufferResized) {
                 framebufferResized = false;
-                int width = 0, height = 0;
-                glfwGetFramebufferSize(window, &width, &height);
-                while (width == 0 || height == 0) {
-                    glfwGetFramebufferSize(window, &width, &height);
-                    glfwWaitEvents();
-                }
-                swapchainManager.recreateSwapChain(context, width, height);
-
-                computeScreen.resize(context.getAllocator(), context.getDevice(), context.getGraphicsQueueIndex(), swapchainManager.getSwapChainExtent().width, swapchainManager.getSwapChainExtent().height);
+                recreateSwapChain();
             }
         }
         catch (const vk::SystemError& e) {
             if (e.code().value() == static_cast<int>(vk::Result::eErrorOutOfDateKHR)) {
-	            int width = 0, height = 0;
-	            glfwGetFramebufferSize(window, &width, &height);
-	            while (width == 0 || height == 0) {
-	                glfwGetFramebufferSize(window, &width, &height);
-	                glfwWaitEvents();
-	            }
-	            swapchainManager.recreateSwapChain(context, width, height);
-
-	            computeScreen.resize(context.getAllocator(), context.getDevice(), context.getGraphicsQueueIndex(), swapchainManager.getSwapChainExtent().width, swapchainManager.getSwapChainExtent().height);
+                recreateSwapChain();
             }
         }
 
         syncObjects.nextFrame();
         syncObjects.nextSemaphore();
         frameCounter++;
-        lastTime = currentTime;
+        lastTime = frameState.currentTime;
+    }
+
+    // Moves the tree's observer & records it, if the camera path is being recorded
+    void moveObserver(glm::vec3 position) {
+        computeScreen.treeManager.moveObserver({ position.x, position.y, position.z });
+        if (recordingPath) {
+            recording.addObserver(position);
+        }
+    }
+
+    // K starts recording the camera path, & stops it & saves it to options.recordPath
+    void updateRecording(glm::vec3 cameraPosition, glm::vec3 cameraDirection) {
+        bool recordKey = glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS;
+        if (recordKey && !recordKeyDown && !replayTimings) {
+            recordingPath = !recordingPath;
+            if (recordingPath) {
+                recording.clear();
+                std::cout << "recording camera path" << std::endl;
+            } else {
+                recording.save(options.recordPath);
+                std::cout << "saved " << recording.size() << " frames of camera path to " << options.recordPath << std::endl;
+            }
+        }
+        recordKeyDown = recordKey;
+
+        if (recordingPath) {
+            recording.addFrame(cameraPosition, cameraDirection);
+        }
+    }
+
+    void startReplay() {
+        replay.load(options.replayPath);
+        if (replay.empty()) {
+            throw std::runtime_error("Camera path has no frames: " + options.replayPath);
+        }
+        replayTimings = std::make_unique<ReplayTimings>(replay.size());
+        replayFrame = 0;
+        std::cout << "replaying " << replay.size() << " frames from " << options.replayPath << std::endl;
+    }
+
+    void finishReplay() {
+        replayTimings->writeCSV(options.timingsPath);
+        std::cout << "replay of " << replay.size() << " frames finished, timings in " << options.timingsPath << std::endl;
+        std::cout << replayTimings->summary() << std::endl;
+        replayTimings.reset();
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
 
     void mainLoop() {
+        if (!options.replayPath.empty()) {
+            startReplay();
+        }
         while (!glfwWindowShouldClose(window)) {
             glfwPollEvents();
             drawFrame();
@@ -426,13 +1010,52 @@ private:
     }
 };
 
-int main() {
+static void printUsage() {
+    std::cout << "usage: Aftermath [options]\n"
+        << "  --replay <file>      replay a camera path recorded with K, then write the timings & quit\n"
+        << "  --timings <file>     CSV of the replay's frame times (default replay_timings.csv)\n"
+        << "  --record <file>      where K saves the camera path (default camera_path.txt)\n"
+        << "  --vram-budget <f>    fraction of the device memory budget before distant detail is coarsened (default 0.85)\n";
+}
+
+static AppOptions parseOptions(int argc, char** argv) {
+    AppOptions options;
+
+    auto next = [&](int& i) -> std::string {
+        if (i + 1 >= argc) {
+            throw std::runtime_error(std::string("missing value for ") + argv[i]);
+        }
+        return argv[++i];
+    };
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--replay") options.replayPath = next(i);
+        else if (arg == "--timings") options.timingsPath = next(i);
+        else if (arg == "--record") options.recordPath = next(i);
+        else if (arg == "--vram-budget") options.memoryBudgetFraction = std::stof(next(i));
+        else if (arg == "--help" || arg == "-h") {
+            printUsage();
+            std::exit(EXIT_SUCCESS);
+        }
+        else {
+            printUsage();
+            throw std::runtime_error("unknown option: " + arg);
+        }
+    }
+
+    return options;
+}
+
+int main(int argc, char** argv) {
     std::cout << "Starting application..." << std::endl;
     std::cout.flush();
 
     try {
+        AppOptions options = parseOptions(argc, argv);
+
         std::cout << "Creating application object..." << std::endl;
-        MainApplication app;
+        MainApplication app(std::move(options));
 
         std::cout << "Running application..." << std::endl;
         app.run();
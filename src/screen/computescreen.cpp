@@ -1,6 +1,47 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
 #include <iostream>
+#include <stdexcept>
 #include "computescreen.hpp"
 
+// Storage image only used by the compute passes, at the size of the compute image
+static void createComputeImage(VmaAllocator allocator, const vk::raii::Device& device, uint32_t width, uint32_t height,
+    vk::Format format, VkImageUsageFlags usage, vk::Image& image, VmaAllocation& allocation, vk::raii::ImageView& view) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = static_cast<VkFormat>(format);
+    imageInfo.extent = { width, height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | usage;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+    VkImage vkImage;
+    if (vmaCreateImage(allocator, &imageInfo, &allocInfo, &vkImage, &allocation, nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute image");
+    }
+    image = vk::Image(vkImage);
+
+    vk::ImageViewCreateInfo viewInfo;
+    viewInfo.image = image;
+    viewInfo.viewType = vk::ImageViewType::e2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    view = vk::raii::ImageView(device, viewInfo);
+}
+
 void ComputeToScreen::createImage(VmaAllocator allocator, const vk::raii::Device& device, uint32_t w, uint32_t h) {
     width = w;
     height = h;
@@ -17,7 +58,8 @@ void ComputeToScreen::createImage(VmaAllocator allocator, const vk::raii::Device
     imageInfo.arrayLayers = 1;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // transfer source for the history copy
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     VmaAllocationCreateInfo allocInfo = {};
@@ -48,6 +90,124 @@ void ComputeToScreen::createImage(VmaAllocator allocator, const vk::raii::Device
     samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
 
     sampler = vk::raii::Sampler(device, samplerInfo);
+
+    // 4. Depth & history images, same size, only used by compute passes
+    createComputeImage(allocator, device, width, height, vk::Format::eR32Sfloat, VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        depthImage, depthAllocation, depthView);
+    createComputeImage(allocator, device, width, height, vk::Format::eR8G8B8A8Unorm, VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        historyImage, historyAllocation, historyView);
+    createComputeImage(allocator, device, width, height, vk::Format::eR32Sfloat, VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        historyDepthImage, historyDepthAllocation, historyDepthView);
+    createComputeImage(allocator, device, width, height, vk::Format::eR32Uint, VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        startDistanceImage, startDistanceAllocation, startDistanceView);
+    createComputeImage(allocator, device, (width + CONE_TILE - 1) / CONE_TILE, (height + CONE_TILE - 1) / CONE_TILE,
+        vk::Format::eR32Sfloat, 0, tileStartImage, tileStartAllocation, tileStartView);
+    createComputeImage(allocator, device, width, height, vk::Format::eR16G16B16A16Sfloat, 0,
+        gBufferImage, gBufferAllocation, gBufferView);
+    createComputeImage(allocator, device, width, height, vk::Format::eR32Sfloat, 0,
+        shadowImage, shadowAllocation, shadowView);
+
+    VkBufferCreateInfo queueInfo{};
+    queueInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    queueInfo.size = sizeof(ShadowQueueHeader) + sizeof(uint32_t) * width * height;
+    // indirect for the shadow dispatch, transfer dst to reset the header every frame
+    queueInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    queueInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo queueAllocInfo{};
+    queueAllocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+    if (vmaCreateBuffer(allocator, &queueInfo, &queueAllocInfo, &shadowQueueBuffer, &shadowQueueAllocation, nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shadow queue buffer");
+    }
+
+    VkBufferCreateInfo counterInfo = queueInfo;
+    counterInfo.size = sizeof(uint32_t);
+    counterInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    if (vmaCreateBuffer(allocator, &counterInfo, &queueAllocInfo, &tileCounterBuffer, &tileCounterAllocation, nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create tile counter buffer");
+    }
+
+    createComputeImage(allocator, device, (width + 15) / 16, (height + 15) / 16, vk::Format::eR32Uint,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT, tileStepsImage, tileStepsAllocation, tileStepsView);
+
+    VkBufferCreateInfo clusterInfo = queueInfo;
+    clusterInfo.size = sizeof(uint32_t) * CLUSTER_STRIDE * CLUSTER_SLICES *
+        ((width + CLUSTER_TILE - 1) / CLUSTER_TILE) * ((height + CLUSTER_TILE - 1) / CLUSTER_TILE);
+    clusterInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+    if (vmaCreateBuffer(allocator, &clusterInfo, &queueAllocInfo, &clusterBuffer, &clusterAllocation, nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create light cluster buffer");
+    }
+
+    uint32_t binPixels = CLUSTER_TILE * CLUSTER_BIN;
+    VkBufferCreateInfo binInfo = clusterInfo;
+    binInfo.size = sizeof(uint32_t) * BIN_STRIDE * ((width + binPixels - 1) / binPixels) *
+        ((height + binPixels - 1) / binPixels);
+
+    if (vmaCreateBuffer(allocator, &binInfo, &queueAllocInfo, &lightBinBuffer, &lightBinAllocation, nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create light bin buffer");
+    }
+
+    updateRenderSize();
+    imagesUndefined = true;
+}
+
+void ComputeToScreen::destroyImage(VmaAllocator allocator) {
+    view = nullptr;
+    depthView = nullptr;
+    historyView = nullptr;
+    historyDepthView = nullptr;
+    startDistanceView = nullptr;
+    tileStartView = nullptr;
+    gBufferView = nullptr;
+    shadowView = nullptr;
+    tileStepsView = nullptr;
+    vmaDestroyImage(allocator, VkImage(image), allocation);
+    vmaDestroyImage(allocator, VkImage(depthImage), depthAllocation);
+    vmaDestroyImage(allocator, VkImage(historyImage), historyAllocation);
+    vmaDestroyImage(allocator, VkImage(historyDepthImage), historyDepthAllocation);
+    vmaDestroyImage(allocator, VkImage(startDistanceImage), startDistanceAllocation);
+    vmaDestroyImage(allocator, VkImage(tileStartImage), tileStartAllocation);
+    vmaDestroyImage(allocator, VkImage(gBufferImage), gBufferAllocation);
+    vmaDestroyImage(allocator, VkImage(shadowImage), shadowAllocation);
+    vmaDestroyBuffer(allocator, shadowQueueBuffer, shadowQueueAllocation);
+    vmaDestroyBuffer(allocator, tileCounterBuffer, tileCounterAllocation);
+    vmaDestroyImage(allocator, VkImage(tileStepsImage), tileStepsAllocation);
+    vmaDestroyBuffer(allocator, clusterBuffer, clusterAllocation);
+    vmaDestroyBuffer(allocator, lightBinBuffer, lightBinAllocation);
+}
+
+void ComputeToScreen::setRenderScale(float scale) {
+    renderScale = std::clamp(scale, 0.25f, 1.0f);
+    updateRenderSize();
+}
+
+void ComputeToScreen::updateRenderSize() {
+    uint32_t newWidth = std::clamp(uint32_t(std::ceil(width * renderScale)), 1u, width);
+    uint32_t newHeight = std::clamp(uint32_t(std::ceil(height * renderScale)), 1u, height);
+    if (newWidth != renderWidth || newHeight != renderHeight) {
+        // the history was rendered at another size, reprojecting from it would be wrong
+        historyInvalid = true;
+    }
+    renderWidth = newWidth;
+    renderHeight = newHeight;
+}
+
+void ComputeToScreen::setLightingScale(uint32_t scale) {
+    lightingScale = scale >= 4 ? 4 : scale >= 2 ? 2 : 1;
+}
+
+ScreenPushConstants ComputeToScreen::getScreenPushConstants() const {
+    glm::vec2 imageSize(width, height);
+    glm::vec2 renderSize(renderWidth, renderHeight);
+    return {
+        .uvScale = renderSize / imageSize,
+        // half a pixel in, so bilinear filtering never reads past the rendered pixels
+        .uvMax = (renderSize - 0.5f) / imageSize,
+    };
 }
 
 void ComputeToScreen::updateImageDescriptors(const vk::raii::Device& device) {
@@ -63,7 +223,145 @@ void ComputeToScreen::updateImageDescriptors(const vk::raii::Device& device) {
     storageImageWrite.descriptorType = vk::DescriptorType::eStorageImage;
     storageImageWrite.pImageInfo = &storageImageInfo;
 
-    device.updateDescriptorSets(storageImageWrite, nullptr);
+    vk::DescriptorImageInfo depthImageInfo;
+    depthImageInfo.imageView = *depthView;
+    depthImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+    vk::WriteDescriptorSet depthImageWrite;
+    depthImageWrite.dstSet = computeSet;
+    depthImageWrite.dstBinding = 5;
+    depthImageWrite.descriptorCount = 1;
+    depthImageWrite.descriptorType = vk::DescriptorType::eStorageImage;
+    depthImageWrite.pImageInfo = &depthImageInfo;
+
+    vk::DescriptorImageInfo historyImageInfo;
+    historyImageInfo.imageView = *historyView;
+    historyImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+    vk::WriteDescriptorSet historyImageWrite;
+    historyImageWrite.dstSet = computeSet;
+    historyImageWrite.dstBinding = 6;
+    historyImageWrite.descriptorCount = 1;
+    historyImageWrite.descriptorType = vk::DescriptorType::eStorageImage;
+    historyImageWrite.pImageInfo = &historyImageInfo;
+
+    vk::DescriptorImageInfo historyDepthImageInfo;
+    historyDepthImageInfo.imageView = *historyDepthView;
+    historyDepthImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+    vk::WriteDescriptorSet historyDepthImageWrite;
+    historyDepthImageWrite.dstSet = computeSet;
+    historyDepthImageWrite.dstBinding = 7;
+    historyDepthImageWrite.descriptorCount = 1;
+    historyDepthImageWrite.descriptorType = vk::DescriptorType::eStorageImage;
+    historyDepthImageWrite.pImageInfo = &historyDepthImageInfo;
+
+    vk::DescriptorImageInfo startDistanceImageInfo;
+    startDistanceImageInfo.imageView = *startDistanceView;
+    startDistanceImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+    vk::WriteDescriptorSet startDistanceImageWrite;
+    startDistanceImageWrite.dstSet = computeSet;
+    startDistanceImageWrite.dstBinding = 8;
+    startDistanceImageWrite.descriptorCount = 1;
+    startDistanceImageWrite.descriptorType = vk::DescriptorType::eStorageImage;
+    startDistanceImageWrite.pImageInfo = &startDistanceImageInfo;
+
+    vk::DescriptorImageInfo tileStartImageInfo;
+    tileStartImageInfo.imageView = *tileStartView;
+    tileStartImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+    vk::WriteDescriptorSet tileStartImageWrite;
+    tileStartImageWrite.dstSet = computeSet;
+    tileStartImageWrite.dstBinding = 9;
+    tileStartImageWrite.descriptorCount = 1;
+    tileStartImageWrite.descriptorType = vk::DescriptorType::eStorageImage;
+    tileStartImageWrite.pImageInfo = &tileStartImageInfo;
+
+    vk::DescriptorImageInfo gBufferImageInfo;
+    gBufferImageInfo.imageView = *gBufferView;
+    gBufferImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+    vk::WriteDescriptorSet gBufferImageWrite;
+    gBufferImageWrite.dstSet = computeSet;
+    gBufferImageWrite.dstBinding = 10;
+    gBufferImageWrite.descriptorCount = 1;
+    gBufferImageWrite.descriptorType = vk::DescriptorType::eStorageImage;
+    gBufferImageWrite.pImageInfo = &gBufferImageInfo;
+
+    vk::DescriptorImageInfo shadowImageInfo;
+    shadowImageInfo.imageView = *shadowView;
+    shadowImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+    vk::WriteDescriptorSet shadowImageWrite;
+    shadowImageWrite.dstSet = computeSet;
+    shadowImageWrite.dstBinding = 11;
+    shadowImageWrite.descriptorCount = 1;
+    shadowImageWrite.descriptorType = vk::DescriptorType::eStorageImage;
+    shadowImageWrite.pImageInfo = &shadowImageInfo;
+
+    vk::DescriptorBufferInfo shadowQueueInfo;
+    shadowQueueInfo.buffer = shadowQueueBuffer;
+    shadowQueueInfo.offset = 0;
+    shadowQueueInfo.range = VK_WHOLE_SIZE;
+
+    vk::WriteDescriptorSet shadowQueueWrite;
+    shadowQueueWrite.dstSet = computeSet;
+    shadowQueueWrite.dstBinding = 12;
+    shadowQueueWrite.descriptorCount = 1;
+    shadowQueueWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+    shadowQueueWrite.pBufferInfo = &shadowQueueInfo;
+
+    vk::DescriptorBufferInfo tileCounterInfo;
+    tileCounterInfo.buffer = tileCounterBuffer;
+    tileCounterInfo.offset = 0;
+    tileCounterInfo.range = VK_WHOLE_SIZE;
+
+    vk::WriteDescriptorSet tileCounterWrite;
+    tileCounterWrite.dstSet = computeSet;
+    tileCounterWrite.dstBinding = 13;
+    tileCounterWrite.descriptorCount = 1;
+    tileCounterWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+    tileCounterWrite.pBufferInfo = &tileCounterInfo;
+
+    vk::DescriptorImageInfo tileStepsImageInfo;
+    tileStepsImageInfo.imageView = *tileStepsView;
+    tileStepsImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+    vk::WriteDescriptorSet tileStepsImageWrite;
+    tileStepsImageWrite.dstSet = computeSet;
+    tileStepsImageWrite.dstBinding = 14;
+    tileStepsImageWrite.descriptorCount = 1;
+    tileStepsImageWrite.descriptorType = vk::DescriptorType::eStorageImage;
+    tileStepsImageWrite.pImageInfo = &tileStepsImageInfo;
+
+    vk::DescriptorBufferInfo clusterInfo;
+    clusterInfo.buffer = clusterBuffer;
+    clusterInfo.offset = 0;
+    clusterInfo.range = VK_WHOLE_SIZE;
+
+    vk::WriteDescriptorSet clusterWrite;
+    clusterWrite.dstSet = computeSet;
+    clusterWrite.dstBinding = 16;
+    clusterWrite.descriptorCount = 1;
+    clusterWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+    clusterWrite.pBufferInfo = &clusterInfo;
+
+    vk::DescriptorBufferInfo lightBinInfo;
+    lightBinInfo.buffer = lightBinBuffer;
+    lightBinInfo.offset = 0;
+    lightBinInfo.range = VK_WHOLE_SIZE;
+
+    vk::WriteDescriptorSet lightBinWrite;
+    lightBinWrite.dstSet = computeSet;
+    lightBinWrite.dstBinding = 17;
+    lightBinWrite.descriptorCount = 1;
+    lightBinWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+    lightBinWrite.pBufferInfo = &lightBinInfo;
+
+    device.updateDescriptorSets({ storageImageWrite, depthImageWrite, historyImageWrite, historyDepthImageWrite,
+        startDistanceImageWrite, tileStartImageWrite, gBufferImageWrite, shadowImageWrite, shadowQueueWrite,
+        tileCounterWrite, tileStepsImageWrite, clusterWrite, lightBinWrite }, nullptr);
 
     // Update graphics set - sampled image and sampler
     vk::DescriptorImageInfo sampledImageInfo;
@@ -89,38 +387,141 @@ void ComputeToScreen::updateImageDescriptors(const vk::raii::Device& device) {
     device.updateDescriptorSets(graphicsWrites, nullptr);
 }
 
-void ComputeToScreen::create(VmaAllocator allocator, const vk::raii::Device& device, uint32_t queueFamilyIndex, uint32_t w, uint32_t h) {
+void ComputeToScreen::updateSwapchainDescriptors(const vk::raii::Device& device,
+    const std::vector<vk::raii::ImageView>& swapchainViews) {
+    // the sets go back to the old pool before it's destroyed
+    swapchainSets = nullptr;
+    swapchainPool = nullptr;
+
+    vk::DescriptorPoolSize poolSize;
+    poolSize.type = vk::DescriptorType::eStorageImage;
+    poolSize.descriptorCount = swapchainViews.size();
+
+    vk::DescriptorPoolCreateInfo poolInfo;
+    poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+    poolInfo.maxSets = swapchainViews.size();
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    swapchainPool = vk::raii::DescriptorPool(device, poolInfo);
+
+    std::vector<vk::DescriptorSetLayout> layouts(swapchainViews.size(), *swapchainLayout);
+    vk::DescriptorSetAllocateInfo allocInfo;
+    allocInfo.descriptorPool = *swapchainPool;
+    allocInfo.descriptorSetCount = layouts.size();
+    allocInfo.pSetLayouts = layouts.data();
+
+    swapchainSets = vk::raii::DescriptorSets(device, allocInfo);
+
+    std::vector<vk::DescriptorImageInfo> imageInfos(swapchainViews.size());
+    std::vector<vk::WriteDescriptorSet> writes(swapchainViews.size());
+    for (size_t i = 0; i < swapchainViews.size(); i++) {
+        imageInfos[i].imageView = *swapchainViews[i];
+        imageInfos[i].imageLayout = vk::ImageLayout::eGeneral;
+
+        writes[i].dstSet = *swapchainSets[i];
+        writes[i].dstBinding = 0;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = vk::DescriptorType::eStorageImage;
+        writes[i].pImageInfo = &imageInfos[i];
+    }
+    device.updateDescriptorSets(writes, nullptr);
+}
+
+void ComputeToScreen::create(VmaAllocator allocator, const vk::raii::Device& device, uint32_t queueFamilyIndex, uint32_t w, uint32_t h, uint32_t framesInFlight) {
     vmaAllocator = allocator;
 
     createImage(allocator, device, w, h);
 
-    treeManager.initBuffers(allocator, *device, queueFamilyIndex);
-    treeManager.createTestTree();
-    treeManager.uploadToGPU();
-
     // 4. Create descriptor set layouts
-    vk::DescriptorSetLayoutBinding computeBindings[3];
+    // the tree's nodes & leaves aren't bound, they're read through the addresses in FrameUniforms
+    vk::DescriptorSetLayoutBinding computeBindings[14];
 
-    // Binding 3: Tree storage buffer
-    computeBindings[0].binding = 3;
-    computeBindings[0].descriptorType = vk::DescriptorType::eStorageBuffer;
+    computeBindings[0].binding = 2;  // Storage image
+    computeBindings[0].descriptorType = vk::DescriptorType::eStorageImage;
     computeBindings[0].descriptorCount = 1;
     computeBindings[0].stageFlags = vk::ShaderStageFlagBits::eCompute;
 
     computeBindings[1] = {};
-    computeBindings[1].binding = 4;  // Tree leaves
-    computeBindings[1].descriptorType = vk::DescriptorType::eStorageBuffer;
+    computeBindings[1].binding = 5;  // Depth image
+    computeBindings[1].descriptorType = vk::DescriptorType::eStorageImage;
     computeBindings[1].descriptorCount = 1;
     computeBindings[1].stageFlags = vk::ShaderStageFlagBits::eCompute;
 
     computeBindings[2] = {};
-    computeBindings[2].binding = 2;  // Storage image
+    computeBindings[2].binding = 6;  // History color image
     computeBindings[2].descriptorType = vk::DescriptorType::eStorageImage;
     computeBindings[2].descriptorCount = 1;
     computeBindings[2].stageFlags = vk::ShaderStageFlagBits::eCompute;
 
+    computeBindings[3] = {};
+    computeBindings[3].binding = 7;  // History depth image
+    computeBindings[3].descriptorType = vk::DescriptorType::eStorageImage;
+    computeBindings[3].descriptorCount = 1;
+    computeBindings[3].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    computeBindings[4] = {};
+    computeBindings[4].binding = 8;  // Start distance image
+    computeBindings[4].descriptorType = vk::DescriptorType::eStorageImage;
+    computeBindings[4].descriptorCount = 1;
+    computeBindings[4].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    computeBindings[5] = {};
+    computeBindings[5].binding = 9;  // Tile start distance image
+    computeBindings[5].descriptorType = vk::DescriptorType::eStorageImage;
+    computeBindings[5].descriptorCount = 1;
+    computeBindings[5].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    computeBindings[6] = {};
+    computeBindings[6].binding = 10;  // G-buffer image
+    computeBindings[6].descriptorType = vk::DescriptorType::eStorageImage;
+    computeBindings[6].descriptorCount = 1;
+    computeBindings[6].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    computeBindings[7] = {};
+    computeBindings[7].binding = 11;  // Shadow image
+    computeBindings[7].descriptorType = vk::DescriptorType::eStorageImage;
+    computeBindings[7].descriptorCount = 1;
+    computeBindings[7].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    computeBindings[8] = {};
+    computeBindings[8].binding = 12;  // Shadow queue buffer
+    computeBindings[8].descriptorType = vk::DescriptorType::eStorageBuffer;
+    computeBindings[8].descriptorCount = 1;
+    computeBindings[8].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    computeBindings[9] = {};
+    computeBindings[9].binding = 13;  // Tile counter buffer
+    computeBindings[9].descriptorType = vk::DescriptorType::eStorageBuffer;
+    computeBindings[9].descriptorCount = 1;
+    computeBindings[9].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    computeBindings[10] = {};
+    computeBindings[10].binding = 14;  // Tile steps image
+    computeBindings[10].descriptorType = vk::DescriptorType::eStorageImage;
+    computeBindings[10].descriptorCount = 1;
+    computeBindings[10].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    computeBindings[11] = {};
+    computeBindings[11].binding = 15;  // Point lights
+    computeBindings[11].descriptorType = vk::DescriptorType::eStorageBuffer;
+    computeBindings[11].descriptorCount = 1;
+    computeBindings[11].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    computeBindings[12] = {};
+    computeBindings[12].binding = 16;  // Light clusters
+    computeBindings[12].descriptorType = vk::DescriptorType::eStorageBuffer;
+    computeBindings[12].descriptorCount = 1;
+    computeBindings[12].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    computeBindings[13] = {};
+    computeBindings[13].binding = 17;  // Light bins
+    computeBindings[13].descriptorType = vk::DescriptorType::eStorageBuffer;
+    computeBindings[13].descriptorCount = 1;
+    computeBindings[13].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
     vk::DescriptorSetLayoutCreateInfo computeLayoutInfo;
-    computeLayoutInfo.bindingCount = 3;
+    computeLayoutInfo.bindingCount = 14;
     computeLayoutInfo.pBindings = computeBindings;
 
     computeLayout = vk::raii::DescriptorSetLayout(device, computeLayoutInfo);
@@ -146,13 +547,14 @@ void ComputeToScreen::create(VmaAllocator allocator, const vk::raii::Device& dev
     // 5. Create descriptor pool
     vk::DescriptorPoolSize poolSizes[4];
 
-    // compute - storage buffer
+    // compute - storage buffers, shadow queue, tile counter, point lights, clusters & bins
     poolSizes[0].type = vk::DescriptorType::eStorageBuffer;
-    poolSizes[0].descriptorCount = 2;
+    poolSizes[0].descriptorCount = 5;
 
-    // compute - storage image
+    // compute - storage images, color & depth, current & history, start distances per pixel & tile,
+    // G-buffer & shadows, tile steps
     poolSizes[1].type = vk::DescriptorType::eStorageImage;
-    poolSizes[1].descriptorCount = 1;
+    poolSizes[1].descriptorCount = 9;
 
     // graphics - sampled image
     poolSizes[2].type = vk::DescriptorType::eSampledImage;
@@ -183,36 +585,6 @@ void ComputeToScreen::create(VmaAllocator allocator, const vk::raii::Device& dev
     graphicsSets = vk::raii::DescriptorSets(device, allocInfoDesc);
     graphicsSet = *graphicsSets[0];
 
-    // 7. Update descriptor sets
-    // Tree buffer descriptor info
-    // Tree nodes buffer
-    VkDescriptorBufferInfo nodesBufferInfo{};
-    nodesBufferInfo.buffer = treeManager.getNodeBuffer();
-    nodesBufferInfo.offset = 0;
-    nodesBufferInfo.range = VK_WHOLE_SIZE;
-
-    VkWriteDescriptorSet nodesWrite{};
-    nodesWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    nodesWrite.dstSet = VkDescriptorSet(computeSet);
-    nodesWrite.dstBinding = 3;
-    nodesWrite.descriptorCount = 1;
-    nodesWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    nodesWrite.pBufferInfo = &nodesBufferInfo;
-
-    // Tree leaves buffer
-    VkDescriptorBufferInfo leavesBufferInfo{};
-    leavesBufferInfo.buffer = treeManager.getLeafBuffer();
-    leavesBufferInfo.offset = 0;
-    leavesBufferInfo.range = VK_WHOLE_SIZE;
-
-    VkWriteDescriptorSet leavesWrite{};
-    leavesWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    leavesWrite.dstSet = VkDescriptorSet(computeSet);
-    leavesWrite.dstBinding = 4;
-    leavesWrite.descriptorCount = 1;
-    leavesWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    leavesWrite.pBufferInfo = &leavesBufferInfo;
-
     // Storage image
     vk::DescriptorImageInfo storageImageInfo;
     storageImageInfo.imageView = *view;
@@ -225,47 +597,146 @@ void ComputeToScreen::create(VmaAllocator allocator, const vk::raii::Device& dev
     storageImageWrite.descriptorType = vk::DescriptorType::eStorageImage;
     storageImageWrite.pImageInfo = &storageImageInfo;
 
-    VkWriteDescriptorSet writes[] = { nodesWrite, leavesWrite };
-    vkUpdateDescriptorSets(view.getDevice(), 2, writes, 0, nullptr);
-
     // Update image and sampler descriptors
     updateImageDescriptors(device);
 
-    frameData.create(device, allocator);
-    descriptorSets = {
-        computeSet,                    // set 0: storage buffer (tree) + storage image
-        frameData.getDescriptorSet()   // set 1: frame uniforms
-    };
+    frameData.create(device, allocator, framesInFlight);
+    renderData.create(device, allocator, framesInFlight);
+
+    vk::DescriptorSetLayoutBinding swapchainBinding;
+    swapchainBinding.binding = 0;  // Swapchain image
+    swapchainBinding.descriptorType = vk::DescriptorType::eStorageImage;
+    swapchainBinding.descriptorCount = 1;
+    swapchainBinding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    vk::DescriptorSetLayoutCreateInfo swapchainLayoutInfo;
+    swapchainLayoutInfo.bindingCount = 1;
+    swapchainLayoutInfo.pBindings = &swapchainBinding;
+
+    swapchainLayout = vk::raii::DescriptorSetLayout(device, swapchainLayoutInfo);
 
     std::vector<vk::DescriptorSetLayout> setLayouts = {
-        *computeLayout,                     // set 0
-        frameData.getDescriptorSetLayout(), // set 1
+        *computeLayout,                      // set 0
+        frameData.getDescriptorSetLayout(),  // set 1
+        renderData.getDescriptorSetLayout(), // set 2
+        *swapchainLayout,                    // set 3, only bound by storeToSwapchain
     };
 
     // 8. Create pipeline layouts
     vk::PipelineLayoutCreateInfo computePipelineLayoutInfo;
-    computePipelineLayoutInfo.setLayoutCount = 2;
+    computePipelineLayoutInfo.setLayoutCount = setLayouts.size();
     computePipelineLayoutInfo.pSetLayouts = setLayouts.data();
 
     computePipelineLayout = vk::raii::PipelineLayout(device, computePipelineLayoutInfo);
 
+    vk::PushConstantRange screenPushConstantRange;
+    screenPushConstantRange.stageFlags = vk::ShaderStageFlagBits::eFragment;
+    screenPushConstantRange.offset = 0;
+    screenPushConstantRange.size = sizeof(ScreenPushConstants);
+
     vk::PipelineLayoutCreateInfo graphicsPipelineLayoutInfo;
     graphicsPipelineLayoutInfo.setLayoutCount = 1;
     graphicsPipelineLayoutInfo.pSetLayouts = &(*graphicsLayout);
+    graphicsPipelineLayoutInfo.pushConstantRangeCount = 1;
+    graphicsPipelineLayoutInfo.pPushConstantRanges = &screenPushConstantRange;
 
     graphicsPipelineLayout = vk::raii::PipelineLayout(device, graphicsPipelineLayoutInfo);
 }
 
+void ComputeToScreen::loadTree(VmaAllocator allocator, const vk::raii::Device& device, uint32_t queueFamilyIndex,
+    const std::string& treePath, const std::string& treeBuildShader) {
+    treeManager.initBuffers(allocator, *device, queueFamilyIndex);
+    bool builtOnGPU = false;
+    if (!treePath.empty()) {
+        treeManager.loadFromFile(treePath);
+    } else if (!treeBuildShader.empty()) {
+        try {
+            treeManager.buildOnGPU(allocator, *device, queueFamilyIndex, treeBuildShader);
+            builtOnGPU = true;
+        } catch (const std::exception& e) {
+            std::cerr << "GPU tree build failed, building on the CPU: " << e.what() << std::endl;
+            treeManager.createTestTree();
+        }
+    } else {
+        treeManager.createTestTree();
+    }
+    // the GPU build leaves the tree in the buffers already
+    if (!builtOnGPU) {
+        treeManager.uploadToGPU();
+    }
+
+    updateTreeDescriptors(device);
+}
+
+void ComputeToScreen::updateTreeDescriptors(const vk::raii::Device& device) {
+    // Point lights of the tree's torches, the nodes & leaves are passed by address in FrameUniforms
+    VkDescriptorBufferInfo lightsBufferInfo{};
+    lightsBufferInfo.buffer = treeManager.getLightBuffer();
+    lightsBufferInfo.offset = 0;
+    lightsBufferInfo.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet lightsWrite{};
+    lightsWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    lightsWrite.dstSet = VkDescriptorSet(computeSet);
+    lightsWrite.dstBinding = 15;
+    lightsWrite.descriptorCount = 1;
+    lightsWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    lightsWrite.pBufferInfo = &lightsBufferInfo;
+
+    vkUpdateDescriptorSets(*device, 1, &lightsWrite, 0, nullptr);
+}
+
+void ComputeToScreen::createTreeEditor(VmaAllocator allocator, const vk::raii::Device& device, const std::string& shaderPath,
+    uint32_t framesInFlight) {
+    try {
+        treeEditor.init(allocator, *device, shaderPath, framesInFlight);
+    } catch (const std::exception& e) {
+        std::cerr << "GPU tree editor unavailable, edits are uploaded by the CPU: " << e.what() << std::endl;
+        treeEditor.destroy();
+    }
+}
+
+void ComputeToScreen::rebuildTreeEdits(uint32_t frameIndex) {
+    if (!treeEditor.isReady()) {
+        return;
+    }
+    std::vector<EditRequest> requests;
+    std::vector<EditBrush> overflowed;
+    if (!treeEditor.takeRequests(frameIndex, requests, overflowed)) {
+        std::cout << "tree edits needed more than " << MAX_EDIT_REQUESTS << " nodes rebuilt, finding them on the CPU" << std::endl;
+        treeManager.findEditRequests(overflowed, requests);
+    }
+    treeManager.rebuildEditedNodes(requests);
+    // buffers replaced growing need no descriptor writes, the frame's uniforms get their new addresses
+}
+
+void ComputeToScreen::takeTreeEdits() {
+    if (treeEditor.isReady()) {
+        frameEdits = treeManager.takePendingEdits(MAX_EDITS_PER_FRAME);
+        return;
+    }
+    std::vector<EditBrush> brushes = treeManager.takePendingEdits(UINT32_MAX);
+    if (!brushes.empty()) {
+        std::vector<EditRequest> requests;
+        treeManager.findEditRequests(brushes, requests);
+        treeManager.rebuildEditedNodes(requests);
+        // the leaves applyEdit changed in place
+        treeManager.updateGPUBuffers();
+    }
+}
+
 void ComputeToScreen::destroy(VmaAllocator allocator) {
+    treeEditor.destroy();
     treeManager.destroyBuffers();
 
     // RAII objects will be destroyed automatically
-    vmaDestroyImage(allocator, VkImage(image), allocation);
+    destroyImage(allocator);
     frameData.destroy();
+    renderData.destroy();
 }
 
 void ComputeToScreen::resize(VmaAllocator allocator, const vk::raii::Device& device, uint32_t queueFamilyIndex, uint32_t w, uint32_t h) {
-    vmaDestroyImage(allocator, VkImage(image), allocation);
+    destroyImage(allocator);
 
     createImage(allocator, device, w, h);
     updateImageDescriptors(device);
@@ -282,19 +753,271 @@ void ComputeToScreen::initialTransition(const vk::raii::CommandBuffer& cmd) {
     barrier.subresourceRange.levelCount = 1;
     barrier.subresourceRange.layerCount = 1;
 
+    std::array<vk::ImageMemoryBarrier, 9> barriers;
+    barriers.fill(barrier);
+    barriers[1].image = depthImage;
+    barriers[2].image = historyImage;
+    barriers[3].image = historyDepthImage;
+    barriers[4].image = startDistanceImage;
+    barriers[5].image = tileStartImage;
+    barriers[6].image = gBufferImage;
+    barriers[7].image = shadowImage;
+    barriers[8].image = tileStepsImage;
+    barriers[8].dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barriers[2].dstAccessMask = barriers[3].dstAccessMask = barriers[4].dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
     cmd.pipelineBarrier(
         vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags{},
+        nullptr,
+        nullptr,
+        barriers
+    );
+}
+
+void ComputeToScreen::clearHistory(const vk::raii::CommandBuffer& cmd) {
+    // a history depth of 0 never matches a reprojected depth, so every pixel falls back to the current frame
+    vk::ClearColorValue clearDepth(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 0.0f });
+    vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    cmd.clearColorImage(historyDepthImage, vk::ImageLayout::eGeneral, clearDepth, range);
+
+    vk::MemoryBarrier clearBarrier;
+    clearBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    clearBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags{},
+        clearBarrier,
+        nullptr,
+        nullptr
+    );
+}
+
+void ComputeToScreen::reprojectStartDistances(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& reprojectPipeline) {
+    // EMPTY_START in reprojection.slang
+    vk::ClearColorValue empty(std::array<uint32_t, 4>{ 0xFFFFFFFF, 0, 0, 0 });
+    vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    cmd.clearColorImage(startDistanceImage, vk::ImageLayout::eGeneral, empty, range);
+
+    // last frame's trace read the start distances before they're cleared, the scatter needs the clear
+    vk::MemoryBarrier clearBarrier;
+    clearBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    clearBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
         vk::PipelineStageFlagBits::eComputeShader,
         vk::DependencyFlags{},
+        clearBarrier,
         nullptr,
+        nullptr
+    );
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *reprojectPipeline);
+    cmd.dispatch((renderWidth + 15) / 16, (renderHeight + 15) / 16, 1);
+
+    vk::MemoryBarrier scatterBarrier;
+    scatterBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    scatterBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags{},
+        scatterBarrier,
         nullptr,
-        barrier
+        nullptr
+    );
+}
+
+void ComputeToScreen::coneStartDistances(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& conePipeline) {
+    // one thread per tile, 8x8 threads per group
+    uint32_t tilesX = (renderWidth + CONE_TILE - 1) / CONE_TILE;
+    uint32_t tilesY = (renderHeight + CONE_TILE - 1) / CONE_TILE;
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *conePipeline);
+    cmd.dispatch((tilesX + 7) / 8, (tilesY + 7) / 8, 1);
+
+    vk::MemoryBarrier coneBarrier;
+    coneBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    coneBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags{},
+        coneBarrier,
+        nullptr,
+        nullptr
+    );
+}
+
+void ComputeToScreen::resetShadowQueue(const vk::raii::CommandBuffer& cmd) {
+    // last frame's shadow dispatch read the header as its indirect arguments & the queue as rays
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags{},
+        nullptr,
+        nullptr,
+        nullptr
+    );
+
+    // no groups & no rays, the trace counts both up
+    ShadowQueueHeader empty = { .dispatch = { 0, 1, 1 }, .count = 0 };
+    cmd.updateBuffer<ShadowQueueHeader>(shadowQueueBuffer, 0, empty);
+
+    vk::MemoryBarrier resetBarrier;
+    resetBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    resetBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags{},
+        resetBarrier,
+        nullptr,
+        nullptr
+    );
+}
+
+void ComputeToScreen::cullLights(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& binPipeline,
+    const vk::raii::Pipeline& cullPipeline) {
+    vk::MemoryBarrier cullBarrier;
+    cullBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    cullBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+    // one workgroup per bin, tests every light
+    uint32_t binPixels = CLUSTER_TILE * CLUSTER_BIN;
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *binPipeline);
+    cmd.dispatch((renderWidth + binPixels - 1) / binPixels, (renderHeight + binPixels - 1) / binPixels, 1);
+
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags{},
+        cullBarrier,
+        nullptr,
+        nullptr
+    );
+
+    // one workgroup per cluster tile, covering all of its slices, tests the lights of its bin
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *cullPipeline);
+    cmd.dispatch((renderWidth + CLUSTER_TILE - 1) / CLUSTER_TILE, (renderHeight + CLUSTER_TILE - 1) / CLUSTER_TILE, 1);
+
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags{},
+        cullBarrier,
+        nullptr,
+        nullptr
+    );
+}
+
+void ComputeToScreen::resetTileCounters(const vk::raii::CommandBuffer& cmd, bool counter, bool steps) {
+    // last frame's trace & heatmap are done with them
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags{},
+        nullptr,
+        nullptr,
+        nullptr
+    );
+
+    if (counter) {
+        cmd.fillBuffer(tileCounterBuffer, 0, sizeof(uint32_t), 0);
+    }
+    if (steps) {
+        vk::ClearColorValue zero(std::array<uint32_t, 4>{ 0, 0, 0, 0 });
+        vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+        cmd.clearColorImage(tileStepsImage, vk::ImageLayout::eGeneral, zero, range);
+    }
+
+    vk::MemoryBarrier resetBarrier;
+    resetBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    resetBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags{},
+        resetBarrier,
+        nullptr,
+        nullptr
     );
 }
 
-void ComputeToScreen::recordCompute(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& computePipeline) {
-    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *computePipeline);
+void ComputeToScreen::copyToHistory(const vk::raii::CommandBuffer& cmd) {
+    vk::MemoryBarrier resolvedBarrier;
+    resolvedBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    resolvedBarrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+    // the history was read by this frame's compute passes before it's overwritten
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags{},
+        resolvedBarrier,
+        nullptr,
+        nullptr
+    );
+
+    vk::ImageCopy region;
+    region.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+    region.dstSubresource = region.srcSubresource;
+    region.extent = vk::Extent3D{ renderWidth, renderHeight, 1 };
+
+    cmd.copyImage(image, vk::ImageLayout::eGeneral, historyImage, vk::ImageLayout::eGeneral, region);
+    cmd.copyImage(depthImage, vk::ImageLayout::eGeneral, historyDepthImage, vk::ImageLayout::eGeneral, region);
 
+    // next frame's compute passes read the history
+    vk::MemoryBarrier historyBarrier;
+    historyBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    historyBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags{},
+        historyBarrier,
+        nullptr,
+        nullptr
+    );
+}
+
+void ComputeToScreen::recordCompute(const vk::raii::CommandBuffer& cmd, const ComputePasses& passes, uint32_t frameIndex, GpuProfiler* profiler) {
+    if (imagesUndefined) {
+        initialTransition(cmd);
+        imagesUndefined = false;
+        historyInvalid = true;
+    }
+    if (historyInvalid) {
+        clearHistory(cmd);
+        historyInvalid = false;
+    }
+
+    uint32_t scope = 0;
+    if (!frameEdits.empty()) {
+        // before anything this frame reads the tree
+        if (profiler) scope = profiler->beginScope(cmd, "tree edits");
+        treeEditor.record(VkCommandBuffer(*cmd), frameIndex, treeManager.getNodeBuffer(), treeManager.getLeafBuffer(), frameEdits);
+        if (profiler) profiler->endScope(cmd, scope);
+        frameEdits.clear();
+    }
+
+    // the storage images & tree buffers are shared between frames in flight, the barriers in here and the
+    // ones after the present paths' reads of the image (transitionBack, or the barrier at the end of
+    // storeToSwapchain & blitToSwapchain) order them across submissions. Only the uniform sets need a copy per frame.
+    std::array<vk::DescriptorSet, 3> descriptorSets = {
+        computeSet,                              // set 0: storage buffer (tree) + storage images
+        frameData.getDescriptorSet(frameIndex),  // set 1: frame uniforms
+        renderData.getDescriptorSet(frameIndex), // set 2: render settings
+    };
     cmd.bindDescriptorSets(
         vk::PipelineBindPoint::eCompute,
         *computePipelineLayout,
@@ -303,9 +1026,152 @@ void ComputeToScreen::recordCompute(const vk::raii::CommandBuffer& cmd, const vk
         nullptr
     );
 
-    uint32_t groupsX = (width + 15) / 16;
-    uint32_t groupsY = (height + 15) / 16;
-    cmd.dispatch(groupsX, groupsY, 1);
+    if (passes.reprojectStart) {
+        if (profiler) scope = profiler->beginScope(cmd, "reproject start");
+        reprojectStartDistances(cmd, *passes.reprojectStart);
+        if (profiler) profiler->endScope(cmd, scope);
+    }
+    if (passes.coneStart) {
+        if (profiler) scope = profiler->beginScope(cmd, "cone start");
+        coneStartDistances(cmd, *passes.coneStart);
+        if (profiler) profiler->endScope(cmd, scope);
+    }
+    if (passes.lightingShadowQueue) {
+        if (profiler) scope = profiler->beginScope(cmd, "shadow queue reset");
+        resetShadowQueue(cmd);
+        if (profiler) profiler->endScope(cmd, scope);
+    }
+    if (passes.persistent || passes.stepHeatmap) {
+        resetTileCounters(cmd, passes.persistent, passes.stepHeatmap != nullptr);
+    }
+    if (passes.binLights && passes.cullLights) {
+        if (profiler) scope = profiler->beginScope(cmd, "light culling");
+        cullLights(cmd, *passes.binLights, *passes.cullLights);
+        if (profiler) profiler->endScope(cmd, scope);
+    }
+
+    if (profiler) scope = profiler->beginScope(cmd, "compute");
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, **passes.trace);
+
+    uint32_t groupsX = (renderWidth + 15) / 16;
+    uint32_t groupsY = (renderHeight + 15) / 16;
+    // a checkerboard traces every other pixel of a row
+    uint32_t traceGroupsX = passes.checkerboardResolve ? ((renderWidth + 1) / 2 + 15) / 16 : groupsX;
+    if (passes.persistent) {
+        // the workgroups loop over the tiles themselves
+        cmd.dispatch(persistentGroups, 1, 1);
+    } else {
+        cmd.dispatch(traceGroupsX, groupsY, 1);
+    }
+
+    // every resolve reads what the passes before it wrote, the fovea & checkerboard ones only write pixels
+    // that weren't traced
+    vk::MemoryBarrier traceBarrier;
+    traceBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    traceBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+    // the queued shadow rays are dispatched with the group count the trace wrote
+    vk::MemoryBarrier indirectBarrier = traceBarrier;
+    indirectBarrier.dstAccessMask |= vk::AccessFlagBits::eIndirectCommandRead;
+
+    struct ResolvePass {
+        const vk::raii::Pipeline* pipeline;
+        const char* name;
+        uint32_t groupsX, groupsY;
+        // dispatched with the shadow queue header as arguments instead
+        bool indirect = false;
+    };
+    // lighting first, the fovea & checkerboard resolves reconstruct from lit pixels
+    uint32_t lightingX = (renderWidth + lightingScale - 1) / lightingScale;
+    uint32_t lightingY = (renderHeight + lightingScale - 1) / lightingScale;
+    std::array<ResolvePass, 5> resolves = { {
+        { passes.lightingShadows, "lighting shadows", (lightingX + 15) / 16, (lightingY + 15) / 16 },
+        { passes.lightingShadowQueue, "shadow rays", 0, 0, true },
+        { passes.lightingResolve, "lighting resolve", groupsX, groupsY },
+        { passes.foveaResolve, "fovea resolve", groupsX, groupsY },
+        { passes.checkerboardResolve, "checkerboard resolve", groupsX, groupsY },
+    } };
+    for (auto [resolvePipeline, name, resolveGroupsX, resolveGroupsY, indirect] : resolves) {
+        if (!resolvePipeline) {
+            continue;
+        }
+
+        if (profiler) {
+            profiler->endScope(cmd, scope);
+            scope = profiler->beginScope(cmd, name);
+        }
+
+        cmd.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            indirect ? vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect
+                     : vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags{},
+            indirect ? indirectBarrier : traceBarrier,
+            nullptr,
+            nullptr
+        );
+
+        // same layout & descriptor sets, only the entry point differs
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, **resolvePipeline);
+        if (indirect) {
+            cmd.dispatchIndirect(shadowQueueBuffer, offsetof(ShadowQueueHeader, dispatch));
+        } else {
+            cmd.dispatch(resolveGroupsX, resolveGroupsY, 1);
+        }
+    }
+
+    // the history is only needed by passes that read it next frame
+    if (passes.checkerboardResolve || passes.reprojectStart) {
+        if (profiler) {
+            profiler->endScope(cmd, scope);
+            scope = profiler->beginScope(cmd, "history copy");
+        }
+        copyToHistory(cmd);
+    }
+
+    // after the history copy, so reprojection never sees the overlay
+    if (passes.stepHeatmap) {
+        if (profiler) {
+            profiler->endScope(cmd, scope);
+            scope = profiler->beginScope(cmd, "step heatmap");
+        }
+
+        cmd.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags{},
+            traceBarrier,
+            nullptr,
+            nullptr
+        );
+
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, **passes.stepHeatmap);
+        cmd.dispatch(groupsX, groupsY, 1);
+    }
+
+    if (profiler) {
+        profiler->endScope(cmd, scope);
+        scope = profiler->beginScope(cmd, "compute barrier");
+    }
+
+    if (!passes.raster) {
+        // the image stays in GENERAL, the swapchain pass reads it with a shader or a blit
+        vk::MemoryBarrier presentBarrier;
+        presentBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        presentBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead;
+
+        cmd.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags{},
+            presentBarrier,
+            nullptr,
+            nullptr
+        );
+
+        if (profiler) profiler->endScope(cmd, scope);
+        return;
+    }
 
     vk::ImageMemoryBarrier barrier;
     barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
@@ -317,14 +1183,68 @@ void ComputeToScreen::recordCompute(const vk::raii::CommandBuffer& cmd, const vk
     barrier.subresourceRange.levelCount = 1;
     barrier.subresourceRange.layerCount = 1;
 
+    // the history copy also reads the image, the layout change has to wait for it
     cmd.pipelineBarrier(
-        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
         vk::PipelineStageFlagBits::eFragmentShader,
         vk::DependencyFlags{},
         nullptr,
         nullptr,
         barrier
     );
+
+    if (profiler) profiler->endScope(cmd, scope);
+}
+
+void ComputeToScreen::storeToSwapchain(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& presentPipeline,
+    uint32_t swapchainIndex, vk::Extent2D extent) {
+    // sets 0 to 2 are still bound from recordCompute, same pipeline layout
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *computePipelineLayout, 3, *swapchainSets[swapchainIndex],
+        nullptr);
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *presentPipeline);
+    cmd.dispatch((extent.width + 15) / 16, (extent.height + 15) / 16, 1);
+
+    imageReadBarrier(cmd, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead);
+}
+
+void ComputeToScreen::blitToSwapchain(const vk::raii::CommandBuffer& cmd, vk::Image swapchainImage, vk::Extent2D extent) {
+    vk::ImageBlit region;
+    region.srcSubresource = { vk::ImageAspectFlagBits::eColor, 0, 0, 1 };
+    // swapped source corners turn the image by 180 degrees, like the fullscreen quad's texture coordinates
+    region.srcOffsets[0] = vk::Offset3D{ int32_t(renderWidth), int32_t(renderHeight), 0 };
+    region.srcOffsets[1] = vk::Offset3D{ 0, 0, 1 };
+    region.dstSubresource = { vk::ImageAspectFlagBits::eColor, 0, 0, 1 };
+    region.dstOffsets[1] = vk::Offset3D{ int32_t(extent.width), int32_t(extent.height), 1 };
+
+    // linear filtering scales like the fullscreen pass's sampler, the sRGB encoding happens in the blit
+    cmd.blitImage(image, vk::ImageLayout::eGeneral, swapchainImage, vk::ImageLayout::eTransferDstOptimal, region,
+        vk::Filter::eLinear);
+
+    imageReadBarrier(cmd, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead);
+}
+
+void ComputeToScreen::imageReadBarrier(const vk::raii::CommandBuffer& cmd, vk::PipelineStageFlags readStage,
+    vk::AccessFlags readAccess) {
+    // the next frame's passes write the image on the same queue, they must not start before this read is done
+    vk::ImageMemoryBarrier barrier;
+    barrier.srcAccessMask = readAccess;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+    barrier.oldLayout = vk::ImageLayout::eGeneral;
+    barrier.newLayout = vk::ImageLayout::eGeneral;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+
+    cmd.pipelineBarrier(
+        readStage,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags{},
+        nullptr,
+        nullptr,
+        barrier
+    );
 }
 
 void ComputeToScreen::recordGraphics(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& graphicsPipeline) {
@@ -336,10 +1256,13 @@ void ComputeToScreen::recordGraphics(const vk::raii::CommandBuffer& cmd, const v
         graphicsSet,
         nullptr
     );
+    cmd.pushConstants<ScreenPushConstants>(*graphicsPipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, getScreenPushConstants());
     cmd.draw(6, 1, 0, 0);
 }
 
-void ComputeToScreen::transitionBack(const vk::raii::CommandBuffer& cmd) {
+void ComputeToScreen::transitionBack(const vk::raii::CommandBuffer& cmd, GpuProfiler* profiler) {
+    uint32_t scope = profiler ? profiler->beginScope(cmd, "transition back") : 0;
+
     vk::ImageMemoryBarrier barrier;
     barrier.srcAccessMask = vk::AccessFlagBits::eShaderRead;
     barrier.dstAccessMask = vk::AccessFlagBits::eShaderWrite;
@@ -358,4 +1281,6 @@ void ComputeToScreen::transitionBack(const vk::raii::CommandBuffer& cmd) {
         nullptr,
         barrier
     );
+
+    if (profiler) profiler->endScope(cmd, scope);
 }
\ No newline at end of file
@@ -2,8 +2,68 @@
 #include <vulkan/vulkan_raii.hpp>
 #include <vma/vk_mem_alloc.h>
 #include "../uniforms/frame.hpp"
+#include "../uniforms/render.hpp"
 #include "../tree/buffer.hpp"
 #include "../tree/tree.hpp"
+#include "../tree/treeedit.hpp"
+#include "../vulkan/profiler.hpp"
+#include <glm/glm.hpp>
+
+// Push constants of the fullscreen pass, must match ScreenConstants in shader.slang
+struct ScreenPushConstants {
+    glm::vec2 uvScale;
+    glm::vec2 uvMax;
+};
+
+// Compute pipelines recorded for a frame, the resolve passes are skipped when null
+struct ComputePasses {
+    const vk::raii::Pipeline* trace = nullptr;
+    // fills in the pixels skipped by foveated tracing, set whenever foveaLevels > 0
+    const vk::raii::Pipeline* foveaResolve = nullptr;
+    // fills in the pixels skipped by checkerboard tracing, set whenever checkerboard is on
+    const vk::raii::Pipeline* checkerboardResolve = nullptr;
+    // scatters the previous frame's depth into start distances, set whenever reprojectStart is on
+    const vk::raii::Pipeline* reprojectStart = nullptr;
+    // marches a cone per tile for start distances, set whenever coneStart is on
+    const vk::raii::Pipeline* coneStart = nullptr;
+    // march shadows at a lower resolution & shade the traced pixels with them, set whenever lightingScale > 1
+    const vk::raii::Pipeline* lightingShadows = nullptr;
+    const vk::raii::Pipeline* lightingResolve = nullptr;
+    // marches the shadow rays queued by the trace, dispatched indirectly, set whenever wavefront is on.
+    // Replaces lightingShadows
+    const vk::raii::Pipeline* lightingShadowQueue = nullptr;
+    // overlays the ray march steps per trace tile, set whenever stepHeatmap is on
+    const vk::raii::Pipeline* stepHeatmap = nullptr;
+    // list the point lights of every bin, then of every cluster, before the trace. Set whenever the tree has lights
+    const vk::raii::Pipeline* binLights = nullptr;
+    const vk::raii::Pipeline* cullLights = nullptr;
+    // trace is the computePersistent entry, dispatched as persistentGroups workgroups pulling tiles
+    bool persistent = false;
+    // the fullscreen pass samples the image afterwards, so it ends in SHADER_READ_ONLY & transitionBack
+    // has to run. Otherwise it stays in GENERAL for storeToSwapchain or blitToSwapchain
+    bool raster = true;
+};
+
+// Start of the shadow queue buffer, must match SHADOW_QUEUE_HEADER in lighting.slang.
+// The trace grows groupCountX as it appends rays, followed by one packed pixel per ray
+struct ShadowQueueHeader {
+    VkDispatchIndirectCommand dispatch;
+    uint32_t count;
+};
+
+// Pixels per side of a cone pre-pass tile, CONE_TILE in cone.slang
+const uint32_t CONE_TILE = 8;
+
+// Light clusters, must match lights.slang. Every CLUSTER_TILE x CLUSTER_TILE tile has CLUSTER_SLICES
+// distance slices, each a light count followed by up to MAX_CLUSTER_LIGHTS light indices
+const uint32_t CLUSTER_TILE = 16;
+const uint32_t CLUSTER_SLICES = 16;
+const uint32_t MAX_CLUSTER_LIGHTS = 32;
+const uint32_t CLUSTER_STRIDE = MAX_CLUSTER_LIGHTS + 1;
+// Every bin of CLUSTER_BIN x CLUSTER_BIN tiles is a light count followed by up to MAX_BIN_LIGHTS light indices
+const uint32_t CLUSTER_BIN = 8;
+const uint32_t MAX_BIN_LIGHTS = 512;
+const uint32_t BIN_STRIDE = MAX_BIN_LIGHTS + 1;
 
 class ComputeToScreen {
 public:
@@ -11,11 +71,57 @@ public:
     VmaAllocation allocation;
     vk::raii::ImageView view = nullptr;
     vk::raii::Sampler sampler = nullptr;
+    // primary hit distance per pixel, only read by compute passes so it stays in GENERAL
+    vk::Image depthImage;
+    VmaAllocation depthAllocation;
+    vk::raii::ImageView depthView = nullptr;
+    // color & depth at the end of the previous frame, for reprojection
+    vk::Image historyImage;
+    VmaAllocation historyAllocation;
+    vk::raii::ImageView historyView = nullptr;
+    vk::Image historyDepthImage;
+    VmaAllocation historyDepthAllocation;
+    vk::raii::ImageView historyDepthView = nullptr;
+    // reprojected start distances of the primary rays, as uint for atomic min
+    vk::Image startDistanceImage;
+    VmaAllocation startDistanceAllocation;
+    vk::raii::ImageView startDistanceView = nullptr;
+    // start distance of every CONE_TILE x CONE_TILE tile, written by the cone pre-pass
+    vk::Image tileStartImage;
+    VmaAllocation tileStartAllocation;
+    vk::raii::ImageView tileStartView = nullptr;
+    // hit normal & ambient occlusion per pixel, written by the trace when lighting is decoupled
+    vk::Image gBufferImage;
+    VmaAllocation gBufferAllocation;
+    vk::raii::ImageView gBufferView = nullptr;
+    // sun shadow per lighting texel, at full size since the wavefront path also lights every pixel
+    vk::Image shadowImage;
+    VmaAllocation shadowAllocation;
+    vk::raii::ImageView shadowView = nullptr;
+    // shadow rays queued by the trace in wavefront mode, room for one per pixel
+    VkBuffer shadowQueueBuffer = VK_NULL_HANDLE;
+    VmaAllocation shadowQueueAllocation = VK_NULL_HANDLE;
+    // next tile of the persistent trace
+    VkBuffer tileCounterBuffer = VK_NULL_HANDLE;
+    VmaAllocation tileCounterAllocation = VK_NULL_HANDLE;
+    // ray march steps per 16x16 trace tile, for the step heatmap
+    vk::Image tileStepsImage;
+    VmaAllocation tileStepsAllocation;
+    vk::raii::ImageView tileStepsView = nullptr;
+    // point light list of every cluster, written by the light culling pass
+    VkBuffer clusterBuffer = VK_NULL_HANDLE;
+    VmaAllocation clusterAllocation = VK_NULL_HANDLE;
+    // point light list of every bin of clusters, written by the light binning pass
+    VkBuffer lightBinBuffer = VK_NULL_HANDLE;
+    VmaAllocation lightBinAllocation = VK_NULL_HANDLE;
+    // set when the images are (re)created, the next recordCompute moves them out of UNDEFINED
+    bool imagesUndefined = true;
+    // set when the history doesn't match the current images or tree, the next recordCompute clears it
+    bool historyInvalid = true;
     vk::raii::DescriptorSetLayout computeLayout = nullptr;
     vk::raii::DescriptorSetLayout graphicsLayout = nullptr;
 	vk::raii::DescriptorSets computeSets = nullptr;
 	vk::raii::DescriptorSets graphicsSets = nullptr;
-    std::vector<vk::DescriptorSet> descriptorSets;
     vk::raii::DescriptorPool pool = nullptr;
 
     vk::DescriptorSet computeSet;  // Keep raw - owned by pool
@@ -24,15 +130,59 @@ public:
     vk::DescriptorSet graphicsSet; // Keep raw - owned by pool
     vk::raii::PipelineLayout graphicsPipelineLayout = nullptr;
 
+    // set 3 of the compute pipelines, one storage swapchain image per set for the storage present path
+    vk::raii::DescriptorSetLayout swapchainLayout = nullptr;
+    vk::raii::DescriptorPool swapchainPool = nullptr;
+    vk::raii::DescriptorSets swapchainSets = nullptr;
+
     FrameDataManager frameData;
+    RenderDataManager renderData;
     TreeManager treeManager;
+    // applies the tree's edits to its GPU buffers, edits are uploaded by the CPU when it isn't ready
+    GpuTreeEditor treeEditor;
+    // brushes the next recordCompute applies
+    std::vector<EditBrush> frameEdits;
     VmaAllocator vmaAllocator;
 
+    // size of the images
     uint32_t width, height;
+    // size actually rendered, the top left part of the images. Changing it doesn't reallocate anything
+    uint32_t renderWidth = 0, renderHeight = 0;
+    float renderScale = 1.0f;
+    // shadows are marched for one pixel in lightingScale x lightingScale, 1 lights every pixel in the trace
+    uint32_t lightingScale = 1;
+    // workgroups of the persistent trace, enough to fill the GPU a few times over. Vulkan has no portable
+    // way to ask for the number of compute units
+    uint32_t persistentGroups = 256;
 
-    void create(VmaAllocator allocator, const vk::raii::Device& device, uint32_t queueFamilyIndex, uint32_t width, uint32_t height);
+    void create(VmaAllocator allocator, const vk::raii::Device& device, uint32_t queueFamilyIndex, uint32_t width, uint32_t height, uint32_t framesInFlight);
+    // Build the tree (or load a baked one from treePath), upload it & point the compute descriptors at it.
+    // With treeBuildShader (treebuild.spv) the tree is built by compute shaders, falling back to the CPU build
+    // if that fails. Only needs create() to have run, so it can overlap with pipeline creation.
+    void loadTree(VmaAllocator allocator, const vk::raii::Device& device, uint32_t queueFamilyIndex,
+        const std::string& treePath = {}, const std::string& treeBuildShader = {});
+    // Point the compute descriptors at the tree's light buffer, the nodes & leaves are read by address
+    void updateTreeDescriptors(const vk::raii::Device& device);
+    // Load the edit pass (treeedit.spv) after loadTree. Edits are applied on the CPU & uploaded if it fails
+    void createTreeEditor(VmaAllocator allocator, const vk::raii::Device& device, const std::string& shaderPath,
+        uint32_t framesInFlight);
+    // After frameIndex's fence: rebuilds the nodes its last edits need children for. Can recreate the tree's
+    // buffers, so it runs before anything else touches the tree this frame
+    void rebuildTreeEdits(uint32_t frameIndex);
+    // Takes the brushes the next recordCompute applies, after the frame's applyEdit calls. Without the edit pass
+    // they're rebuilt & uploaded on the CPU instead
+    void takeTreeEdits();
     void createImage(VmaAllocator allocator, const vk::raii::Device& device, uint32_t w, uint32_t h);
+    void destroyImage(VmaAllocator allocator);
+    // Render at a fraction of the image size in both directions, upscaled by the fullscreen pass
+    void setRenderScale(float scale);
+    void updateRenderSize();
+    // 1, 2 or 4, anything else is rounded down to one of them
+    void setLightingScale(uint32_t scale);
+    ScreenPushConstants getScreenPushConstants() const;
     void updateImageDescriptors(const vk::raii::Device& device);
+    // Point the swapchain sets at the swapchain's image views, again every time it's recreated
+    void updateSwapchainDescriptors(const vk::raii::Device& device, const std::vector<vk::raii::ImageView>& swapchainViews);
     void destroy(VmaAllocator allocator);
 
     void resize(VmaAllocator allocator, const vk::raii::Device& device, uint32_t queueFamilyIndex, uint32_t width, uint32_t height);
@@ -40,12 +190,33 @@ public:
     // Helper to transition image for first use
     void initialTransition(const vk::raii::CommandBuffer& cmd);
 
-    // Record compute dispatch and barrier
-    void recordCompute(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& computePipeline);
+    void clearHistory(const vk::raii::CommandBuffer& cmd);
+    void copyToHistory(const vk::raii::CommandBuffer& cmd);
+    void reprojectStartDistances(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& reprojectPipeline);
+    void coneStartDistances(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& conePipeline);
+    void resetShadowQueue(const vk::raii::CommandBuffer& cmd);
+    // zeroes the tile counter &/or the tile steps before the trace
+    void resetTileCounters(const vk::raii::CommandBuffer& cmd, bool counter, bool steps);
+    void cullLights(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& binPipeline,
+        const vk::raii::Pipeline& cullPipeline);
+
+    // Record compute dispatches and barriers with the uniforms of frameIndex, timed by the profiler if there is one
+    void recordCompute(const vk::raii::CommandBuffer& cmd, const ComputePasses& passes, uint32_t frameIndex, GpuProfiler* profiler = nullptr);
+
+    // Write the rendered pixels into a swapchain image in GENERAL with presentPipeline, right after a
+    // recordCompute without raster. Ends with a barrier so the next frame's passes don't overwrite the image
+    // while it's being read, the direct paths' counterpart of transitionBack
+    void storeToSwapchain(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& presentPipeline,
+        uint32_t swapchainIndex, vk::Extent2D extent);
+    // Scale the rendered pixels into a swapchain image in TRANSFER_DST_OPTIMAL, after a recordCompute without
+    // raster. Ends with the same barrier as storeToSwapchain
+    void blitToSwapchain(const vk::raii::CommandBuffer& cmd, vk::Image swapchainImage, vk::Extent2D extent);
+    // Holds back the next compute passes until readStage's reads of the image are done, the image stays in GENERAL
+    void imageReadBarrier(const vk::raii::CommandBuffer& cmd, vk::PipelineStageFlags readStage, vk::AccessFlags readAccess);
 
     // Record graphics draw (call inside render pass)
     void recordGraphics(const vk::raii::CommandBuffer& cmd, const vk::raii::Pipeline& graphicsPipeline);
 
     // Transition back to GENERAL for next frame
-    void transitionBack(const vk::raii::CommandBuffer& cmd);
+    void transitionBack(const vk::raii::CommandBuffer& cmd, GpuProfiler* profiler = nullptr);
 };
@@ -0,0 +1,93 @@
+#include "governor.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+const char* getGovernorActionName(GovernorAction action) {
+    switch (action) {
+    case GovernorAction::Hold: return "hold";
+    case GovernorAction::LowerScale: return "lower scale";
+    case GovernorAction::RaiseScale: return "raise scale";
+    case GovernorAction::LowerSteps: return "lower steps";
+    case GovernorAction::RaiseSteps: return "raise steps";
+    }
+    return "unknown";
+}
+
+std::string GovernorDecision::describe() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << "governor: " << getGovernorActionName(action)
+        << ", " << smoothedMs << "ms"
+        << ", scale " << renderScale
+        << ", " << getRenderQualityName(quality) << " steps";
+    return out.str();
+}
+
+void FrameGovernor::reset(float renderScale, RenderQuality quality) {
+    decision = GovernorDecision{
+        .renderScale = std::clamp(renderScale, settings.minScale, settings.maxScale),
+        .quality = quality,
+    };
+    overFrames = 0;
+    underFrames = 0;
+    cooldown = 0;
+    primed = false;
+}
+
+const GovernorDecision& FrameGovernor::update(double gpuFrameMs) {
+    decision.action = GovernorAction::Hold;
+
+    if (!primed) {
+        decision.smoothedMs = gpuFrameMs;
+        primed = true;
+    } else {
+        decision.smoothedMs += (gpuFrameMs - decision.smoothedMs) * settings.smoothing;
+    }
+
+    // the frames measured right after a change were still rendered the old way
+    if (cooldown > 0) {
+        cooldown--;
+        return decision;
+    }
+
+    double smoothed = decision.smoothedMs;
+    if (smoothed > settings.targetMs) {
+        overFrames++;
+        underFrames = 0;
+    } else if (smoothed < settings.targetMs * settings.headroom) {
+        underFrames++;
+        overFrames = 0;
+    } else {
+        overFrames = underFrames = 0;
+    }
+
+    int quality = static_cast<int>(decision.quality);
+
+    if (overFrames >= settings.reactFrames) {
+        if (decision.renderScale > settings.minScale) {
+            // time goes with the pixel count, the square of the scale
+            float wanted = decision.renderScale * float(std::sqrt(settings.targetMs / smoothed));
+            decision.renderScale = std::max({ wanted, decision.renderScale - settings.maxDownStep, settings.minScale });
+            decision.action = GovernorAction::LowerScale;
+        } else if (quality > static_cast<int>(settings.minQuality)) {
+            decision.quality = static_cast<RenderQuality>(quality - 1);
+            decision.action = GovernorAction::LowerSteps;
+        }
+    } else if (underFrames >= settings.reactFrames) {
+        if (quality < static_cast<int>(settings.maxQuality)) {
+            decision.quality = static_cast<RenderQuality>(quality + 1);
+            decision.action = GovernorAction::RaiseSteps;
+        } else if (decision.renderScale < settings.maxScale) {
+            decision.renderScale = std::min(decision.renderScale + settings.upStep, settings.maxScale);
+            decision.action = GovernorAction::RaiseScale;
+        }
+    }
+
+    if (decision.action != GovernorAction::Hold) {
+        overFrames = underFrames = 0;
+        cooldown = settings.cooldownFrames;
+    }
+    return decision;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "../uniforms/render.hpp"
+
+// Tuning of the FrameGovernor, times in milliseconds of GPU frame time
+struct GovernorSettings {
+    double targetMs = 16.6;
+    // quality only goes back up below targetMs * headroom, the band in between holds still
+    double headroom = 0.8;
+    // weight of a new sample in the smoothed frame time
+    double smoothing = 0.3;
+    // frames the smoothed time has to stay over the target or under the headroom before acting
+    uint32_t reactFrames = 3;
+    // frames to wait after a change, the profiler reports frames a couple of frames late
+    uint32_t cooldownFrames = 6;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // largest render scale change in a single step, going up is always one upStep
+    float maxDownStep = 0.15f;
+    float upStep = 0.05f;
+    RenderQuality minQuality = RenderQuality::Low;
+    RenderQuality maxQuality = RenderQuality::High;
+};
+
+enum class GovernorAction {
+    Hold,
+    LowerScale,
+    RaiseScale,
+    LowerSteps,
+    RaiseSteps,
+};
+
+const char* getGovernorActionName(GovernorAction action);
+
+// What the governor wants the next frame rendered with, & why
+struct GovernorDecision {
+    GovernorAction action = GovernorAction::Hold;
+    float renderScale = 1.0f;
+    // the preset is the ray march step budget, its variants are all compiled up front
+    RenderQuality quality = RenderQuality::High;
+    double smoothedMs = 0.0;
+
+    // one line for the log
+    std::string describe() const;
+};
+
+// Holds the GPU frame time under a target by trading render resolution & ray march step budgets.
+// Over the target it lowers the resolution first, in proportion to how far over it is, & the step
+// budget once the resolution is at its minimum. Under the target by the headroom it undoes that in
+// reverse order, in small steps. Changing the render scale never reallocates the images.
+class FrameGovernor {
+public:
+    FrameGovernor() = default;
+    explicit FrameGovernor(GovernorSettings settings) : settings(settings) {}
+
+    // Starts from the current render scale & preset, & forgets the measured history
+    void reset(float renderScale, RenderQuality quality);
+
+    // Feed the GPU time of the most recent frame, once per frame
+    const GovernorDecision& update(double gpuFrameMs);
+
+    const GovernorDecision& getDecision() const { return decision; }
+    const GovernorSettings& getSettings() const { return settings; }
+
+private:
+    GovernorSettings settings;
+    GovernorDecision decision;
+    uint32_t overFrames = 0;
+    uint32_t underFrames = 0;
+    uint32_t cooldown = 0;
+    bool primed = false;
+};
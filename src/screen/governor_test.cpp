@@ -0,0 +1,205 @@
+// Feeds FrameGovernor synthetic GPU frame times from a simple load model: the frame time goes with the
+// rendered pixel count & the preset's step budget, & reaches the governor a couple of frames late like the
+// profiler's readback does. Checks it reacts within a few frames, settles & doesn't oscillate.
+
+#define VMA_IMPLEMENTATION
+#include "vma/vk_mem_alloc.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+#include "governor.hpp"
+
+// Simple test macros
+#define TEST(name) void test_##name()
+#define RUN_TEST(name) do { \
+    std::cout << "Running " #name "... "; \
+    test_##name(); \
+    std::cout << "PASSED" << std::endl; \
+} while(0)
+
+#define ASSERT_EQ(actual, expected) do { \
+    if ((actual) != (expected)) { \
+        std::cerr << "FAILED: " << #actual << " != " << #expected \
+                  << " (got " << (actual) << ", expected " << (expected) << ")" << std::endl; \
+        std::exit(1); \
+    } \
+} while(0)
+
+#define ASSERT_TRUE(condition) do { \
+    if (!(condition)) { \
+        std::cerr << "FAILED: " << #condition << std::endl; \
+        std::exit(1); \
+    } \
+} while(0)
+
+// frames between rendering a frame & its time reaching the governor
+constexpr size_t PROFILER_LATENCY = 2;
+
+// What the scene costs at full scale & the high preset, & what the lower presets save of it
+struct Load {
+    double fullMs;
+    double mediumFactor = 0.8;
+    double lowFactor = 0.6;
+
+    double frameMs(float renderScale, RenderQuality quality) const {
+        double steps = quality == RenderQuality::Low ? lowFactor : quality == RenderQuality::Medium ? mediumFactor : 1.0;
+        return fullMs * renderScale * renderScale * steps;
+    }
+};
+
+// One frame per entry, the state it was rendered with & what the governor did after it
+struct Frame {
+    float renderScale;
+    RenderQuality quality;
+    double frameMs;
+    GovernorAction action;
+};
+
+// Runs the loop main.cpp runs, load can change per frame
+template<typename LoadAt>
+std::vector<Frame> simulate(FrameGovernor& governor, float renderScale, RenderQuality quality, int frames, LoadAt loadAt) {
+    governor.reset(renderScale, quality);
+    std::deque<double> inFlight;
+    std::vector<Frame> result;
+
+    for (int i = 0; i < frames; i++) {
+        double frameMs = loadAt(i).frameMs(renderScale, quality);
+        inFlight.push_back(frameMs);
+
+        GovernorAction action = GovernorAction::Hold;
+        if (inFlight.size() > PROFILER_LATENCY) {
+            const GovernorDecision& decision = governor.update(inFlight.front());
+            inFlight.pop_front();
+            action = decision.action;
+            renderScale = decision.renderScale;
+            quality = decision.quality;
+        }
+        result.push_back({ renderScale, quality, frameMs, action });
+    }
+    return result;
+}
+
+bool isLowering(GovernorAction action) {
+    return action == GovernorAction::LowerScale || action == GovernorAction::LowerSteps;
+}
+
+bool isRaising(GovernorAction action) {
+    return action == GovernorAction::RaiseScale || action == GovernorAction::RaiseSteps;
+}
+
+// changes of direction, lowering after raising or the other way around
+int countReversals(const std::vector<Frame>& frames) {
+    int reversals = 0;
+    int direction = 0;
+    for (const Frame& frame : frames) {
+        int step = isLowering(frame.action) ? -1 : isRaising(frame.action) ? 1 : 0;
+        if (step != 0 && direction != 0 && step != direction) {
+            reversals++;
+        }
+        if (step != 0) {
+            direction = step;
+        }
+    }
+    return reversals;
+}
+
+int lastActionFrame(const std::vector<Frame>& frames) {
+    for (int i = int(frames.size()) - 1; i >= 0; i--) {
+        if (frames[i].action != GovernorAction::Hold) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+TEST(overTarget_reactsWithinAFewFrames) {
+    FrameGovernor governor;
+    const GovernorSettings& settings = governor.getSettings();
+    std::vector<Frame> frames = simulate(governor, 1.0f, RenderQuality::High, 30,
+        [](int) { return Load{ .fullMs = 25.0 }; });
+
+    int first = -1;
+    for (int i = 0; i < int(frames.size()); i++) {
+        if (frames[i].action != GovernorAction::Hold) {
+            first = i;
+            break;
+        }
+    }
+    ASSERT_TRUE(first >= 0);
+    ASSERT_TRUE(first <= int(PROFILER_LATENCY + settings.reactFrames));
+    ASSERT_TRUE(frames[first].action == GovernorAction::LowerScale);
+    // a single step never drops by more than maxDownStep
+    ASSERT_TRUE(frames[first].renderScale >= 1.0f - settings.maxDownStep - 1e-5f);
+}
+
+TEST(withinBand_holds) {
+    FrameGovernor governor;
+    // between targetMs * headroom & targetMs
+    std::vector<Frame> frames = simulate(governor, 1.0f, RenderQuality::High, 200,
+        [](int) { return Load{ .fullMs = 15.0 }; });
+
+    ASSERT_EQ(lastActionFrame(frames), -1);
+}
+
+TEST(heavyScene_settlesWithoutOscillating) {
+    for (double fullMs : { 20.0, 25.0, 35.0, 60.0 }) {
+        FrameGovernor governor;
+        const GovernorSettings& settings = governor.getSettings();
+        std::vector<Frame> frames = simulate(governor, 1.0f, RenderQuality::High, 600,
+            [fullMs](int) { return Load{ .fullMs = fullMs }; });
+
+        ASSERT_TRUE(countReversals(frames) == 0);
+        // settled well before the end & stays settled
+        ASSERT_TRUE(lastActionFrame(frames) < 200);
+
+        const Frame& last = frames.back();
+        bool atFloor = last.renderScale <= settings.minScale && last.quality == settings.minQuality;
+        ASSERT_TRUE(last.frameMs <= settings.targetMs || atFloor);
+    }
+}
+
+TEST(lighterScene_raisesBackWithoutOscillating) {
+    FrameGovernor governor;
+    const GovernorSettings& settings = governor.getSettings();
+    // heavy for the first 300 frames, then light enough for full quality
+    std::vector<Frame> frames = simulate(governor, 1.0f, RenderQuality::High, 1200,
+        [](int frame) { return Load{ .fullMs = frame < 300 ? 40.0 : 10.0 }; });
+
+    // one reversal, from lowering to raising when the load drops
+    ASSERT_EQ(countReversals(frames), 1);
+    ASSERT_TRUE(lastActionFrame(frames) < 900);
+
+    const Frame& last = frames.back();
+    ASSERT_TRUE(last.quality == settings.maxQuality);
+    ASSERT_TRUE(last.renderScale >= settings.maxScale);
+}
+
+TEST(nearThreshold_doesNotOscillate) {
+    FrameGovernor governor;
+    // the full scale frame is just over the target, one step down lands just under the headroom
+    std::vector<Frame> frames = simulate(governor, 1.0f, RenderQuality::High, 600,
+        [](int frame) {
+            // a little frame to frame noise
+            return Load{ .fullMs = 17.0 + ((frame * 7) % 5 - 2) * 0.2 };
+        });
+
+    ASSERT_TRUE(countReversals(frames) == 0);
+    ASSERT_TRUE(lastActionFrame(frames) < 200);
+}
+
+int main() {
+    std::cout << "=== Running Frame Governor Tests ===" << std::endl;
+
+    RUN_TEST(overTarget_reactsWithinAFewFrames);
+    RUN_TEST(withinBand_holds);
+    RUN_TEST(heavyScene_settlesWithoutOscillating);
+    RUN_TEST(lighterScene_raisesBackWithoutOscillating);
+    RUN_TEST(nearThreshold_doesNotOscillate);
+
+    std::cout << std::endl << "=== All Tests Passed ===" << std::endl;
+    return 0;
+}
@@ -37,6 +37,15 @@ struct TreeLeaf {
     uint8_t padding; // 8 bits of padding left
 };
 
+// Device memory is bound to sparse tree buffers in chunks of (at least) this size, as they grow
+const VkDeviceSize TREE_BUFFER_CHUNK_SIZE = 4 * 1024 * 1024;
+
+// Storage for the ray marcher through the buffer's device address, transfers for uploads & growing
+const VkBufferUsageFlags TREE_BUFFER_USAGE = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+    VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+    VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
 template<typename T>
 class TreeBuffer {
 public:
@@ -60,6 +69,9 @@ public:
 
         // Get our own queue handle
         vkGetDeviceQueue(m_device, queueFamilyIndex, 0, &m_queue);
+
+        createTimestampPool();
+        detectSparseBinding();
     }
 
     bool create(const std::vector<T>& initialData) {
@@ -67,6 +79,9 @@ public:
             return false;
         }
 
+        // e.g. left by a GPU build that failed, nothing is in flight yet
+        destroyBuffers();
+
         m_count = initialData.size();
         m_capacity = m_count;
         VkDeviceSize bufferSize = m_capacity * sizeof(T);
@@ -128,11 +143,117 @@ public:
         return true;
     }
 
+    // GPU & staging buffer for capacity elements, without uploading anything, for buffers a compute shader
+    // fills in. Drops the previous buffers & their contents
+    bool allocate(size_t capacity) {
+        if (!m_allocator || capacity == 0) {
+            return false;
+        }
+
+        // no frame in flight can still be reading the old buffers
+        vkQueueWaitIdle(m_queue);
+        destroyBuffers();
+
+        m_count = 0;
+        m_capacity = capacity;
+        VkDeviceSize bufferSize = m_capacity * sizeof(T);
+
+        if (!createGPUBuffer(bufferSize)) {
+            return false;
+        }
+        if (!createStagingBuffer(bufferSize)) {
+            destroyGPUBuffer();
+            return false;
+        }
+
+        return true;
+    }
+
+    // Elements a compute shader wrote, for allocate()d buffers
+    void setCount(size_t count) {
+        m_count = std::min(count, m_capacity);
+    }
+
+    // Copies the first getCount() elements back to the CPU
+    bool download(std::vector<T>& data) {
+        data.clear();
+        if (!m_gpuBuffer || m_count == 0) {
+            return m_gpuBuffer != VK_NULL_HANDLE;
+        }
+
+        VkDeviceSize size = m_count * sizeof(T);
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        VkBuffer readbackBuffer = VK_NULL_HANDLE;
+        VmaAllocation readbackAllocation = VK_NULL_HANDLE;
+        VmaAllocationInfo readbackInfo{};
+        if (vmaCreateBuffer(m_allocator, &bufferInfo, &allocInfo, &readbackBuffer, &readbackAllocation, &readbackInfo) != VK_SUCCESS) {
+            return false;
+        }
+
+        VkCommandBufferAllocateInfo commandInfo{};
+        commandInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandInfo.commandPool = m_commandPool;
+        commandInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(m_device, &commandInfo, &commandBuffer);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.size = size;
+        // written by compute shaders, e.g. the GPU tree build
+        bufferBarrier(commandBuffer, m_gpuBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        vkCmdCopyBuffer(commandBuffer, m_gpuBuffer, readbackBuffer, 1, &copyRegion);
+        bufferBarrier(commandBuffer, readbackBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(m_queue);
+
+        vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+
+        vmaInvalidateAllocation(m_allocator, readbackAllocation, 0, VK_WHOLE_SIZE);
+        data.resize(m_count);
+        std::memcpy(data.data(), readbackInfo.pMappedData, size);
+        vmaDestroyBuffer(m_allocator, readbackBuffer, readbackAllocation);
+
+        return true;
+    }
+
     bool resize(size_t newCapacity) {
         if (newCapacity <= m_capacity) {
             return true; // Already big enough
         }
 
+        // sparse buffers keep their handle & contents, only the chunks past the old capacity get memory
+        if (m_sparse) {
+            return m_gpuBuffer != VK_NULL_HANDLE ? growSparse(newCapacity) : createEmpty(newCapacity);
+        }
+
         // Create temporary buffers for the new size
         VkBuffer newGPUBuffer = VK_NULL_HANDLE;
         VmaAllocation newGPUAllocation = VK_NULL_HANDLE;
@@ -147,9 +268,7 @@ public:
             VkBufferCreateInfo bufferInfo{};
             bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
             bufferInfo.size = newBufferSize;
-            bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            bufferInfo.usage = TREE_BUFFER_USAGE;
             bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
             VmaAllocationCreateInfo allocInfo{};
@@ -209,7 +328,8 @@ public:
             }
         }
 
-        // Destroy old buffers
+        // Destroy old buffers, once no frame in flight can still be reading them
+        vkQueueWaitIdle(m_queue);
         destroyBuffers();
 
         // Assign new buffers
@@ -223,6 +343,14 @@ public:
         return true;
     }
 
+    // Grows by half again when count doesn't fit, for buffers that keep getting appended to
+    bool reserve(size_t count) {
+        if (count <= m_capacity) {
+            return true;
+        }
+        return resize(std::max(count, m_capacity + m_capacity / 2));
+    }
+
     void update(const std::vector<T>& data) {
         if (!m_gpuBuffer || data.empty() || data.size() > m_capacity) {
             return;
@@ -267,9 +395,32 @@ public:
     }
 
     VkBuffer getBuffer() const { return m_gpuBuffer; }
+    // Address shaders read the buffer through, it changes whenever the handle does. 0 before the first upload
+    VkDeviceAddress getDeviceAddress() const {
+        if (m_gpuBuffer == VK_NULL_HANDLE) {
+            return 0;
+        }
+        VkBufferDeviceAddressInfo addressInfo{};
+        addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+        addressInfo.buffer = m_gpuBuffer;
+        return vkGetBufferDeviceAddress(m_device, &addressInfo);
+    }
+    // Growing binds memory to a reserved address range instead of copying to a new buffer, the handle stays the same
+    bool isSparse() const { return m_sparse; }
     size_t getCount() const { return m_count; }
     size_t getCapacity() const { return m_capacity; }
 
+    // GPU time spent on copies since the last call, false if nothing was uploaded (or timestamps aren't supported)
+    bool takeUploadTime(double& milliseconds) {
+        if (!m_hasUploadTime) {
+            return false;
+        }
+        milliseconds = m_uploadMs;
+        m_uploadMs = 0.0;
+        m_hasUploadTime = false;
+        return true;
+    }
+
     void destroy() {
         destroyBuffers();
 
@@ -278,6 +429,17 @@ public:
             m_commandPool = VK_NULL_HANDLE;
         }
 
+        if (m_timestampPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(m_device, m_timestampPool, nullptr);
+            m_timestampPool = VK_NULL_HANDLE;
+        }
+
+        if (m_bindFence != VK_NULL_HANDLE) {
+            vkDestroyFence(m_device, m_bindFence, nullptr);
+            m_bindFence = VK_NULL_HANDLE;
+        }
+        m_sparse = false;
+
         m_queue = VK_NULL_HANDLE;
         m_count = 0;
         m_capacity = 0;
@@ -300,13 +462,116 @@ private:
     size_t m_count = 0;
     size_t m_capacity = 0;
 
+    // Sparse binding: the GPU buffer reserves m_reservedSize bytes of address space up front, device memory is
+    // bound to it in m_chunkSize chunks, so indices & the handle stay the same as it grows
+    bool m_sparse = false;
+    VkDeviceSize m_reservedSize = 0;
+    VkDeviceSize m_chunkSize = 0;
+    VkMemoryRequirements m_sparseRequirements = {};
+    std::vector<VmaAllocation> m_chunks;
+    VkFence m_bindFence = VK_NULL_HANDLE;
+
+    // 2 timestamp queries around every copy, null if the queue doesn't support timestamps
+    VkQueryPool m_timestampPool = VK_NULL_HANDLE;
+    float m_timestampPeriod = 1.0f;
+    double m_uploadMs = 0.0;
+    bool m_hasUploadTime = false;
+
+    void createTimestampPool() {
+        VmaAllocatorInfo allocatorInfo{};
+        vmaGetAllocatorInfo(m_allocator, &allocatorInfo);
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(allocatorInfo.physicalDevice, &properties);
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(allocatorInfo.physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(allocatorInfo.physicalDevice, &familyCount, families.data());
+
+        if (m_queueFamilyIndex >= familyCount || families[m_queueFamilyIndex].timestampValidBits == 0) {
+            return;
+        }
+        m_timestampPeriod = properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = 2;
+
+        if (vkCreateQueryPool(m_device, &poolInfo, nullptr, &m_timestampPool) != VK_SUCCESS) {
+            m_timestampPool = VK_NULL_HANDLE;
+        }
+    }
+
+    void beginUploadTimer(VkCommandBuffer commandBuffer) {
+        if (m_timestampPool == VK_NULL_HANDLE) return;
+        vkCmdResetQueryPool(commandBuffer, m_timestampPool, 0, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPool, 0);
+    }
+
+    void endUploadTimer(VkCommandBuffer commandBuffer) {
+        if (m_timestampPool == VK_NULL_HANDLE) return;
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPool, 1);
+    }
+
+    // only call after the queue went idle, so the results are already available
+    void collectUploadTime() {
+        if (m_timestampPool == VK_NULL_HANDLE) return;
+
+        uint64_t timestamps[2] = {};
+        VkResult result = vkGetQueryPoolResults(m_device, m_timestampPool, 0, 2, sizeof(timestamps), timestamps,
+            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS) return;
+
+        m_uploadMs += double(timestamps[1] - timestamps[0]) * m_timestampPeriod * 1e-6;
+        m_hasUploadTime = true;
+    }
+
+    // Sparse binding needs the device feature, which VulkanContext enables when it's there, & a queue that can bind
+    void detectSparseBinding() {
+        VmaAllocatorInfo allocatorInfo{};
+        vmaGetAllocatorInfo(m_allocator, &allocatorInfo);
+
+        VkPhysicalDeviceFeatures features{};
+        vkGetPhysicalDeviceFeatures(allocatorInfo.physicalDevice, &features);
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(allocatorInfo.physicalDevice, &properties);
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(allocatorInfo.physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(allocatorInfo.physicalDevice, &familyCount, families.data());
+
+        if (!features.sparseBinding || m_queueFamilyIndex >= familyCount ||
+            !(families[m_queueFamilyIndex].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT)) {
+            return;
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(m_device, &fenceInfo, nullptr, &m_bindFence) != VK_SUCCESS) {
+            m_bindFence = VK_NULL_HANDLE;
+            return;
+        }
+
+        // the whole buffer is bound to one storage buffer descriptor, the node, leaf & light buffers share the
+        // sparse address space
+        m_reservedSize = std::min<VkDeviceSize>(properties.limits.maxStorageBufferRange,
+            properties.limits.sparseAddressSpaceSize / 4);
+        m_reservedSize -= m_reservedSize % TREE_BUFFER_CHUNK_SIZE;
+        m_sparse = m_reservedSize > 0;
+    }
+
     bool createGPUBuffer(VkDeviceSize size) {
+        if (m_sparse) {
+            return createSparseBuffer(size);
+        }
+
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
-        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.usage = TREE_BUFFER_USAGE;
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
         VmaAllocationCreateInfo allocInfo{};
@@ -324,6 +589,119 @@ private:
         return result == VK_SUCCESS;
     }
 
+    // Reserves the address range & binds chunks for the first size bytes
+    bool createSparseBuffer(VkDeviceSize size) {
+        if (size > m_reservedSize) {
+            return false;
+        }
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.flags = VK_BUFFER_CREATE_SPARSE_BINDING_BIT;
+        bufferInfo.size = m_reservedSize;
+        bufferInfo.usage = TREE_BUFFER_USAGE;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_gpuBuffer) != VK_SUCCESS) {
+            m_gpuBuffer = VK_NULL_HANDLE;
+            return false;
+        }
+
+        // chunks are bound at multiples of the sparse block size
+        vkGetBufferMemoryRequirements(m_device, m_gpuBuffer, &m_sparseRequirements);
+        VkDeviceSize alignment = std::max<VkDeviceSize>(m_sparseRequirements.alignment, 1);
+        m_chunkSize = (TREE_BUFFER_CHUNK_SIZE + alignment - 1) / alignment * alignment;
+
+        if (!bindChunks(size)) {
+            destroyGPUBuffer();
+            return false;
+        }
+        return true;
+    }
+
+    // Binds memory to the chunks covering the first size bytes that don't have any yet
+    bool bindChunks(VkDeviceSize size) {
+        size_t chunkCount = size_t((size + m_chunkSize - 1) / m_chunkSize);
+        if (chunkCount <= m_chunks.size()) {
+            return true;
+        }
+
+        VkMemoryRequirements chunkRequirements = m_sparseRequirements;
+        chunkRequirements.size = m_chunkSize;
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+        size_t firstChunk = m_chunks.size();
+        std::vector<VkSparseMemoryBind> binds;
+        for (size_t chunk = firstChunk; chunk < chunkCount; chunk++) {
+            VmaAllocation allocation = VK_NULL_HANDLE;
+            VmaAllocationInfo info{};
+            if (vmaAllocateMemory(m_allocator, &chunkRequirements, &allocInfo, &allocation, &info) != VK_SUCCESS) {
+                freeChunks(firstChunk);
+                return false;
+            }
+            m_chunks.push_back(allocation);
+
+            VkSparseMemoryBind bind{};
+            bind.resourceOffset = chunk * m_chunkSize;
+            // the last chunk may run into the end of the reserved range
+            bind.size = std::min(m_chunkSize, m_reservedSize - bind.resourceOffset);
+            bind.memory = info.deviceMemory;
+            bind.memoryOffset = info.offset;
+            binds.push_back(bind);
+        }
+
+        VkSparseBufferMemoryBindInfo bufferBind{};
+        bufferBind.buffer = m_gpuBuffer;
+        bufferBind.bindCount = uint32_t(binds.size());
+        bufferBind.pBinds = binds.data();
+
+        VkBindSparseInfo bindInfo{};
+        bindInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+        bindInfo.bufferBindCount = 1;
+        bindInfo.pBufferBinds = &bufferBind;
+
+        // frames in flight only read the chunks that were bound already, the copies after this wait for the fence
+        if (vkQueueBindSparse(m_queue, 1, &bindInfo, m_bindFence) != VK_SUCCESS) {
+            freeChunks(firstChunk);
+            return false;
+        }
+        vkWaitForFences(m_device, 1, &m_bindFence, VK_TRUE, UINT64_MAX);
+        vkResetFences(m_device, 1, &m_bindFence);
+        return true;
+    }
+
+    // Frees the memory of the chunks from firstChunk on, they must not be bound (anymore)
+    void freeChunks(size_t firstChunk) {
+        for (size_t chunk = firstChunk; chunk < m_chunks.size(); chunk++) {
+            vmaFreeMemory(m_allocator, m_chunks[chunk]);
+        }
+        m_chunks.resize(std::min(firstChunk, m_chunks.size()));
+    }
+
+    bool growSparse(size_t newCapacity) {
+        VkDeviceSize newBufferSize = newCapacity * sizeof(T);
+        if (newBufferSize > m_reservedSize || !bindChunks(newBufferSize)) {
+            return false;
+        }
+
+        // the staging buffer only holds what's being uploaded, nothing to copy over
+        VkBuffer oldStagingBuffer = m_stagingBuffer;
+        VmaAllocation oldStagingAllocation = m_stagingAllocation;
+        VmaAllocationInfo oldStagingInfo = m_stagingAllocationInfo;
+        if (!createStagingBuffer(newBufferSize)) {
+            m_stagingBuffer = oldStagingBuffer;
+            m_stagingAllocation = oldStagingAllocation;
+            m_stagingAllocationInfo = oldStagingInfo;
+            return false;
+        }
+        if (oldStagingBuffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(m_allocator, oldStagingBuffer, oldStagingAllocation);
+        }
+        m_capacity = newCapacity;
+        return true;
+    }
+
     bool createStagingBuffer(VkDeviceSize size) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -348,6 +726,21 @@ private:
         return result == VK_SUCCESS;
     }
 
+    void bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer,
+        VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
     bool copyToGPU(VkDeviceSize offset, VkDeviceSize size) {
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -363,13 +756,20 @@ private:
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
         vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        beginUploadTimer(commandBuffer);
 
         VkBufferCopy copyRegion{};
         copyRegion.srcOffset = offset;
         copyRegion.dstOffset = offset;
         copyRegion.size = size;
+        // frames in flight may still be ray marching the old contents
+        bufferBarrier(commandBuffer, m_gpuBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
         vkCmdCopyBuffer(commandBuffer, m_stagingBuffer, m_gpuBuffer, 1, &copyRegion);
+        bufferBarrier(commandBuffer, m_gpuBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
 
+        endUploadTimer(commandBuffer);
         vkEndCommandBuffer(commandBuffer);
 
         VkSubmitInfo submitInfo{};
@@ -379,6 +779,7 @@ private:
 
         vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
         vkQueueWaitIdle(m_queue);
+        collectUploadTime();
 
         vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
 
@@ -400,13 +801,17 @@ private:
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
         vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        beginUploadTimer(commandBuffer);
 
         VkBufferCopy copyRegion{};
         copyRegion.srcOffset = 0;
         copyRegion.dstOffset = 0;
         copyRegion.size = size;
         vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+        bufferBarrier(commandBuffer, dstBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
 
+        endUploadTimer(commandBuffer);
         vkEndCommandBuffer(commandBuffer);
 
         VkSubmitInfo submitInfo{};
@@ -416,6 +821,7 @@ private:
 
         vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
         vkQueueWaitIdle(m_queue);
+        collectUploadTime();
 
         vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
 
@@ -423,6 +829,15 @@ private:
     }
 
     void destroyGPUBuffer() {
+        if (m_sparse) {
+            if (m_gpuBuffer != VK_NULL_HANDLE) {
+                vkDestroyBuffer(m_device, m_gpuBuffer, nullptr);
+                m_gpuBuffer = VK_NULL_HANDLE;
+            }
+            freeChunks(0);
+            return;
+        }
+
         if (m_gpuBuffer != VK_NULL_HANDLE) {
             vmaDestroyBuffer(m_allocator, m_gpuBuffer, m_gpuAllocation);
             m_gpuBuffer = VK_NULL_HANDLE;
@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "buffer.hpp"
+
+// Point light, must match PointLight in lights.slang (std430)
+struct PointLight {
+    float position[3];
+    // the light reaches 0 at radius, lights are culled against it
+    float radius;
+    float color[3];
+    float intensity;
+};
+
+// Capacity of the GPU light buffer, lights past it are dropped
+const uint32_t MAX_POINT_LIGHTS = 16384;
+
+using PointLightBuffer = TreeBuffer<PointLight>;
+
+// Dense list of the lights of emissive leaves, kept up to date as leaves are created & freed instead
+// of scanning the tree for them. Removing swaps the last light into the hole, so the list stays dense
+// & only the slots that changed since the last upload are copied to the GPU.
+class LightRegistry {
+public:
+    // Thread safe, called by the tree workers
+    void add(uint32_t leafIndex, const PointLight& light) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (slotOfLeaf.count(leafIndex)) {
+            uint32_t slot = slotOfLeaf[leafIndex];
+            lights[slot] = light;
+            markDirty(slot);
+            return;
+        }
+        if (lights.size() >= MAX_POINT_LIGHTS) {
+            if (!warnedFull) {
+                std::cout << "light buffer full, dropping lights past " << MAX_POINT_LIGHTS << std::endl;
+                warnedFull = true;
+            }
+            return;
+        }
+
+        uint32_t slot = static_cast<uint32_t>(lights.size());
+        lights.push_back(light);
+        leafOfSlot.push_back(leafIndex);
+        slotOfLeaf[leafIndex] = slot;
+        markDirty(slot);
+    }
+
+    void remove(uint32_t leafIndex) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = slotOfLeaf.find(leafIndex);
+        if (it == slotOfLeaf.end()) {
+            return;
+        }
+
+        uint32_t slot = it->second;
+        uint32_t last = static_cast<uint32_t>(lights.size()) - 1;
+        slotOfLeaf.erase(it);
+        if (slot != last) {
+            lights[slot] = lights[last];
+            leafOfSlot[slot] = leafOfSlot[last];
+            slotOfLeaf[leafOfSlot[slot]] = slot;
+            markDirty(slot);
+        }
+        lights.pop_back();
+        leafOfSlot.pop_back();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        lights.clear();
+        leafOfSlot.clear();
+        slotOfLeaf.clear();
+        dirtyBegin = UINT32_MAX;
+        dirtyEnd = 0;
+    }
+
+    // Copies the changed slots to the GPU, returns the number of lights the buffer holds now
+    uint32_t upload(PointLightBuffer& buffer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t count = static_cast<uint32_t>(lights.size());
+        // slots past the count were removed, the shader never reads them
+        uint32_t end = std::min(dirtyEnd, count);
+        if (dirtyBegin < end) {
+            buffer.updateRange(dirtyBegin, end - dirtyBegin, lights.data() + dirtyBegin);
+        }
+        dirtyBegin = UINT32_MAX;
+        dirtyEnd = 0;
+        return count;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return lights.size();
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<PointLight> lights;
+    std::vector<uint32_t> leafOfSlot;
+    std::unordered_map<uint32_t, uint32_t> slotOfLeaf;
+    // half open range of slots written since the last upload
+    uint32_t dirtyBegin = UINT32_MAX;
+    uint32_t dirtyEnd = 0;
+    bool warnedFull = false;
+
+    void markDirty(uint32_t slot) {
+        dirtyBegin = std::min(dirtyBegin, slot);
+        dirtyEnd = std::max(dirtyEnd, slot + 1);
+    }
+};
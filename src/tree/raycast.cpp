@@ -0,0 +1,360 @@
+#include "raycast.hpp"
+#include "tree.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// Matches TreeConstants<treeDepth, 1, 4> in tree.slang
+static float getNodeSize(uint32_t depth) {
+    return baseVoxelSize * std::pow(4.0f, float(treeDepth - int(depth)));
+}
+
+static const float rootNodeSize = getNodeSize(0);
+
+// precomputed voxel offsets, same as getIndex() in tree.slang
+static const float childOffsets[4] = { -1.5f, -0.5f, 0.5f, 1.5f };
+
+struct ChildIndex {
+    glm::vec3 nodeCenter;
+    uint32_t index;
+};
+
+static uint32_t axisIndex(float relative, float invNodeSize) {
+    // clamp before converting, the shader relies on the GPU saturating negative floats to 0
+    return uint32_t(std::clamp(std::floor(relative * invNodeSize + 2.0f), 0.0f, 3.0f));
+}
+
+static ChildIndex getIndex(float nodeSize, glm::vec3 relativePos) {
+    float invNodeSize = 1.0f / nodeSize;
+
+    uint32_t xIndex = axisIndex(relativePos.x, invNodeSize);
+    uint32_t yIndex = axisIndex(relativePos.y, invNodeSize);
+    uint32_t zIndex = axisIndex(relativePos.z, invNodeSize);
+
+    return {
+        .nodeCenter = { childOffsets[xIndex] * nodeSize, childOffsets[yIndex] * nodeSize, childOffsets[zIndex] * nodeSize },
+        .index = (zIndex << 4) + (yIndex << 2) + xIndex,
+    };
+}
+
+static TreeSample defaultSample() {
+    TreeSample sample{};
+    // huge distance so max ray distance instantly gets triggered & ray marching stops.
+    sample.voxel.distance = 10000000.0f;
+    sample.voxel.material = MaterialType::Void;
+    return sample;
+}
+
+TreeSample sampleTree(const std::vector<TreeNode>& nodes, const std::vector<TreeLeaf>& leaves, glm::vec3 worldPos) {
+    if (nodes.empty()) {
+        return defaultSample();
+    }
+
+    TreeNode currentNode = nodes[0];
+    glm::vec3 nodeCenter{ 0.0f };
+    float nodeSize = rootNodeSize;
+
+    for (uint32_t depth = 0; depth <= uint32_t(treeDepth); depth++) {
+        if (currentNode.flags & LEAF_NODE_FLAG) {
+            uint32_t indexOffset = 0;
+            if (currentNode.flags & LOD_NODE_FLAG) {
+                depth++;
+                nodeSize = getNodeSize(depth);
+                ChildIndex index = getIndex(nodeSize, worldPos - nodeCenter);
+                indexOffset = index.index;
+                nodeCenter += index.nodeCenter;
+            }
+
+            size_t leafIndex = size_t(currentNode.childPointer) + indexOffset;
+            if (leafIndex >= leaves.size()) {
+                return defaultSample();
+            }
+
+            return {
+                .voxel = leaves[leafIndex],
+                .depth = depth,
+                .voxelSize = nodeSize,
+                .voxelCenter = nodeCenter,
+            };
+        }
+
+        // 4x4x4 tree matrix means 1/4th the voxel edge size for every depth step
+        nodeSize = getNodeSize(depth + 1);
+        ChildIndex index = getIndex(nodeSize, worldPos - nodeCenter);
+        nodeCenter += index.nodeCenter;
+
+        size_t childIndex = size_t(currentNode.childPointer) + index.index;
+        if (childIndex >= nodes.size()) {
+            return defaultSample();
+        }
+        currentNode = nodes[childIndex];
+    }
+
+    return defaultSample();
+}
+
+// The descent in sampleTree rounds differently to a plain bounds check right at node boundaries,
+// with an error that scales with the size of the coarsest node whose boundary it is.
+// Cached voxels keep clear of each face by a margin derived from that size, so a cache hit
+// always returns the same voxel the descent (and the GPU) would have found.
+static float faceMargin(float coordinate) {
+    float size = rootNodeSize;
+    while (size > baseVoxelSize && std::fmod(coordinate, size) != 0.0f) {
+        size *= 0.25f;
+    }
+    return size * 1e-6f;
+}
+
+// Voxels visited by the lanes of a packet. Coherent rays walk through the same voxels,
+// so most lookups are answered here instead of descending the tree from the root again.
+class VoxelCache {
+public:
+    const TreeSample* find(glm::vec3 pos) const {
+        for (size_t i = 0; i < count; i++) {
+            const Entry& entry = entries[i];
+            if (pos.x > entry.min.x && pos.x < entry.max.x &&
+                pos.y > entry.min.y && pos.y < entry.max.y &&
+                pos.z > entry.min.z && pos.z < entry.max.z) {
+                return &entry.sample;
+            }
+        }
+        return nullptr;
+    }
+
+    void insert(const TreeSample& sample) {
+        if (sample.voxelSize <= 0.0f) {
+            return; // fallback sample, doesn't cover any space
+        }
+
+        float halfSize = sample.voxelSize * 0.5f;
+        glm::vec3 min = sample.voxelCenter - halfSize;
+        glm::vec3 max = sample.voxelCenter + halfSize;
+        for (int axis = 0; axis < 3; axis++) {
+            min[axis] += faceMargin(min[axis]);
+            max[axis] -= faceMargin(max[axis]);
+        }
+
+        entries[next] = { sample, min, max };
+        next = (next + 1) % entries.size();
+        count = std::min(count + 1, entries.size());
+    }
+
+private:
+    struct Entry {
+        TreeSample sample;
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    std::array<Entry, RayCaster::packetSize * 2> entries;
+    size_t next = 0;
+    size_t count = 0;
+};
+
+struct MarchState {
+    glm::vec3 position;
+    glm::vec3 invDir;
+    float totalDistance = 0.0f;
+    float stepSize = 0.0f;
+    int steps = 0;
+    bool hit = false;
+    bool active = true;
+    glm::vec3 normal{ 0.0f };
+};
+
+static MarchState startMarch(const Ray& ray) {
+    MarchState state;
+    state.position = ray.origin;
+    // Precompute inverse direction once for efficiency
+    state.invDir = 1.0f / (ray.direction + glm::vec3(1e-5f));
+    return state;
+}
+
+// Use the ray-box intersection to determine which face was hit
+static glm::vec3 hitNormal(const TreeSample& sample, glm::vec3 position, glm::vec3 direction) {
+    float halfSize = sample.voxelSize * 0.5f;
+    glm::vec3 voxelMin = sample.voxelCenter - halfSize;
+    glm::vec3 voxelMax = sample.voxelCenter + halfSize;
+
+    glm::vec3 invDir = 1.0f / (direction + glm::vec3(1e-8f));
+    glm::vec3 t1 = (voxelMin - position) * invDir;
+    glm::vec3 t2 = (voxelMax - position) * invDir;
+
+    glm::vec3 tNear = glm::min(t1, t2);
+
+    // Find which axis we hit (whichever has the maximum tNear)
+    float tEntry = std::max(tNear.x, std::max(tNear.y, tNear.z));
+
+    if (tEntry == tNear.x) {
+        return { invDir.x > 0 ? -1.0f : 1.0f, 0.0f, 0.0f };
+    }
+    if (tEntry == tNear.y) {
+        return { 0.0f, invDir.y > 0 ? -1.0f : 1.0f, 0.0f };
+    }
+    return { 0.0f, 0.0f, invDir.z > 0 ? -1.0f : 1.0f };
+}
+
+// One iteration of the loop in raymarch(), keep in sync with raymarch.slang
+static void marchStep(MarchState& state, const Ray& ray, const TreeSample& sample) {
+    float epsilon = ray.epsilon;
+    float distance = sample.voxel.distance;
+
+    // For positive distances, try to skip to voxel boundary
+    if (distance > epsilon) {
+        float halfSize = sample.voxelSize * 0.5f;
+        glm::vec3 clampedPos = glm::clamp(state.position,
+            sample.voxelCenter - halfSize + epsilon,
+            sample.voxelCenter + halfSize - epsilon);
+
+        glm::vec3 t = (sample.voxelCenter + glm::sign(ray.direction) * halfSize - clampedPos) * state.invDir;
+        float tExit = std::min(t.x, std::min(t.y, t.z));
+
+        if (tExit > 0) {
+            float distanceFromCenter = glm::length(state.position - sample.voxelCenter);
+            distance = std::max(distance - distanceFromCenter, tExit + epsilon * 2);
+        }
+    }
+
+    state.stepSize = distance;
+
+    if (state.stepSize < epsilon) {
+        state.hit = true;
+        state.active = false;
+        if (!ray.lightProbe) {
+            state.normal = hitNormal(sample, state.position, ray.direction);
+        }
+        return;
+    }
+
+    state.position += ray.direction * state.stepSize;
+    state.totalDistance += state.stepSize;
+    state.steps++;
+}
+
+static RayHit finishMarch(const MarchState& state) {
+    return {
+        .distance = state.totalDistance,
+        .lastStepSize = state.stepSize,
+        .steps = state.steps,
+        .hit = state.hit,
+        .position = state.position,
+        .normal = state.normal,
+    };
+}
+
+RayCaster::RayCaster(const std::vector<TreeNode>& nodes, const std::vector<TreeLeaf>& leaves, unsigned int numThreads)
+    : nodes(nodes)
+    , leaves(leaves)
+{
+    startWorkers(numThreads);
+}
+
+RayCaster::RayCaster(const TreeManager& tree, unsigned int numThreads)
+    : RayCaster(tree.nodes, tree.leaves, numThreads)
+{
+}
+
+RayCaster::~RayCaster() {
+    jobs.close();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+RayHit RayCaster::cast(const Ray& ray) const {
+    RayHit hit;
+    castPacket(&ray, &hit, 1);
+    return hit;
+}
+
+void RayCaster::castPacket(const Ray* rays, RayHit* hits, size_t count) const {
+    count = std::min(count, packetSize);
+
+    std::array<MarchState, packetSize> lanes;
+    for (size_t i = 0; i < count; i++) {
+        lanes[i] = startMarch(rays[i]);
+    }
+
+    VoxelCache cache;
+    size_t activeLanes = count;
+
+    // All lanes take one step per iteration, so they stay close together in the tree
+    // and the voxels one lane looked up are still cached when its neighbours get there.
+    while (activeLanes > 0) {
+        for (size_t i = 0; i < count; i++) {
+            MarchState& state = lanes[i];
+            if (!state.active) {
+                continue;
+            }
+
+            const Ray& ray = rays[i];
+            if (state.steps >= ray.maxSteps || state.totalDistance >= ray.maxDistance) {
+                state.active = false;
+                activeLanes--;
+                continue;
+            }
+
+            const TreeSample* sample = cache.find(state.position);
+            TreeSample lookup;
+            if (!sample) {
+                lookup = sampleTree(nodes, leaves, state.position);
+                cache.insert(lookup);
+                sample = &lookup;
+            }
+
+            marchStep(state, ray, *sample);
+            if (!state.active) {
+                activeLanes--;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        hits[i] = finishMarch(lanes[i]);
+    }
+}
+
+void RayCaster::castBatch(const std::vector<Ray>& rays, std::vector<RayHit>& hits) {
+    hits.resize(rays.size());
+    if (rays.empty()) {
+        return;
+    }
+
+    std::vector<PacketJob> packets;
+    packets.reserve((rays.size() + packetSize - 1) / packetSize);
+
+    WaitGroup batch;
+    for (size_t i = 0; i < rays.size(); i += packetSize) {
+        packets.push_back(PacketJob{
+            .rays = rays.data() + i,
+            .hits = hits.data() + i,
+            .count = std::min(packetSize, rays.size() - i),
+            .batch = &batch,
+        });
+    }
+
+    batch.add(packets.size());
+    jobs.sendMany(packets);
+    batch.wait();
+}
+
+void RayCaster::startWorkers(unsigned int numThreads) {
+    if (numThreads == 0) numThreads = std::thread::hardware_concurrency();
+    if (numThreads == 0) numThreads = 4;
+
+    workers.reserve(numThreads);
+    for (unsigned int i = 0; i < numThreads; i++) {
+        workers.emplace_back(&RayCaster::workerThread, this);
+    }
+}
+
+void RayCaster::workerThread() {
+    PacketJob job;
+    while (jobs.receive(job)) {
+        castPacket(job.rays, job.hits, job.count);
+        job.batch->done();
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "buffer.hpp"
+#include "../util/channel.hpp"
+#include "../util/waitgroup.hpp"
+
+class TreeManager;
+
+// Result of a CPU tree lookup, mirrors TreeSDFResult in tree.slang
+struct TreeSample {
+    TreeLeaf voxel;
+    uint32_t depth;
+    float voxelSize;
+    glm::vec3 voxelCenter;
+};
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction; // expected to be normalized
+    float maxDistance = 100000.0f;
+    int maxSteps = 200;
+    float epsilon = 0.0001f;
+    // light probes stop at the first hit and skip the normal calculation,
+    // the same as raymarch(..., lightProbe = true) in raymarch.slang
+    bool lightProbe = false;
+};
+
+// Mirrors raymarchResult in raymarch.slang
+struct RayHit {
+    float distance = 0.0f;
+    float lastStepSize = 0.0f;
+    int steps = 0;
+    bool hit = false;
+    glm::vec3 position{ 0.0f };
+    glm::vec3 normal{ 0.0f };
+};
+
+// Look up the leaf containing worldPos, mirrors treeSDF() in tree.slang.
+// Out of range indices return the same "infinitely far" default leaf the shader falls back to.
+TreeSample sampleTree(const std::vector<TreeNode>& nodes, const std::vector<TreeLeaf>& leaves, glm::vec3 worldPos);
+
+// CPU ray marcher over the 64tree, for gameplay queries (line of sight, bullets, audio occlusion).
+// The marching logic mirrors raymarch() in raymarch.slang step for step, including the voxel boundary
+// skipping & hit normals, so results agree with what the GPU renders.
+//
+// The tree vectors are read without locking, don't cast while the TreeManager is rebuilding nodes.
+class RayCaster {
+public:
+    // Rays are traced in packets of this size, lanes step in lockstep & share recently visited voxels
+    static constexpr size_t packetSize = 8;
+
+    RayCaster(const std::vector<TreeNode>& nodes, const std::vector<TreeLeaf>& leaves, unsigned int numThreads = 0);
+    explicit RayCaster(const TreeManager& tree, unsigned int numThreads = 0);
+    ~RayCaster();
+
+    RayCaster(const RayCaster&) = delete;
+    RayCaster& operator=(const RayCaster&) = delete;
+
+    // Trace a single ray on the calling thread
+    RayHit cast(const Ray& ray) const;
+
+    // Trace up to packetSize coherent rays on the calling thread
+    void castPacket(const Ray* rays, RayHit* hits, size_t count) const;
+
+    // Trace a batch of rays, split into packets & spread across the worker threads.
+    // Blocks until every ray in the batch is done, batches from several threads may run concurrently.
+    // Packets are formed from consecutive rays, so rays that are close in the input should be close in space.
+    void castBatch(const std::vector<Ray>& rays, std::vector<RayHit>& hits);
+
+private:
+    struct PacketJob {
+        const Ray* rays;
+        RayHit* hits;
+        size_t count;
+        WaitGroup* batch;
+    };
+
+    const std::vector<TreeNode>& nodes;
+    const std::vector<TreeLeaf>& leaves;
+
+    std::vector<std::thread> workers;
+    Channel<PacketJob> jobs;
+
+    void startWorkers(unsigned int numThreads);
+    void workerThread();
+};
@@ -0,0 +1,306 @@
+// Checks RayCaster against sampleTree & itself, and against raymarch() from the shaders: raymarchCPU in
+// shaders/cpu.slang, compiled to C++ by slangc (see the `raycast-test` step in build.zig).
+
+#include "raycast.hpp"
+#include "tree.hpp"
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+
+// Simple test macros
+#define TEST(name) void test_##name()
+#define RUN_TEST(name) do { \
+    std::cout << "Running " #name "... "; \
+    test_##name(); \
+    std::cout << "PASSED" << std::endl; \
+} while(0)
+
+#define ASSERT_EQ(actual, expected) do { \
+    if ((actual) != (expected)) { \
+        std::cerr << "FAILED: " << #actual << " != " << #expected \
+                  << " (got " << (actual) << ", expected " << (expected) << ")" << std::endl; \
+        std::exit(1); \
+    } \
+} while(0)
+
+#define ASSERT_NEAR(actual, expected, epsilon) do { \
+    if (fabs((actual) - (expected)) > (epsilon)) { \
+        std::cerr << "FAILED: " << #actual << " not near " << #expected \
+                  << " (got " << (actual) << ", expected " << (expected) \
+                  << ", diff " << fabs((actual) - (expected)) << ")" << std::endl; \
+        std::exit(1); \
+    } \
+} while(0)
+
+// Shared test scene: the root's 64 children are sparsity leaves, solid below y = 0 and empty above.
+// Rendering the same buffers with computeMain shows a flat floor at y = 0,
+// the expected values below are what raymarch() on the GPU produces for these rays.
+static void buildHalfSpaceScene(std::vector<TreeNode>& nodes, std::vector<TreeLeaf>& leaves) {
+    nodes.clear();
+    leaves.clear();
+
+    nodes.push_back(TreeNode{ .childPointer = 1, .flags = 0, .padding = {} });
+    for (uint32_t i = 0; i < 64; i++) {
+        uint32_t y = (i >> 2) & 3;
+        bool solid = y < 2;
+
+        nodes.push_back(TreeNode{ .childPointer = i, .flags = LEAF_NODE_FLAG, .padding = {} });
+        leaves.push_back(TreeLeaf{
+            .distance = solid ? -1.0f : 0.01f,
+            .material = solid ? MaterialType::Stone : MaterialType::Void,
+            .damage = 0,
+            .flags = LEAF_NODE_FLAG,
+            .padding = 0,
+        });
+    }
+}
+
+// Steps on top of the half space: the children one level above the floor are solid where x + z is even, so rays
+// hit tops, sides & the floor between them
+static void buildStepScene(std::vector<TreeNode>& nodes, std::vector<TreeLeaf>& leaves) {
+    buildHalfSpaceScene(nodes, leaves);
+    for (uint32_t i = 0; i < 64; i++) {
+        uint32_t x = i & 3;
+        uint32_t y = (i >> 2) & 3;
+        uint32_t z = i >> 4;
+        if (y == 2 && (x + z) % 2 == 0) {
+            leaves[i].distance = -1.0f;
+            leaves[i].material = MaterialType::Stone;
+        }
+    }
+}
+
+static std::vector<TreeNode> sceneNodes;
+static std::vector<TreeLeaf> sceneLeaves;
+
+// Host side view of raymarchCPU's parameters, in the layout Slang uses for CPU targets (see CPUShaderGlobals in
+// src/bench/cpubench.cpp). The computeCPU globals before them aren't read by raymarchCPU.
+template <typename T>
+struct ShaderBuffer {
+    T* data;
+    size_t count;
+};
+
+struct ShaderRayDispatch {
+    uint32_t count;
+    const TreeNode* treeNodes;
+    const TreeLeaf* treeLeaves;
+};
+
+struct ShaderRay {
+    float origin[3];
+    float maxDistance;
+    float direction[3];
+    int32_t maxSteps;
+    float epsilon;
+    uint32_t lightProbe;
+};
+
+struct ShaderRayHit {
+    float distance;
+    int32_t steps;
+    uint32_t hit;
+    float position[3];
+    float normal[3];
+};
+
+struct ShaderGlobals {
+    const void* frameUniforms;
+    const void* renderUniforms;
+    const void* dispatch;
+    ShaderBuffer<void> outputColor;
+    ShaderBuffer<void> outputSteps;
+    ShaderBuffer<void> outputDepth;
+    ShaderBuffer<void> outputAO;
+    ShaderBuffer<const void> startDistances;
+    const ShaderRayDispatch* rayDispatch;
+    ShaderBuffer<const ShaderRay> rays;
+    ShaderBuffer<ShaderRayHit> rayHits;
+};
+
+// ComputeVaryingInput from slang-cpp-types.h, the range of workgroups to run
+struct ShaderVaryingInput {
+    uint32_t startGroupID[3];
+    uint32_t endGroupID[3];
+};
+
+extern "C" void raymarchCPU(ShaderVaryingInput* varyingInput, void* entryPointParams, void* globalParams);
+
+static const uint32_t shaderGroupSize = 64; // [numthreads(64, 1, 1)] in cpu.slang
+
+// Marches every ray with the shader's raymarch() on the calling thread
+static std::vector<ShaderRayHit> shaderRaymarch(const std::vector<TreeNode>& nodes, const std::vector<TreeLeaf>& leaves,
+    const std::vector<Ray>& rays) {
+    std::vector<ShaderRay> shaderRays;
+    for (const Ray& ray : rays) {
+        shaderRays.push_back(ShaderRay{
+            .origin = { ray.origin.x, ray.origin.y, ray.origin.z },
+            .maxDistance = ray.maxDistance,
+            .direction = { ray.direction.x, ray.direction.y, ray.direction.z },
+            .maxSteps = ray.maxSteps,
+            .epsilon = ray.epsilon,
+            .lightProbe = ray.lightProbe ? 1u : 0u,
+        });
+    }
+    std::vector<ShaderRayHit> hits(rays.size());
+
+    ShaderRayDispatch dispatch{ .count = uint32_t(rays.size()), .treeNodes = nodes.data(), .treeLeaves = leaves.data() };
+    ShaderGlobals globals{
+        .rayDispatch = &dispatch,
+        .rays = { shaderRays.data(), shaderRays.size() },
+        .rayHits = { hits.data(), hits.size() },
+    };
+    ShaderVaryingInput input{
+        .startGroupID = { 0, 0, 0 },
+        .endGroupID = { (uint32_t(rays.size()) + shaderGroupSize - 1) / shaderGroupSize, 1, 1 },
+    };
+    raymarchCPU(&input, nullptr, &globals);
+    return hits;
+}
+
+TEST(sampleTree_findsSparsityLeaf) {
+    TreeSample above = sampleTree(sceneNodes, sceneLeaves, { 1.0f, 100.0f, 2.0f });
+    ASSERT_NEAR(above.voxel.distance, 0.01f, 0.0001f);
+    ASSERT_EQ(above.depth, 1u);
+    ASSERT_NEAR(above.voxelSize, 16384.0f, 0.001f);
+    ASSERT_NEAR(above.voxelCenter.y, 8192.0f, 0.001f);
+
+    TreeSample below = sampleTree(sceneNodes, sceneLeaves, { 1.0f, -100.0f, 2.0f });
+    ASSERT_NEAR(below.voxel.distance, -1.0f, 0.0001f);
+    ASSERT_NEAR(below.voxelCenter.y, -8192.0f, 0.001f);
+}
+
+TEST(cast_hitsFloor) {
+    RayCaster caster(sceneNodes, sceneLeaves, 1);
+
+    RayHit hit = caster.cast(Ray{ .origin = { 1.0f, 100.0f, 2.0f }, .direction = { 0.0f, -1.0f, 0.0f } });
+
+    ASSERT_EQ(hit.hit, true);
+    ASSERT_EQ(hit.steps, 1);
+    ASSERT_NEAR(hit.distance, 100.0f, 0.01f);
+    ASSERT_NEAR(hit.position.y, 0.0f, 0.01f);
+    ASSERT_NEAR(hit.normal.x, 0.0f, 0.0001f);
+    ASSERT_NEAR(hit.normal.y, 1.0f, 0.0001f);
+    ASSERT_NEAR(hit.normal.z, 0.0f, 0.0001f);
+}
+
+TEST(cast_lightProbeInsideGeometry) {
+    RayCaster caster(sceneNodes, sceneLeaves, 1);
+
+    RayHit hit = caster.cast(Ray{
+        .origin = { 1.0f, -5.0f, 2.0f },
+        .direction = glm::normalize(glm::vec3(0.4f, 1.0f, 0.3f)),
+        .maxDistance = 1000.0f,
+        .maxSteps = 50,
+        .lightProbe = true,
+    });
+
+    ASSERT_EQ(hit.hit, true);
+    ASSERT_EQ(hit.steps, 0);
+    // light probes skip the normal
+    ASSERT_NEAR(hit.normal.y, 0.0f, 0.0001f);
+}
+
+TEST(cast_missRespectsStepBudget) {
+    RayCaster caster(sceneNodes, sceneLeaves, 1);
+
+    RayHit hit = caster.cast(Ray{ .origin = { 1.0f, 50.0f, 2.0f }, .direction = { 1.0f, 0.0f, 0.0f }, .maxSteps = 20 });
+
+    ASSERT_EQ(hit.hit, false);
+    ASSERT_EQ(hit.steps, 20);
+}
+
+TEST(castBatch_matchesSingleRays) {
+    RayCaster caster(sceneNodes, sceneLeaves, 4);
+
+    // a coherent fan of rays, like a small patch of screen pixels.
+    // No component is exactly 0, raymarch() can't skip voxels along such an axis (sign() is 0) and crawls.
+    std::vector<Ray> rays;
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 37; x++) {
+            glm::vec3 direction = glm::normalize(glm::vec3((x - 18) * 0.05f + 0.025f, -1.0f, (y - 8) * 0.05f + 0.025f));
+            rays.push_back(Ray{ .origin = { 3.0f, 20.0f, -4.0f }, .direction = direction });
+        }
+    }
+
+    std::vector<RayHit> hits;
+    caster.castBatch(rays, hits);
+    ASSERT_EQ(hits.size(), rays.size());
+
+    for (size_t i = 0; i < rays.size(); i++) {
+        RayHit single = caster.cast(rays[i]);
+        ASSERT_EQ(hits[i].hit, single.hit);
+        ASSERT_EQ(hits[i].steps, single.steps);
+        ASSERT_NEAR(hits[i].distance, single.distance, 0.001f);
+        ASSERT_NEAR(hits[i].position.y, 0.0f, 0.01f);
+        ASSERT_NEAR(hits[i].normal.y, 1.0f, 0.0001f);
+    }
+}
+
+TEST(cast_matchesShaderRaymarch) {
+    std::vector<TreeNode> nodes;
+    std::vector<TreeLeaf> leaves;
+    buildStepScene(nodes, leaves);
+    RayCaster caster(nodes, leaves, 1);
+
+    // fans of rays from above the steps, from beside them & from inside the floor, mostly hitting tops, sides &
+    // the floor, some going up into nothing. No component is exactly 0, see castBatch_matchesSingleRays
+    std::vector<Ray> rays;
+    const glm::vec3 origins[] = { { 3.0f, 20000.0f, -4.0f }, { -30000.0f, 2000.0f, 1000.0f }, { 500.0f, -300.0f, 700.0f } };
+    for (glm::vec3 origin : origins) {
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 16; x++) {
+                glm::vec3 direction = glm::normalize(glm::vec3((x - 8) * 0.13f + 0.011f, (y - 5) * 0.21f + 0.017f,
+                    0.37f - (x % 3) * 0.29f));
+                rays.push_back(Ray{ .origin = origin, .direction = direction });
+            }
+        }
+    }
+    // short step budgets stop mid march & light probes skip the normal
+    for (size_t i = 0; i < 64; i++) {
+        Ray ray = rays[i * 5 % rays.size()];
+        ray.maxSteps = 3;
+        ray.lightProbe = i % 2 == 0;
+        rays.push_back(ray);
+    }
+
+    std::vector<ShaderRayHit> shaderHits = shaderRaymarch(nodes, leaves, rays);
+
+    int hits = 0;
+    for (size_t i = 0; i < rays.size(); i++) {
+        RayHit hit = caster.cast(rays[i]);
+        const ShaderRayHit& shaderHit = shaderHits[i];
+
+        ASSERT_EQ(hit.hit, shaderHit.hit != 0);
+        // relative, the rays march thousands of units
+        ASSERT_NEAR(hit.distance, shaderHit.distance, 0.0001f * std::max(1.0f, shaderHit.distance));
+        if (hit.hit) {
+            hits++;
+            ASSERT_NEAR(hit.normal.x, shaderHit.normal[0], 0.001f);
+            ASSERT_NEAR(hit.normal.y, shaderHit.normal[1], 0.001f);
+            ASSERT_NEAR(hit.normal.z, shaderHit.normal[2], 0.001f);
+        }
+    }
+    // the fans have to reach the steps for the normals to be checked at all
+    if (hits < int(rays.size()) / 2) {
+        std::cerr << "FAILED: only " << hits << " of " << rays.size() << " rays hit" << std::endl;
+        std::exit(1);
+    }
+}
+
+int main() {
+    std::cout << "=== Running Raycast Tests ===" << std::endl;
+
+    buildHalfSpaceScene(sceneNodes, sceneLeaves);
+
+    RUN_TEST(sampleTree_findsSparsityLeaf);
+    RUN_TEST(cast_hitsFloor);
+    RUN_TEST(cast_lightProbeInsideGeometry);
+    RUN_TEST(cast_missRespectsStepBudget);
+    RUN_TEST(castBatch_matchesSingleRays);
+    RUN_TEST(cast_matchesShaderRaymarch);
+
+    std::cout << std::endl << "=== All Tests Passed ===" << std::endl;
+    return 0;
+}
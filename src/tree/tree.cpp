@@ -165,15 +165,13 @@ int calculateLOD(int treeDepth, float distance, float lengthThreshold) {
     return (LOD > 3) ? LOD : 3;
 }
 
-const float minStep = 0.33;
-
 float sampleLipschitzBoundAt(vec3 position, float voxelSize) {
     float centerDistance = sampleDistanceAt(position);
 
     // Conservative bound on magnitude
     float halfDiagonal = voxelSize * 1.732050808f * 0.5f;
     //float halfDiagonal = voxelSize * 0.5f;
-    float conservativeMagnitude = abs(centerDistance) - halfDiagonal;
+    float conservativeMagnitude = std::abs(centerDistance) - halfDiagonal;
 
     // Preserve the sign from center sample.
     // The minStep is kind of a magic number here that I'm not entirely sure why it makes the voxel marching work just right.
@@ -185,7 +183,7 @@ float getLipschitzBound(float centerDistance, float voxelSize) {
     // Conservative bound on magnitude
     float halfDiagonal = voxelSize * 1.732050808f * 0.5f;
     //float halfDiagonal = voxelSize * 0.5f;
-    float conservativeMagnitude = abs(centerDistance) - halfDiagonal;
+    float conservativeMagnitude = std::abs(centerDistance) - halfDiagonal;
 
     // Preserve the sign from center sample.
     // The minStep is kind of a magic number here that I'm not entirely sure why it makes the voxel marching work just right.
@@ -193,11 +191,33 @@ float getLipschitzBound(float centerDistance, float voxelSize) {
     return (centerDistance >= 0 ? 1.0f : -1.0f) * fmax(conservativeMagnitude, voxelSize * minStep * 0.01);
 }
 
+// Sparse torches in the top layer of the finest voxels of the test terrain
+static bool isTorchSite(vec3 position, float voxelSize, float distance, int depth) {
+    if (depth != treeDepth || distance >= 0 || distance < -voxelSize) {
+        return false;
+    }
+    int32_t x = int32_t(std::floor(position.x / voxelSize));
+    int32_t y = int32_t(std::floor(position.y / voxelSize));
+    int32_t z = int32_t(std::floor(position.z / voxelSize));
+    uint32_t hash = uint32_t(x * 73856093) ^ uint32_t(y * 19349663) ^ uint32_t(z * 83492791);
+    return hash % 2048 == 0;
+}
+
+PointLight torchLight(vec3 position, float voxelSize) {
+    return {
+        // just above the torch voxel, so it doesn't shadow itself
+        .position = { position.x, position.y + voxelSize, position.z },
+        .radius = 12.0f,
+        .color = { 1.0f, 0.6f, 0.3f },
+        .intensity = 1.5f,
+    };
+}
+
 // TODO: update name & fingerprint to reflect the fact that this now is only supposed to be used for sparsity leaves
-uint32_t TreeManager::createLeaf(float distance) {
+uint32_t TreeManager::createLeaf(float distance, MaterialType solid) {
     MaterialType material = MaterialType::Void;
     if (distance < 0.00) {
-        material = MaterialType::Grass;
+        material = solid;
     }
 
     uint8_t flags = LEAF_NODE_FLAG;
@@ -210,8 +230,16 @@ uint32_t TreeManager::createLeaf(float distance) {
     };
 
     std::lock_guard<std::mutex> lock(leavesMutex);
-    uint32_t leafPointer = leaves.size();
-    leaves.push_back(leaf);
+    uint32_t leafPointer;
+    if (!freeLeafIndices.empty()) {
+        leafPointer = freeLeafIndices.front();
+        freeLeafIndices.pop_front();
+        leaves[leafPointer] = leaf;
+    } else {
+        leafPointer = leaves.size();
+        leaves.push_back(leaf);
+    }
+    dirtyLeaves.add(leafPointer, 1);
 
     return leafPointer;
 }
@@ -221,17 +249,24 @@ void TreeManager::createLeaves(uint32_t parentIndex, int depth, vec3 parentPosit
 
 	std::vector<TreeLeaf> newLeaves;
 	newLeaves.reserve(64);
+	std::vector<std::pair<uint32_t, PointLight>> torches;
 	for (uint32_t i = 0; i < 64; i++) {
         vec3 childPosition = getChunkPosition(i, voxelSize, parentPosition);
-        float distance = sampleDistanceAt(childPosition);
+        MaterialType solid = MaterialType::Grass;
+        float distance = sampleEditedDistance(childPosition, solid);
+        // only in the terrain's own grass, not in filled in material
+        bool torch = solid == MaterialType::Grass && isTorchSite(childPosition, voxelSize, distance, depth);
+        if (torch) {
+            torches.emplace_back(i, torchLight(childPosition, voxelSize));
+        }
         distance = getLipschitzBound(distance, voxelSize);
-        if (abs(distance) < voxelSize * minStep) {
+        if (std::abs(distance) < voxelSize * minStep) {
             distance = (distance >= 0 ? 1.0f : -1.0f) * voxelSize * minStep;
         }
 
         TreeLeaf leaf = {
             .distance = distance,
-            .material = distance < 0 ? MaterialType::Grass : MaterialType::Void,
+            .material = torch ? MaterialType::Torch : distance < 0 ? solid : MaterialType::Void,
             .damage = 0,
             .flags = LEAF_NODE_FLAG | LOD_NODE_FLAG,
         };
@@ -242,8 +277,19 @@ void TreeManager::createLeaves(uint32_t parentIndex, int depth, vec3 parentPosit
 	uint32_t leafPointer = 0;
 	{
 		std::lock_guard<std::mutex> lock(leavesMutex);
-		leafPointer = leaves.size();
-		leaves.insert(leaves.end(), newLeaves.begin(), newLeaves.end());
+		// blocks freed by coarsening or LOD updates first
+		if (!freeLeafBlocks.empty()) {
+			leafPointer = freeLeafBlocks.front();
+			freeLeafBlocks.pop_front();
+			std::copy(newLeaves.begin(), newLeaves.end(), leaves.begin() + leafPointer);
+		} else {
+			leafPointer = leaves.size();
+			leaves.insert(leaves.end(), newLeaves.begin(), newLeaves.end());
+		}
+		dirtyLeaves.add(leafPointer, 64);
+	}
+	for (auto& [child, light] : torches) {
+		lights.add(leafPointer + child, light);
 	}
 
 	std::shared_lock<std::shared_mutex> lock(nodesMutex);
@@ -260,12 +306,13 @@ void TreeManager::subdivideNode(
     //std::cout << depth << std::endl;
     float voxelSize = getVoxelSizeAtDepth(depth);
 
-    float distance = sampleDistanceAt(parentPosition);
+    MaterialType solid = MaterialType::Grass;
+    float distance = sampleEditedDistance(parentPosition, solid);
 
     // create sparsity leaf if the nearest surface is further than the size of the node
     float halfDiagonal = voxelSize * 1.732050808f * 0.5f;
-    if (abs(distance) > halfDiagonal * 1.01) {
-        uint32_t leafPointer = createLeaf(getLipschitzBound(distance, voxelSize));
+    if (std::abs(distance) > halfDiagonal * 1.01) {
+        uint32_t leafPointer = createLeaf(getLipschitzBound(distance, voxelSize), solid);
 
         {
             std::shared_lock<std::shared_mutex> lock(nodesMutex);
@@ -346,6 +393,10 @@ void TreeManager::createTestTree() {
 
     nodes.clear();
     leaves.clear();
+    lights.clear();
+    edits.clear();
+    pendingEdits.clear();
+    resetAllocations();
 
     // Initialize observer at origin
     observerPos = {0.0f, 0.0f, 0.0f};
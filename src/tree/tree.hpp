@@ -13,7 +13,10 @@
 #include <unordered_map>
 #include <thread>
 #include <unordered_set>
+#include <algorithm>
 #include "buffer.hpp"
+#include "lights.hpp"
+#include "treeedit.hpp"
 #include "../util/channel.hpp"
 #include "../util/waitgroup.hpp"
 
@@ -44,6 +47,38 @@ struct nodeToProcess {
 vec3 getChunkPosition(uint32_t chunkIndex, float voxelSize, vec3 parentPosition);
 int calculateLOD(int treeDepth, float distance, float lengthThreshold);
 float sampleDistanceAt(vec3 position);
+// voxel leaves are never closer to the surface than minStep voxels
+const float minStep = 0.33f;
+// Distance bound over a whole voxel from the distance at its center
+float getLipschitzBound(float centerDistance, float voxelSize);
+// light of a torch voxel centered at position
+PointLight torchLight(vec3 position, float voxelSize);
+
+// Differences between two trees of the same terrain. They're walked from the root side by side, so the
+// order of the nodes & leaves in the buffers doesn't matter
+struct TreeDiff {
+    uint64_t nodes = 0;
+    uint64_t leaves = 0;
+    // nodes that are a different kind in the two trees (children, sparsity leaf or voxel leaves)
+    uint64_t structure = 0;
+    uint64_t materials = 0;
+    // leaves whose distances differ by more than the tolerance, relative to their voxel size
+    uint64_t distances = 0;
+    float maxDistanceError = 0.0f;
+};
+
+TreeDiff compareTrees(const std::vector<TreeNode>& nodesA, const std::vector<TreeLeaf>& leavesA,
+    const std::vector<TreeNode>& nodesB, const std::vector<TreeLeaf>& leavesB, float distanceTolerance = 1e-3f);
+
+// What TreeManager::enforceMemoryBudget did in a frame
+struct TreeBudgetReport {
+    // subtrees replaced by a sparsity leaf
+    uint32_t coarsened = 0;
+    uint64_t evictedNodes = 0;
+    uint64_t evictedLeaves = 0;
+    // node & leaf memory within the GPU buffers that's free for reuse afterwards
+    uint64_t reusableBytes = 0;
+};
 
 class TreeManager {
 public:
@@ -52,42 +87,108 @@ public:
     std::vector<TreeLeaf> leaves;
     std::deque<uint32_t> freeLeafIndices;
 
+    // lights of the torch leaves, registered & removed along with the leaves
+    LightRegistry lights;
+
     // GPU buffers
     TreeNodeBuffer nodeBuffer;
     TreeLeafBuffer leafBuffer;
+    PointLightBuffer lightBuffer;
 
     // Initialize buffers with VMA allocator
     void initBuffers(VmaAllocator allocator, VkDevice device, uint32_t queueFamilyIndex) {
         nodeBuffer.init(allocator, device, queueFamilyIndex);
         leafBuffer.init(allocator, device, queueFamilyIndex);
+        lightBuffer.init(allocator, device, queueFamilyIndex);
+        // fixed size, so the descriptor never changes as lights come & go
+        lightBuffer.createEmpty(MAX_POINT_LIGHTS);
     }
 
     // Upload current CPU data to GPU
     void uploadToGPU() {
         nodeBuffer.create(nodes);
         leafBuffer.create(leaves);
+        gpuLightCount = lights.upload(lightBuffer);
+        gpuVersion++;
+        dirtyNodes = {};
+        dirtyLeaves = {};
     }
 
     // Update GPU buffers after modifications
     void updateGPUBuffers() {
         nodeBuffer.update(nodes);
         leafBuffer.update(leaves);
+        gpuLightCount = lights.upload(lightBuffer);
+        gpuVersion++;
+        dirtyNodes = {};
+        dirtyLeaves = {};
     }
 
+    // Counts up on every upload, anything derived from the previous GPU tree is stale once it changes
+    uint64_t getGPUVersion() const { return gpuVersion; }
+
     // Get buffers for binding to descriptors
     VkBuffer getNodeBuffer() const { return nodeBuffer.getBuffer(); }
     VkBuffer getLeafBuffer() const { return leafBuffer.getBuffer(); }
+    VkBuffer getLightBuffer() const { return lightBuffer.getBuffer(); }
+    // Addresses the ray marcher reads the nodes & leaves through, passed in the frame uniforms every frame
+    VkDeviceAddress getNodeAddress() const { return nodeBuffer.getDeviceAddress(); }
+    VkDeviceAddress getLeafAddress() const { return leafBuffer.getDeviceAddress(); }
+    // lights in the GPU buffer as of the last upload
+    uint32_t getLightCount() const { return gpuLightCount; }
+
+    // GPU time of the node & leaf uploads since the last call, for the GPU profiler
+    bool takeUploadTime(double& milliseconds) {
+        double nodeMs = 0.0, leafMs = 0.0, lightMs = 0.0;
+        bool uploadedNodes = nodeBuffer.takeUploadTime(nodeMs);
+        bool uploadedLeaves = leafBuffer.takeUploadTime(leafMs);
+        bool uploadedLights = lightBuffer.takeUploadTime(lightMs);
+        milliseconds = nodeMs + leafMs + lightMs;
+        return uploadedNodes || uploadedLeaves || uploadedLights;
+    }
 
     // Cleanup
     void destroyBuffers() {
         nodeBuffer.destroy();
         leafBuffer.destroy();
+        lightBuffer.destroy();
     }
 
     void createTestTree();
+    // Same tree as createTestTree, built by the compute shaders of shaderPath (treebuild.slang) straight into
+    // the GPU buffers, instead of uploadToGPU. It's read back to nodes & leaves for the CPU side LOD updates
+    void buildOnGPU(VmaAllocator allocator, VkDevice device, uint32_t queueFamilyIndex, const std::string& shaderPath);
+
+    // Bake the CPU side node & leaf data to disk, so benchmarks run against identical trees
+    void saveToFile(const std::string& path) const;
+    void loadFromFile(const std::string& path);
+
     void moveObserver(vec3 pos);
     void updateStaleLODs();
 
+    // CSG edits on top of the terrain, in the order they were made (tree_edit.cpp). applyEdit makes the same
+    // in place changes to nodes & leaves as treeedit.slang makes to the GPU buffers, the brush is handed to
+    // GpuTreeEditor by takePendingEdits. Nodes built from then on, e.g. by updateStaleLODs, sample the edits too
+    void applyEdit(EditBrush brush);
+    // Brushes applied since the last call, at most maxCount, oldest first
+    std::vector<EditBrush> takePendingEdits(uint32_t maxCount);
+    // Sparsity leaves the brushes' surfaces pass through, for when the GPU's requests overflowed
+    void findEditRequests(const std::vector<EditBrush>& brushes, std::vector<EditRequest>& requests);
+    // Gives the requested sparsity leaves children & uploads them, false if none of them still needed it.
+    // The node & leaf buffers are recreated when they don't fit anymore
+    bool rebuildEditedNodes(const std::vector<EditRequest>& requests);
+    // Terrain with the edits applied, material is what a negative distance is made of
+    float sampleEditedDistance(vec3 position, MaterialType& material) const;
+
+    // Device memory budget (tree_budget.cpp). Once the device memory in use, less what the tree freed within its
+    // buffers, passes fraction of the budget, the subtrees farthest from the viewer are replaced with conservative
+    // sparsity leaves & uploaded, one level per call. usage & budget are the device's, in bytes
+    TreeBudgetReport enforceMemoryBudget(vec3 viewer, uint64_t usage, uint64_t budget);
+    void setMemoryBudgetFraction(float fraction) { memoryBudgetFraction = std::clamp(fraction, 0.1f, 1.0f); }
+    float getMemoryBudgetFraction() const { return memoryBudgetFraction; }
+    // Nodes & leaves freed within the GPU buffers, they're reused before the buffers grow
+    uint64_t getReusableBytes() const;
+
     // Destructor to clean up workers
     ~TreeManager() {
         stopWorkers();
@@ -95,6 +196,8 @@ public:
     }
 
 private:
+    uint64_t gpuVersion = 0;
+    uint32_t gpuLightCount = 0;
     vec3 observerPos;
     vec3 rootPosition = {
         .x = 0.0,
@@ -118,8 +221,50 @@ private:
     // Voxel sizes
     std::vector<float> voxelSizesAtDepth;
 
+    // Every brush applied since the tree was built, & those not handed to the GPU yet
+    std::vector<EditBrush> edits;
+    std::deque<EditBrush> pendingEdits;
+
+    float memoryBudgetFraction = 0.85f;
+    // nodes closer to the viewer than this are never coarsened, calculateLOD keeps them at full depth anyway
+    const float coarsenMinDistance = 128.0f;
+    // the last walk of the tree found nothing to coarsen, enforceMemoryBudget doesn't walk it again until the tree
+    // changes or the viewer moves a quarter of coarsenMinDistance from where it was
+    bool coarsenWalkEmpty = false;
+    uint64_t coarsenWalkVersion = 0;
+    vec3 coarsenWalkViewer{};
+
+    // Blocks of 64 leaves freed with their voxel leaf node, reused by createLeaves
+    std::deque<uint32_t> freeLeafBlocks;
+
+    // Range of indices changed since the last upload, by allocations & coarsening
+    struct DirtySpan {
+        uint32_t begin = UINT32_MAX;
+        uint32_t end = 0;
+
+        void add(uint32_t first, uint32_t count) {
+            begin = std::min(begin, first);
+            end = std::max(end, first + count);
+        }
+        bool empty() const { return begin >= end; }
+    };
+    // guarded by nodesMutex & leavesMutex while workers run
+    DirtySpan dirtyNodes;
+    DirtySpan dirtyLeaves;
+
+    // Uploads the dirty spans of nodes & leaves, growing the buffers when they don't fit
+    void uploadChanges();
+    // Before building or loading a new tree
+    void resetAllocations() {
+        freeNodeIndices.clear();
+        freeLeafIndices.clear();
+        freeLeafBlocks.clear();
+        dirtyNodes = {};
+        dirtyLeaves = {};
+    }
+
     // Thread-safe operations
-    uint32_t createLeaf(float distance);
+    uint32_t createLeaf(float distance, MaterialType solid);
     void createLeaves(uint32_t parentIndex, int parentDepth, vec3 parentPosition);
     void subdivideNode(uint32_t parentIndex, int parentDepth, vec3 parentPosition);
     void workerThread();
@@ -135,6 +280,9 @@ private:
 
     float getVoxelSizeAtDepth(int depth);
 
+    // Leaf node containing position, like treeSDF. False if the branch isn't built
+    bool findLeafNode(vec3 position, uint32_t& nodeIndex, int& depth, vec3& nodeCenter) const;
+
     void initVoxelSizes() {
         voxelSizesAtDepth.resize(treeDepth + 1);
         for (int i = 0; i <= treeDepth; i++) {
@@ -170,17 +318,19 @@ private:
     // Thread-safe node allocation - reserves space for 64 children at once,
     // to ensure somewhat contiguous memory allocation. Reuse freed nodes if available.
     uint32_t allocateChildNodes() {
+        std::unique_lock<std::shared_mutex> lock(nodesMutex);
 	    if (!freeNodeIndices.empty()) {
 	        uint32_t index = std::move(freeNodeIndices.front());
 	        freeNodeIndices.pop_front();
+	        dirtyNodes.add(index, 64);
 	        return index;
 	    }
 
-        std::unique_lock<std::shared_mutex> lock(nodesMutex);
         uint32_t childPointer = nodes.size();
 
         // Reserve space for all 64 children
         nodes.resize(nodes.size() + 64);
+        dirtyNodes.add(childPointer, 64);
 
         return childPointer;
     }
@@ -191,10 +341,16 @@ private:
 
         uint32_t childPointer = nodes[index].childPointer;
 
-        if (childPointer & LEAF_NODE_FLAG) {
-            // Free the leaf
-            uint32_t leafIndex = childPointer & ~LEAF_NODE_FLAG;
-            freeLeaf(leafIndex);
+        if (nodes[index].flags & LOD_NODE_FLAG) {
+            // voxel leaf nodes point at 64 leaves, any of them can be a torch
+            for (uint32_t i = 0; i < 64; i++) {
+                lights.remove(childPointer + i);
+                leaves[childPointer + i] = TreeLeaf{};
+            }
+            freeLeafBlocks.push_back(childPointer);
+        } else if (nodes[index].flags & LEAF_NODE_FLAG) {
+            // sparsity leaf
+            freeLeaf(childPointer);
         } else if (childPointer != 0) {
             // Recursively free all 64 children
             for (uint32_t i = 0; i < 64; i++) {
@@ -223,6 +379,7 @@ private:
     }
 
     void freeLeaf(uint32_t index) {
+        lights.remove(index);
         leaves[index] = TreeLeaf{};
         freeLeafIndices.push_back(index);
     }
@@ -0,0 +1,112 @@
+#include "tree.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Baked tree file layout, all little endian:
+//   char[8]  magic "AMTREE01"
+//   int32    treeDepth
+//   float    baseVoxelSize
+//   uint64   node count, followed by the TreeNode array
+//   uint64   leaf count, followed by the TreeLeaf array
+static const char bakeMagic[8] = { 'A', 'M', 'T', 'R', 'E', 'E', '0', '1' };
+
+void TreeManager::saveToFile(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file for writing: " + path);
+    }
+
+    int32_t depth = treeDepth;
+    float voxelSize = baseVoxelSize;
+    uint64_t nodeCount = nodes.size();
+    uint64_t leafCount = leaves.size();
+
+    file.write(bakeMagic, sizeof(bakeMagic));
+    file.write(reinterpret_cast<const char*>(&depth), sizeof(depth));
+    file.write(reinterpret_cast<const char*>(&voxelSize), sizeof(voxelSize));
+    file.write(reinterpret_cast<const char*>(&nodeCount), sizeof(nodeCount));
+    file.write(reinterpret_cast<const char*>(nodes.data()), nodeCount * sizeof(TreeNode));
+    file.write(reinterpret_cast<const char*>(&leafCount), sizeof(leafCount));
+    file.write(reinterpret_cast<const char*>(leaves.data()), leafCount * sizeof(TreeLeaf));
+
+    if (!file) {
+        throw std::runtime_error("Failed to write baked tree: " + path);
+    }
+}
+
+void TreeManager::loadFromFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    // the counts are checked against what's left of the file before anything is allocated
+    uint64_t remaining = uint64_t(file.tellg());
+    file.seekg(0);
+
+    auto read = [&](void* data, uint64_t size, const char* what) {
+        if (size > remaining) {
+            throw std::runtime_error(std::string("Baked tree file is truncated, ") + what + " needs " +
+                std::to_string(size) + " bytes but " + std::to_string(remaining) + " are left: " + path);
+        }
+        file.read(static_cast<char*>(data), std::streamsize(size));
+        if (!file) {
+            throw std::runtime_error(std::string("Failed to read ") + what + " of baked tree: " + path);
+        }
+        remaining -= size;
+    };
+
+    char magic[sizeof(bakeMagic)];
+    int32_t depth = 0;
+    float voxelSize = 0.0f;
+    if (remaining < sizeof(magic)) {
+        throw std::runtime_error("Not a baked tree file: " + path);
+    }
+    read(magic, sizeof(magic), "the magic");
+    if (std::memcmp(magic, bakeMagic, sizeof(bakeMagic)) != 0) {
+        throw std::runtime_error("Not a baked tree file: " + path);
+    }
+    read(&depth, sizeof(depth), "the tree depth");
+    read(&voxelSize, sizeof(voxelSize), "the voxel size");
+    if (depth != treeDepth || voxelSize != baseVoxelSize) {
+        throw std::runtime_error("Baked tree was built with a different tree depth or voxel size: " + path);
+    }
+
+    uint64_t nodeCount = 0;
+    read(&nodeCount, sizeof(nodeCount), "the node count");
+    // at least the root, & no more than the rest of the file holds
+    if (nodeCount == 0 || nodeCount > remaining / sizeof(TreeNode)) {
+        throw std::runtime_error("Baked tree file has an invalid node count of " + std::to_string(nodeCount) +
+            " for " + std::to_string(remaining) + " bytes left: " + path);
+    }
+    std::vector<TreeNode> loadedNodes(nodeCount);
+    read(loadedNodes.data(), nodeCount * sizeof(TreeNode), "the nodes");
+
+    uint64_t leafCount = 0;
+    read(&leafCount, sizeof(leafCount), "the leaf count");
+    if (leafCount != remaining / sizeof(TreeLeaf) || remaining % sizeof(TreeLeaf) != 0) {
+        throw std::runtime_error("Baked tree file has " + std::to_string(leafCount) + " leaves but " +
+            std::to_string(remaining) + " bytes left for them: " + path);
+    }
+    std::vector<TreeLeaf> loadedLeaves(leafCount);
+    read(loadedLeaves.data(), leafCount * sizeof(TreeLeaf), "the leaves");
+
+    // only replaced once the whole file was read, a bad file leaves the current tree as it was
+    nodes = std::move(loadedNodes);
+    leaves = std::move(loadedLeaves);
+
+    resetAllocations();
+    // baked files don't store lights, torches only light up in generated trees
+    lights.clear();
+    // nor edits, nodes rebuilt after loading only sample the terrain
+    edits.clear();
+    pendingEdits.clear();
+    initVoxelSizes();
+    observerPos = { 0.0f, 0.0f, 0.0f };
+
+    std::cout << "Loaded baked tree: " << nodes.size() << " nodes, " << leaves.size() << " leaves" << std::endl;
+}
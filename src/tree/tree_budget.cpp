@@ -0,0 +1,122 @@
+#include "tree.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Subtree enforceMemoryBudget can replace with one sparsity leaf
+struct CoarsenCandidate {
+    uint32_t nodeIndex;
+    int depth;
+    vec3 center;
+    float distance;
+};
+
+uint64_t TreeManager::getReusableBytes() const {
+    uint64_t freeLeaves = uint64_t(freeLeafBlocks.size()) * 64 + freeLeafIndices.size();
+    return uint64_t(freeNodeIndices.size()) * 64 * sizeof(TreeNode) + freeLeaves * sizeof(TreeLeaf);
+}
+
+TreeBudgetReport TreeManager::enforceMemoryBudget(vec3 viewer, uint64_t usage, uint64_t budget) {
+    TreeBudgetReport report;
+    report.reusableBytes = getReusableBytes();
+
+    // the buffers never shrink, what they freed is reused before they grow again
+    uint64_t limit = uint64_t(double(budget) * memoryBudgetFraction);
+    uint64_t pending = usage > report.reusableBytes ? usage - report.reusableBytes : 0;
+    if (nodes.empty() || budget == 0 || pending <= limit) {
+        return report;
+    }
+    uint64_t excess = pending - limit;
+
+    // over budget with nothing far enough away to coarsen, don't walk the whole tree again every frame
+    if (coarsenWalkEmpty && coarsenWalkVersion == gpuVersion &&
+        length(sub(viewer, coarsenWalkViewer)) < coarsenMinDistance * 0.25f) {
+        return report;
+    }
+
+    // the lowest subtrees, voxel leaf nodes & nodes with nothing but sparsity leaves as children. Their parents
+    // become candidates once they're coarsened, so detail is taken away one level per call
+    std::vector<CoarsenCandidate> candidates;
+    std::vector<nodeToProcess> stack = { { 0, 0, rootPosition } };
+    while (!stack.empty()) {
+        nodeToProcess current = stack.back();
+        stack.pop_back();
+        const TreeNode& node = nodes[current.parentNodeIndex];
+        if ((node.flags & LEAF_NODE_FLAG) && !(node.flags & LOD_NODE_FLAG)) {
+            continue;
+        }
+
+        float halfDiagonal = voxelSizesAtDepth[current.depth] * 0.866025404f;
+        float distance = length(sub(current.parentPosition, viewer)) - halfDiagonal;
+        bool coarsenable = current.depth > 0 && distance >= coarsenMinDistance;
+        if (node.flags & LOD_NODE_FLAG) {
+            if (coarsenable) {
+                candidates.push_back({ current.parentNodeIndex, current.depth, current.parentPosition, distance });
+            }
+            continue;
+        }
+        if (node.childPointer == 0) {
+            continue;
+        }
+
+        bool sparseChildren = true;
+        float childSize = voxelSizesAtDepth[current.depth + 1];
+        for (uint32_t i = 0; i < 64; i++) {
+            const TreeNode& child = nodes[node.childPointer + i];
+            if (!(child.flags & LEAF_NODE_FLAG) || (child.flags & LOD_NODE_FLAG)) {
+                sparseChildren = false;
+                stack.push_back({ node.childPointer + i, current.depth + 1,
+                    getChunkPosition(i, childSize, current.parentPosition) });
+            }
+        }
+        if (sparseChildren && coarsenable) {
+            candidates.push_back({ current.parentNodeIndex, current.depth, current.parentPosition, distance });
+        }
+    }
+
+    coarsenWalkEmpty = candidates.empty();
+    coarsenWalkVersion = gpuVersion;
+    coarsenWalkViewer = viewer;
+
+    std::sort(candidates.begin(), candidates.end(), [](const CoarsenCandidate& a, const CoarsenCandidate& b) {
+        return a.distance > b.distance;
+    });
+
+    uint64_t freed = 0;
+    for (const CoarsenCandidate& candidate : candidates) {
+        if (freed >= excess) {
+            break;
+        }
+
+        // the same conservative bound createLeaves gives a voxel the size of the node. Where the surface passes
+        // through the node that's clamped to +-minStep voxels, so the subtree turns into an empty or a solid block
+        float nodeSize = voxelSizesAtDepth[candidate.depth];
+        MaterialType solid = MaterialType::Grass;
+        float distance = getLipschitzBound(sampleEditedDistance(candidate.center, solid), nodeSize);
+        if (std::abs(distance) < nodeSize * minStep) {
+            distance = (distance >= 0 ? 1.0f : -1.0f) * nodeSize * minStep;
+        }
+
+        if (nodes[candidate.nodeIndex].flags & LOD_NODE_FLAG) {
+            report.evictedLeaves += 64;
+        } else {
+            report.evictedNodes += 64;
+            report.evictedLeaves += 64;
+        }
+
+        freeNode(candidate.nodeIndex, false);
+        uint32_t leafPointer = createLeaf(distance, solid);
+        nodes[candidate.nodeIndex].childPointer = leafPointer;
+        nodes[candidate.nodeIndex].flags = LEAF_NODE_FLAG;
+        dirtyNodes.add(candidate.nodeIndex, 1);
+        report.coarsened++;
+
+        freed = report.evictedNodes * sizeof(TreeNode) + (report.evictedLeaves - report.coarsened) * sizeof(TreeLeaf);
+    }
+
+    if (report.coarsened > 0) {
+        uploadChanges();
+    }
+    report.reusableBytes = getReusableBytes();
+    return report;
+}
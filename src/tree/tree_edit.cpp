@@ -0,0 +1,276 @@
+#include "tree.hpp"
+#include "buffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_set>
+
+float editReach(const EditBrush& brush) {
+    // filling lowers the distances around the brush too, those within a radius of its surface are updated
+    float reach = brush.operation == EDIT_FILL ? brush.radius * 2.0f : brush.radius;
+    return reach + baseVoxelSize;
+}
+
+uint32_t editGroupCount(const EditBrush& brush) {
+    // floor() of both ends of the reach can add a cell on each side
+    uint32_t cells = static_cast<uint32_t>(2.0f * editReach(brush) / baseVoxelSize) + 2;
+    return (cells + GpuTreeEditor::groupSize - 1) / GpuTreeEditor::groupSize;
+}
+
+static vec3 brushCenter(const EditBrush& brush) {
+    return { brush.center[0], brush.center[1], brush.center[2] };
+}
+
+static float brushDistance(const EditBrush& brush, vec3 position) {
+    return length(sub(position, brushCenter(brush))) - brush.radius;
+}
+
+// Calls visit with the center of every cell of the finest voxel grid within the brush's reach, the cells
+// treeedit.slang's threads take
+template<typename Visit>
+static void forEachEditCell(const EditBrush& brush, Visit visit) {
+    float reach = editReach(brush);
+    int32_t minCell[3], maxCell[3];
+    for (int axis = 0; axis < 3; axis++) {
+        minCell[axis] = int32_t(std::floor((brush.center[axis] - reach) / baseVoxelSize));
+        maxCell[axis] = int32_t(std::floor((brush.center[axis] + reach) / baseVoxelSize));
+    }
+
+    for (int32_t z = minCell[2]; z <= maxCell[2]; z++) {
+        for (int32_t y = minCell[1]; y <= maxCell[1]; y++) {
+            for (int32_t x = minCell[0]; x <= maxCell[0]; x++) {
+                vec3 position = { (x + 0.5f) * baseVoxelSize, (y + 0.5f) * baseVoxelSize, (z + 0.5f) * baseVoxelSize };
+                visit(position);
+            }
+        }
+    }
+}
+
+// Child of a node containing relativePos, same as getIndex in tree.slang
+static uint32_t childIndexAt(float childSize, vec3 relativePos) {
+    float invNodeSize = 1.0f / childSize;
+    auto axis = [invNodeSize](float relative) {
+        return uint32_t(std::clamp(std::floor(relative * invNodeSize + 2.0f), 0.0f, 3.0f));
+    };
+    return (axis(relativePos.z) << 4) + (axis(relativePos.y) << 2) + axis(relativePos.x);
+}
+
+// Brush combined with a voxel leaf's distance bound, same as editVoxel in treeedit.slang
+static TreeLeaf editVoxel(TreeLeaf leaf, const EditBrush& brush, vec3 voxelCenter, float voxelSize) {
+    float bound = getLipschitzBound(brushDistance(brush, voxelCenter), voxelSize);
+
+    float distance;
+    if (brush.operation == EDIT_CARVE) {
+        distance = std::max(leaf.distance, -bound);
+        if (distance >= 0) {
+            leaf.material = MaterialType::Void;
+        }
+    } else {
+        distance = std::min(leaf.distance, bound);
+        if (bound < leaf.distance && distance < 0) {
+            leaf.material = static_cast<MaterialType>(brush.material);
+        }
+    }
+
+    // same as createLeaves
+    if (std::abs(distance) < voxelSize * minStep) {
+        distance = (distance >= 0 ? 1.0f : -1.0f) * voxelSize * minStep;
+    }
+    leaf.distance = distance;
+    return leaf;
+}
+
+bool TreeManager::findLeafNode(vec3 position, uint32_t& nodeIndex, int& depth, vec3& nodeCenter) const {
+    nodeIndex = 0;
+    depth = 0;
+    nodeCenter = rootPosition;
+    while (!(nodes[nodeIndex].flags & LEAF_NODE_FLAG)) {
+        uint32_t childPointer = nodes[nodeIndex].childPointer;
+        if (depth == treeDepth || childPointer == 0) {
+            return false;
+        }
+        depth++;
+        uint32_t child = childIndexAt(voxelSizesAtDepth[depth], sub(position, nodeCenter));
+        nodeCenter = getChunkPosition(child, voxelSizesAtDepth[depth], nodeCenter);
+        nodeIndex = childPointer + child;
+    }
+    return true;
+}
+
+float TreeManager::sampleEditedDistance(vec3 position, MaterialType& material) const {
+    float distance = sampleDistanceAt(position);
+    material = MaterialType::Grass;
+    for (const EditBrush& brush : edits) {
+        float edit = brushDistance(brush, position);
+        if (brush.operation == EDIT_CARVE) {
+            distance = std::max(distance, -edit);
+        } else if (edit < distance) {
+            distance = edit;
+            material = static_cast<MaterialType>(brush.material);
+        }
+    }
+    return distance;
+}
+
+void TreeManager::applyEdit(EditBrush brush) {
+    brush.radius = std::clamp(brush.radius, baseVoxelSize, MAX_EDIT_RADIUS);
+    if (nodes.empty()) {
+        return;
+    }
+    edits.push_back(brush);
+    pendingEdits.push_back(brush);
+
+    // the leaves treeedit.slang changes in place, sparsity leaves that need children are left to
+    // rebuildEditedNodes, the GPU queues them
+    forEachEditCell(brush, [&](vec3 position) {
+        uint32_t nodeIndex;
+        int depth;
+        vec3 nodeCenter;
+        if (!findLeafNode(position, nodeIndex, depth, nodeCenter)) {
+            return;
+        }
+        TreeNode node = nodes[nodeIndex];
+
+        if (node.flags & LOD_NODE_FLAG) {
+            float childSize = voxelSizesAtDepth[depth + 1];
+            uint32_t child = childIndexAt(childSize, sub(position, nodeCenter));
+            uint32_t leafIndex = node.childPointer + child;
+            TreeLeaf& leaf = leaves[leafIndex];
+            MaterialType before = leaf.material;
+            leaf = editVoxel(leaf, brush, getChunkPosition(child, childSize, nodeCenter), childSize);
+            if (before == MaterialType::Torch && leaf.material != MaterialType::Torch) {
+                lights.remove(leafIndex);
+            }
+            return;
+        }
+
+        // sparsity leaf, undo the bound to get back the distance at its center
+        TreeLeaf& leaf = leaves[node.childPointer];
+        float nodeSize = voxelSizesAtDepth[depth];
+        float halfDiagonal = nodeSize * 0.866025404f;
+        float distance = (leaf.distance >= 0 ? 1.0f : -1.0f) * (std::abs(leaf.distance) + halfDiagonal);
+        float brushCenterDistance = brushDistance(brush, nodeCenter);
+        float edited = brush.operation == EDIT_CARVE
+            ? std::max(distance, -brushCenterDistance)
+            : std::min(distance, brushCenterDistance);
+
+        // same test as subdivideNode, it stays sparse
+        if (std::abs(edited) > halfDiagonal * 1.01f && edited != distance) {
+            leaf.distance = getLipschitzBound(edited, nodeSize);
+            leaf.material = edited >= 0 ? MaterialType::Void
+                : brush.operation == EDIT_FILL ? static_cast<MaterialType>(brush.material)
+                : leaf.material;
+        }
+    });
+}
+
+std::vector<EditBrush> TreeManager::takePendingEdits(uint32_t maxCount) {
+    std::vector<EditBrush> brushes;
+    while (!pendingEdits.empty() && brushes.size() < maxCount) {
+        brushes.push_back(pendingEdits.front());
+        pendingEdits.pop_front();
+    }
+    if (!brushes.empty()) {
+        // carved torches went dark
+        gpuLightCount = lights.upload(lightBuffer);
+        // the frame recording them changes the GPU tree
+        gpuVersion++;
+    }
+    return brushes;
+}
+
+void TreeManager::findEditRequests(const std::vector<EditBrush>& brushes, std::vector<EditRequest>& requests) {
+    std::unordered_set<uint32_t> found;
+    for (const EditBrush& brush : brushes) {
+        forEachEditCell(brush, [&](vec3 position) {
+            uint32_t nodeIndex;
+            int depth;
+            vec3 nodeCenter;
+            if (!findLeafNode(position, nodeIndex, depth, nodeCenter) || (nodes[nodeIndex].flags & LOD_NODE_FLAG) ||
+                found.count(nodeIndex)) {
+                return;
+            }
+
+            // what subdivideNode will decide with the edits
+            MaterialType solid;
+            float halfDiagonal = voxelSizesAtDepth[depth] * 0.866025404f;
+            if (std::abs(sampleEditedDistance(nodeCenter, solid)) <= halfDiagonal * 1.01f) {
+                found.insert(nodeIndex);
+                requests.push_back({
+                    .position = { nodeCenter.x, nodeCenter.y, nodeCenter.z },
+                    .nodeIndex = nodeIndex,
+                    .depth = uint32_t(depth),
+                    .padding = {},
+                });
+            }
+        });
+    }
+}
+
+void TreeManager::uploadChanges() {
+    if (!nodeBuffer.reserve(nodes.size())) {
+        throw std::runtime_error("failed to grow the tree node buffer to " + std::to_string(nodes.size()) + " nodes!");
+    }
+    if (!leafBuffer.reserve(leaves.size())) {
+        throw std::runtime_error("failed to grow the tree leaf buffer to " + std::to_string(leaves.size()) + " leaves!");
+    }
+
+    // the GPU copy of everything else is already up to date
+    if (!dirtyNodes.empty()) {
+        nodeBuffer.updateRange(dirtyNodes.begin, dirtyNodes.end - dirtyNodes.begin, nodes.data() + dirtyNodes.begin);
+    }
+    if (!dirtyLeaves.empty()) {
+        leafBuffer.updateRange(dirtyLeaves.begin, dirtyLeaves.end - dirtyLeaves.begin, leaves.data() + dirtyLeaves.begin);
+    }
+    dirtyNodes = {};
+    dirtyLeaves = {};
+    gpuLightCount = lights.upload(lightBuffer);
+    gpuVersion++;
+}
+
+bool TreeManager::rebuildEditedNodes(const std::vector<EditRequest>& requests) {
+    std::vector<nodeToProcess> rebuilt;
+    std::unordered_set<uint32_t> seen;
+    for (const EditRequest& request : requests) {
+        if (!seen.insert(request.nodeIndex).second) {
+            continue;
+        }
+
+        // an earlier rebuild or LOD update may have replaced the node since the frame was recorded
+        uint32_t nodeIndex;
+        int depth;
+        vec3 nodeCenter;
+        vec3 position = { request.position[0], request.position[1], request.position[2] };
+        if (!findLeafNode(position, nodeIndex, depth, nodeCenter) || nodeIndex != request.nodeIndex ||
+            depth != int(request.depth) || (nodes[nodeIndex].flags & LOD_NODE_FLAG)) {
+            continue;
+        }
+
+        freeLeaf(nodes[nodeIndex].childPointer);
+        nodes[nodeIndex] = TreeNode{};
+        rebuilt.push_back({ nodeIndex, depth, nodeCenter });
+        dirtyNodes.add(nodeIndex, 1);
+    }
+    if (rebuilt.empty()) {
+        return false;
+    }
+
+    size_t nodeCount = nodes.size();
+    size_t leafCount = leaves.size();
+
+    // baked trees are loaded without workers
+    if (workers.empty()) {
+        startWorkers();
+    }
+    wg.add(rebuilt.size());
+    queue.sendMany(rebuilt);
+    wg.wait();
+
+    // the rebuilt nodes & the children they got, edits only change other leaves the GPU edited too
+    uploadChanges();
+
+    std::cout << "Rebuilt " << rebuilt.size() << " edited nodes, " << nodes.size() - nodeCount << " nodes & "
+        << leaves.size() - leafCount << " leaves added" << std::endl;
+    return true;
+}
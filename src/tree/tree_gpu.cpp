@@ -0,0 +1,49 @@
+#include "tree.hpp"
+#include "treebuild.hpp"
+
+void TreeManager::buildOnGPU(VmaAllocator allocator, VkDevice device, uint32_t queueFamilyIndex, const std::string& shaderPath) {
+    initVoxelSizes();
+
+    nodes.clear();
+    leaves.clear();
+    lights.clear();
+    edits.clear();
+    pendingEdits.clear();
+    resetAllocations();
+
+    // Initialize observer at origin
+    observerPos = {0.0f, 0.0f, 0.0f};
+
+    GpuTreeBuilder builder;
+    TreeBuildResult result;
+    try {
+        builder.init(allocator, device, queueFamilyIndex, shaderPath);
+        result = builder.build(nodeBuffer, leafBuffer, observerPos);
+    } catch (...) {
+        builder.destroy();
+        throw;
+    }
+    builder.destroy();
+
+    std::cout << "GPU tree build complete: " << result.nodeCount << " nodes, " << result.leafCount << " leaves in "
+        << result.milliseconds << "ms";
+    if (result.passes > 1) {
+        std::cout << " (" << result.passes << " passes)";
+    }
+    std::cout << std::endl;
+
+    // the build found the torches, their lights are still registered on the CPU
+    float voxelSize = getVoxelSizeAtDepth(treeDepth);
+    for (const TreeBuildTorch& torch : result.torches) {
+        lights.add(torch.leafIndex, torchLight({ torch.position[0], torch.position[1], torch.position[2] }, voxelSize));
+    }
+    gpuLightCount = lights.upload(lightBuffer);
+    gpuVersion++;
+
+    // moveObserver & updateStaleLODs still rebuild stale nodes on the CPU & upload them
+    nodeBuffer.download(nodes);
+    leafBuffer.download(leaves);
+    startWorkers();
+
+    printTreeStats();
+}
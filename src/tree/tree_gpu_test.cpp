@@ -0,0 +1,317 @@
+// Validates the compute shader tree build (treebuild.slang) against the CPU build of the same terrain, the
+// edits treeedit.slang applies in place against the CPU copy of them, the coarsening under memory pressure & the
+// growth of the tree buffers.
+// Runs headless, so it works on lavapipe. Run from the directory containing shaders/treebuild.spv & treeedit.spv.
+
+#include <vulkan/vulkan_raii.hpp>
+
+#define VMA_IMPLEMENTATION
+#include "vma/vk_mem_alloc.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "tree.hpp"
+#include "treeedit.hpp"
+#include "../vulkan/context.hpp"
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+// Simple test macros
+#define TEST(name) void test_##name()
+#define RUN_TEST(name) do { \
+    std::cout << "Running " #name "... "; \
+    test_##name(); \
+    std::cout << "PASSED" << std::endl; \
+} while(0)
+
+#define ASSERT_EQ(actual, expected) do { \
+    if ((actual) != (expected)) { \
+        std::cerr << "FAILED: " << #actual << " != " << #expected \
+                  << " (got " << (actual) << ", expected " << (expected) << ")" << std::endl; \
+        std::exit(1); \
+    } \
+} while(0)
+
+#define ASSERT_LE(actual, limit) do { \
+    if (!((actual) <= (limit))) { \
+        std::cerr << "FAILED: " << #actual << " > " << #limit \
+                  << " (got " << (actual) << ", limit " << (limit) << ")" << std::endl; \
+        std::exit(1); \
+    } \
+} while(0)
+
+// The CPU reference tree is built once, it takes a while
+static TreeManager& cpuTree() {
+    static TreeManager tree;
+    static bool built = false;
+    if (!built) {
+        tree.createTestTree();
+        built = true;
+    }
+    return tree;
+}
+
+// Copies the tree with every block of children placed in the opposite order to the original, like the GPU build
+// does in its own order
+static void relayout(const std::vector<TreeNode>& nodes, const std::vector<TreeLeaf>& leaves,
+    std::vector<TreeNode>& outNodes, std::vector<TreeLeaf>& outLeaves) {
+    outNodes.assign(1, TreeNode{});
+    // leaf 0 unused, so no pointer stays the same
+    outLeaves.assign(1, TreeLeaf{});
+
+    std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };
+    while (!stack.empty()) {
+        auto [source, destination] = stack.back();
+        stack.pop_back();
+
+        TreeNode node = nodes[source];
+        if (node.flags & LEAF_NODE_FLAG) {
+            uint32_t count = (node.flags & LOD_NODE_FLAG) ? 64 : 1;
+            uint32_t pointer = uint32_t(outLeaves.size());
+            outLeaves.insert(outLeaves.end(), leaves.begin() + node.childPointer, leaves.begin() + node.childPointer + count);
+            node.childPointer = pointer;
+        } else if (node.childPointer != 0) {
+            uint32_t pointer = uint32_t(outNodes.size());
+            outNodes.resize(pointer + 64);
+            for (uint32_t i = 0; i < 64; i++) {
+                stack.push_back({ node.childPointer + i, pointer + i });
+            }
+            node.childPointer = pointer;
+        }
+        outNodes[destination] = node;
+    }
+}
+
+TEST(compareTrees_ignoresLayout) {
+    const TreeManager& tree = cpuTree();
+    std::vector<TreeNode> nodes;
+    std::vector<TreeLeaf> leaves;
+    relayout(tree.nodes, tree.leaves, nodes, leaves);
+
+    TreeDiff diff = compareTrees(tree.nodes, tree.leaves, nodes, leaves);
+    ASSERT_EQ(diff.nodes, tree.nodes.size());
+    ASSERT_EQ(diff.leaves, tree.leaves.size());
+    ASSERT_EQ(diff.structure, 0u);
+    ASSERT_EQ(diff.materials, 0u);
+    ASSERT_EQ(diff.distances, 0u);
+}
+
+TEST(compareTrees_findsDistance) {
+    const TreeManager& tree = cpuTree();
+    std::vector<TreeLeaf> leaves = tree.leaves;
+    leaves.back().distance += 1.0f;
+
+    TreeDiff diff = compareTrees(tree.nodes, tree.leaves, tree.nodes, leaves);
+    ASSERT_EQ(diff.structure, 0u);
+    ASSERT_EQ(diff.distances, 1u);
+}
+
+TEST(treeBuffer_growsInPlace) {
+    VulkanContext context;
+    context.createInstance(false, true);
+    context.init(VK_NULL_HANDLE);
+
+    {
+        TreeLeafBuffer buffer;
+        buffer.init(context.getAllocator(), *context.getDevice(), context.getGraphicsQueueIndex());
+        ASSERT_EQ(buffer.isSparse(), context.supportsSparseBinding());
+
+        std::vector<TreeLeaf> leaves(1000);
+        for (size_t i = 0; i < leaves.size(); i++) {
+            leaves[i].distance = float(i);
+        }
+        ASSERT_EQ(buffer.create(leaves), true);
+        VkBuffer handle = buffer.getBuffer();
+
+        // past the first chunk, so the sparse buffer binds more memory
+        size_t capacity = 2 * TREE_BUFFER_CHUNK_SIZE / sizeof(TreeLeaf);
+        ASSERT_EQ(buffer.reserve(capacity), true);
+        ASSERT_LE(capacity, buffer.getCapacity());
+        if (buffer.isSparse()) {
+            ASSERT_EQ(buffer.getBuffer(), handle);
+        }
+
+        // the old leaves are still there & the new range can be written
+        TreeLeaf last{ .distance = -1.0f, .material = MaterialType::Stone, .damage = 0, .flags = 0, .padding = 0 };
+        buffer.updateElement(uint32_t(capacity - 1), last);
+        std::vector<TreeLeaf> downloaded;
+        ASSERT_EQ(buffer.download(downloaded), true);
+        ASSERT_EQ(downloaded.size(), capacity);
+        ASSERT_EQ(downloaded[999].distance, 999.0f);
+        ASSERT_EQ(downloaded[capacity - 1].material == MaterialType::Stone, true);
+
+        buffer.destroy();
+    }
+    context.cleanup();
+}
+
+TEST(gpuBuild_matchesCPU) {
+    VulkanContext context;
+    context.createInstance(false, true);
+    context.init(VK_NULL_HANDLE);
+
+    {
+        TreeManager gpuTree;
+        gpuTree.initBuffers(context.getAllocator(), *context.getDevice(), context.getGraphicsQueueIndex());
+        gpuTree.buildOnGPU(context.getAllocator(), *context.getDevice(), context.getGraphicsQueueIndex(),
+            "shaders/treebuild.spv");
+
+        TreeManager& reference = cpuTree();
+        TreeDiff diff = compareTrees(reference.nodes, reference.leaves, gpuTree.nodes, gpuTree.leaves);
+        std::cout << "(" << diff.structure << " structure, " << diff.materials << " material, " << diff.distances
+            << " distance differences, max distance error " << diff.maxDistanceError << ") ";
+
+        // the GPU's transcendentals may round differently, a few nodes next to the surface can decide differently
+        ASSERT_LE(diff.structure, reference.nodes.size() / 1000);
+        ASSERT_LE(diff.materials, reference.leaves.size() / 1000);
+        ASSERT_LE(diff.distances, reference.leaves.size() / 1000);
+        ASSERT_EQ(gpuTree.lights.size() > 0, reference.lights.size() > 0);
+    }
+    context.cleanup();
+}
+
+// Highest point of the terrain above (x, z), where edits hit the surface
+static vec3 surfaceAt(float x, float z) {
+    float y = 64.0f;
+    while (sampleDistanceAt({ x, y, z }) > 0.0f) {
+        y -= 0.125f;
+    }
+    return { x, y, z };
+}
+
+TEST(gpuEdit_matchesCPU) {
+    VulkanContext context;
+    context.createInstance(false, true);
+    context.init(VK_NULL_HANDLE);
+    const vk::raii::Device& device = context.getDevice();
+
+    {
+        TreeManager tree;
+        tree.initBuffers(context.getAllocator(), *device, context.getGraphicsQueueIndex());
+        tree.buildOnGPU(context.getAllocator(), *device, context.getGraphicsQueueIndex(), "shaders/treebuild.spv");
+        std::vector<TreeLeaf> unedited = tree.leaves;
+
+        GpuTreeEditor editor;
+        editor.init(context.getAllocator(), *device, "shaders/treeedit.spv", 1);
+
+        vec3 carve = surfaceAt(0.3f, 0.7f);
+        vec3 fill = surfaceAt(9.1f, -4.6f);
+        tree.applyEdit({ .center = { carve.x, carve.y, carve.z }, .radius = 3.0f, .operation = EDIT_CARVE });
+        tree.applyEdit({ .center = { fill.x, fill.y + 1.0f, fill.z }, .radius = 2.0f, .operation = EDIT_FILL,
+            .material = uint32_t(MaterialType::Stone) });
+        std::vector<EditBrush> brushes = tree.takePendingEdits(MAX_EDITS_PER_FRAME);
+        ASSERT_EQ(brushes.size(), 2u);
+
+        vk::raii::CommandPool pool(device, vk::CommandPoolCreateInfo{ .queueFamilyIndex = context.getGraphicsQueueIndex() });
+        vk::raii::CommandBuffers commandBuffers(device, vk::CommandBufferAllocateInfo{
+            .commandPool = *pool, .level = vk::CommandBufferLevel::ePrimary, .commandBufferCount = 1 });
+        commandBuffers[0].begin({});
+        editor.record(VkCommandBuffer(*commandBuffers[0]), 0, tree.getNodeBuffer(), tree.getLeafBuffer(), brushes);
+        commandBuffers[0].end();
+        context.getGraphicsQueue().submit(vk::SubmitInfo{ .commandBufferCount = 1, .pCommandBuffers = &*commandBuffers[0] });
+        context.getGraphicsQueue().waitIdle();
+
+        // the leaves edited in place match the CPU's copy of the edits
+        std::vector<TreeLeaf> gpuLeaves;
+        tree.leafBuffer.download(gpuLeaves);
+        TreeDiff edited = compareTrees(tree.nodes, unedited, tree.nodes, gpuLeaves);
+        TreeDiff diff = compareTrees(tree.nodes, tree.leaves, tree.nodes, gpuLeaves);
+        std::cout << "(" << edited.distances << " leaves edited, " << diff.materials << " material, " << diff.distances
+            << " distance differences) ";
+        ASSERT_EQ(edited.distances > 0, true);
+        // the GPU's square roots may round differently, a few voxels right at the brush's surface can differ
+        ASSERT_LE(diff.materials, 8u);
+        ASSERT_LE(diff.distances, 8u);
+
+        // the sparsity leaves the edits need children for are the ones the CPU finds itself
+        std::vector<EditRequest> requests;
+        std::vector<EditBrush> overflowed;
+        ASSERT_EQ(editor.takeRequests(0, requests, overflowed), true);
+        std::vector<EditRequest> cpuRequests;
+        tree.findEditRequests(brushes, cpuRequests);
+        std::unordered_set<uint32_t> gpuNodes;
+        for (const EditRequest& request : requests) {
+            gpuNodes.insert(request.nodeIndex);
+        }
+        std::cout << "(" << gpuNodes.size() << " GPU & " << cpuRequests.size() << " CPU requests) ";
+        ASSERT_EQ(gpuNodes.empty(), cpuRequests.empty());
+        ASSERT_LE(gpuNodes.size(), cpuRequests.size() + 2);
+        ASSERT_LE(cpuRequests.size(), gpuNodes.size() + 2);
+
+        // rebuilding them uploads the new nodes & leaves, the GPU tree is the CPU's again
+        ASSERT_EQ(tree.rebuildEditedNodes(requests), !requests.empty());
+        std::vector<TreeNode> nodesAfter;
+        tree.nodeBuffer.download(nodesAfter);
+        tree.leafBuffer.download(gpuLeaves);
+        TreeDiff rebuilt = compareTrees(tree.nodes, tree.leaves, nodesAfter, gpuLeaves);
+        ASSERT_EQ(rebuilt.structure, 0u);
+        ASSERT_LE(rebuilt.distances, 8u);
+
+        editor.destroy();
+    }
+    context.cleanup();
+}
+
+TEST(memoryBudget_coarsensFarthest) {
+    VulkanContext context;
+    context.createInstance(false, true);
+    context.init(VK_NULL_HANDLE);
+    const vk::raii::Device& device = context.getDevice();
+
+    {
+        TreeManager tree;
+        tree.initBuffers(context.getAllocator(), *device, context.getGraphicsQueueIndex());
+        tree.buildOnGPU(context.getAllocator(), *device, context.getGraphicsQueueIndex(), "shaders/treebuild.spv");
+        TreeDiff before = compareTrees(tree.nodes, tree.leaves, tree.nodes, tree.leaves);
+
+        VulkanContext::MemoryBudget memory = context.getMemoryBudget(0);
+        ASSERT_EQ(memory.budget > 0, true);
+        vec3 viewer = { 0.0f, 0.0f, 0.0f };
+        ASSERT_EQ(tree.enforceMemoryBudget(viewer, 0, memory.budget).coarsened, 0u);
+
+        // pretend the device is 64KiB past the fraction of its budget
+        uint64_t excess = 64 * 1024;
+        uint64_t usage = uint64_t(double(memory.budget) * tree.getMemoryBudgetFraction()) + tree.getReusableBytes() + excess;
+        TreeBudgetReport report = tree.enforceMemoryBudget(viewer, usage, memory.budget);
+        std::cout << "(" << report.coarsened << " coarsened, " << report.evictedNodes << " nodes & "
+            << report.evictedLeaves << " leaves evicted) ";
+        ASSERT_EQ(report.coarsened > 0, true);
+        ASSERT_LE(excess, report.reusableBytes);
+
+        TreeDiff after = compareTrees(tree.nodes, tree.leaves, tree.nodes, tree.leaves);
+        ASSERT_EQ(after.leaves, before.leaves - report.evictedLeaves + report.coarsened);
+
+        // the freed memory is reused before the buffers grow, the same usage is under the limit now
+        ASSERT_EQ(tree.enforceMemoryBudget(viewer, usage, memory.budget).coarsened, 0u);
+
+        // the coarsened nodes & their leaves were uploaded
+        std::vector<TreeNode> gpuNodes;
+        std::vector<TreeLeaf> gpuLeaves;
+        tree.nodeBuffer.download(gpuNodes);
+        tree.leafBuffer.download(gpuLeaves);
+        TreeDiff diff = compareTrees(tree.nodes, tree.leaves, gpuNodes, gpuLeaves);
+        ASSERT_EQ(diff.structure, 0u);
+        ASSERT_EQ(diff.distances, 0u);
+        ASSERT_EQ(diff.materials, 0u);
+    }
+    context.cleanup();
+}
+
+int main() {
+    std::cout << "=== Running GPU Tree Tests ===" << std::endl;
+
+    RUN_TEST(compareTrees_ignoresLayout);
+    RUN_TEST(compareTrees_findsDistance);
+    RUN_TEST(treeBuffer_growsInPlace);
+    RUN_TEST(gpuBuild_matchesCPU);
+    RUN_TEST(gpuEdit_matchesCPU);
+    RUN_TEST(memoryBudget_coarsensFarthest);
+
+    std::cout << std::endl << "=== All Tests Passed ===" << std::endl;
+    return 0;
+}
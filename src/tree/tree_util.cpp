@@ -1,5 +1,8 @@
 #include "tree.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 
 void TreeManager::printTreeStats() {
     std::cout << "=== Tree Statistics ===" << std::endl;
@@ -164,3 +167,80 @@ void TreeManager::printLeafDistribution() {
     }
     std::cout << std::endl;
 }
+
+TreeDiff compareTrees(const std::vector<TreeNode>& nodesA, const std::vector<TreeLeaf>& leavesA,
+    const std::vector<TreeNode>& nodesB, const std::vector<TreeLeaf>& leavesB, float distanceTolerance) {
+    TreeDiff diff;
+
+    enum class Kind { Missing, Children, Sparse, Voxels };
+    auto kindOf = [](const std::vector<TreeNode>& nodes, uint32_t index) {
+        if (index >= nodes.size()) return Kind::Missing;
+        const TreeNode& node = nodes[index];
+        if (node.flags & LEAF_NODE_FLAG) {
+            return (node.flags & LOD_NODE_FLAG) ? Kind::Voxels : Kind::Sparse;
+        }
+        return node.childPointer != 0 ? Kind::Children : Kind::Missing;
+    };
+
+    auto compareLeaf = [&](uint32_t leafA, uint32_t leafB, int depth) {
+        diff.leaves++;
+        if (leafA >= leavesA.size() || leafB >= leavesB.size()) {
+            diff.structure++;
+            return;
+        }
+        const TreeLeaf& a = leavesA[leafA];
+        const TreeLeaf& b = leavesB[leafB];
+        if (a.material != b.material) {
+            diff.materials++;
+        }
+        float voxelSize = baseVoxelSize * std::pow(4.0f, float(treeDepth - depth));
+        float error = std::abs(a.distance - b.distance) / voxelSize;
+        diff.maxDistanceError = std::max(diff.maxDistanceError, error);
+        if (error > distanceTolerance) {
+            diff.distances++;
+        }
+    };
+
+    // node in A, node in B & their depth
+    struct Pair { uint32_t a, b; int depth; };
+    std::vector<Pair> stack = { { 0, 0, 0 } };
+    while (!stack.empty()) {
+        Pair pair = stack.back();
+        stack.pop_back();
+        diff.nodes++;
+
+        // a broken child pointer could loop back up the tree
+        if (pair.depth > treeDepth) {
+            diff.structure++;
+            continue;
+        }
+
+        Kind kind = kindOf(nodesA, pair.a);
+        if (kind != kindOf(nodesB, pair.b)) {
+            diff.structure++;
+            continue;
+        }
+
+        uint32_t childA = kind == Kind::Missing ? 0 : nodesA[pair.a].childPointer;
+        uint32_t childB = kind == Kind::Missing ? 0 : nodesB[pair.b].childPointer;
+        switch (kind) {
+        case Kind::Missing:
+            break;
+        case Kind::Sparse:
+            compareLeaf(childA, childB, pair.depth);
+            break;
+        case Kind::Voxels:
+            for (uint32_t i = 0; i < 64; i++) {
+                compareLeaf(childA + i, childB + i, pair.depth + 1);
+            }
+            break;
+        case Kind::Children:
+            for (uint32_t i = 0; i < 64; i++) {
+                stack.push_back({ childA + i, childB + i, pair.depth + 1 });
+            }
+            break;
+        }
+    }
+
+    return diff;
+}
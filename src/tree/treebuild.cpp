@@ -0,0 +1,281 @@
+#include "treebuild.hpp"
+#include "compute.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+// First guesses for the buffer sizes, the test tree around the origin fits
+static const uint32_t initialNodeCapacity = 1u << 20;
+static const uint32_t initialLeafCapacity = 1u << 24;
+static const uint32_t initialQueueCapacity = 1u << 19;
+// a build that still doesn't fit after this many passes is a bug, not a big tree
+static const uint32_t maxBuildPasses = 8;
+
+void GpuTreeBuilder::init(VmaAllocator allocator, VkDevice device, uint32_t queueFamilyIndex, const std::string& shaderPath) {
+    m_allocator = allocator;
+    m_device = device;
+    vkGetDeviceQueue(m_device, queueFamilyIndex, 0, &m_queue);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tree build command pool!");
+    }
+
+    m_shader = createShaderModule(m_device, shaderPath, "tree build");
+    m_setLayout = createStorageSetLayout(m_device, bindingCount, "tree build");
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(TreeBuildPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tree build pipeline layout!");
+    }
+
+    m_seedPipeline = createComputePipeline(m_device, m_shader, m_pipelineLayout, "seedTreeBuild", "tree build");
+    m_levelPipeline = createComputePipeline(m_device, m_shader, m_pipelineLayout, "buildTreeLevel", "tree build");
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = bindingCount;
+
+    VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.maxSets = 1;
+    descriptorPoolInfo.poolSizeCount = 1;
+    descriptorPoolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(m_device, &descriptorPoolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tree build descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = m_descriptorPool;
+    setInfo.descriptorSetCount = 1;
+    setInfo.pSetLayouts = &m_setLayout;
+    if (vkAllocateDescriptorSets(m_device, &setInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate tree build descriptor set!");
+    }
+
+    createMappedBuffer(m_allocator, sizeof(TreeBuildState), m_stateBuffer, m_stateAllocation, m_stateMapped, "tree build");
+    createMappedBuffer(m_allocator, MAX_POINT_LIGHTS * sizeof(TreeBuildTorch), m_torchBuffer, m_torchAllocation, m_torchMapped,
+        "tree build");
+    createQueueBuffer(initialQueueCapacity);
+}
+
+void GpuTreeBuilder::createQueueBuffer(uint32_t capacity) {
+    destroyQueueBuffer();
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = VkDeviceSize(capacity) * 2 * sizeof(TreeBuildNode);
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+    if (vmaCreateBuffer(m_allocator, &bufferInfo, &allocInfo, &m_queueBuffer, &m_queueAllocation, nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tree build queue buffer!");
+    }
+    m_queueCapacity = capacity;
+}
+
+void GpuTreeBuilder::writeDescriptors(VkBuffer nodes, VkBuffer leaves) {
+    std::array<VkBuffer, bindingCount> buffers = { nodes, leaves, m_stateBuffer, m_queueBuffer, m_torchBuffer };
+    writeStorageDescriptors(m_device, m_descriptorSet, buffers.data(), bindingCount);
+}
+
+void GpuTreeBuilder::recordBuild(VkCommandBuffer commandBuffer, TreeBuildPushConstants constants) {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+
+    // the buffers are rebuilt in place
+    shaderReadBarrier(commandBuffer);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_seedPipeline);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    // the nodes of the last level are all leaves, nothing is queued at treeDepth
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_levelPipeline);
+    for (uint32_t depth = 1; depth < treeDepth; depth++) {
+        constants.depth = depth;
+        constants.inputQueue = (depth - 1) % 2;
+
+        // empty the queue this level appends to, the level before last read it
+        vkCmdFillBuffer(commandBuffer, m_stateBuffer, offsetof(TreeBuildState, queueCount) + (1 - constants.inputQueue) * sizeof(uint32_t),
+            sizeof(uint32_t), 0);
+        VkMemoryBarrier fillBarrier{};
+        fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            1, &fillBarrier, 0, nullptr, 0, nullptr);
+
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+        computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+
+    // the counters & torches are read on the host, the tree by the ray marcher
+    computeBarrier(commandBuffer, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_HOST_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+TreeBuildResult GpuTreeBuilder::build(TreeNodeBuffer& nodeBuffer, TreeLeafBuffer& leafBuffer, vec3 observer) {
+    uint32_t nodeCapacity = std::max<uint32_t>(static_cast<uint32_t>(nodeBuffer.getCapacity()), initialNodeCapacity);
+    uint32_t leafCapacity = std::max<uint32_t>(static_cast<uint32_t>(leafBuffer.getCapacity()), initialLeafCapacity);
+
+    TreeBuildResult result;
+    TreeBuildState state{};
+    while (true) {
+        if (++result.passes > maxBuildPasses) {
+            throw std::runtime_error("GPU tree build still didn't fit its buffers after " + std::to_string(maxBuildPasses) + " passes");
+        }
+
+        if (nodeBuffer.getCapacity() != nodeCapacity && !nodeBuffer.allocate(nodeCapacity)) {
+            throw std::runtime_error("failed to allocate " + std::to_string(nodeCapacity) + " tree nodes!");
+        }
+        if (leafBuffer.getCapacity() != leafCapacity && !leafBuffer.allocate(leafCapacity)) {
+            throw std::runtime_error("failed to allocate " + std::to_string(leafCapacity) + " tree leaves!");
+        }
+        writeDescriptors(nodeBuffer.getBuffer(), leafBuffer.getBuffer());
+
+        TreeBuildPushConstants constants{
+            .observer = { observer.x, observer.y, observer.z },
+            .depth = 1,
+            .nodeCapacity = nodeCapacity,
+            .leafCapacity = leafCapacity,
+            .queueCapacity = m_queueCapacity,
+            .torchCapacity = MAX_POINT_LIGHTS,
+            .inputQueue = 0,
+            .groupCount = groupCount,
+        };
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        // failures throw, buildOnGPU's caller falls back to the CPU build
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate tree build command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        recordBuild(commandBuffer, constants);
+        VkResult recorded = vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        auto start = std::chrono::steady_clock::now();
+        VkResult submitted = recorded == VK_SUCCESS ? vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE) : recorded;
+        if (submitted == VK_SUCCESS) {
+            submitted = vkQueueWaitIdle(m_queue);
+        }
+        result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+        if (submitted != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit tree build (VkResult " + std::to_string(submitted) + ")!");
+        }
+
+        vmaInvalidateAllocation(m_allocator, m_stateAllocation, 0, VK_WHOLE_SIZE);
+        std::memcpy(&state, m_stateMapped, sizeof(state));
+
+        bool queueFits = state.queuePeak <= m_queueCapacity;
+        if (queueFits && state.nodeCount <= nodeCapacity && state.leafCount <= leafCapacity) {
+            break;
+        }
+
+        // the counts are exact when every level fit in the queue, otherwise the levels after the
+        // overflow are missing & the next pass may need more again
+        std::cout << "GPU tree build needs " << state.nodeCount << " nodes, " << state.leafCount << " leaves & "
+            << state.queuePeak << " queued nodes per level, growing the buffers" << std::endl;
+        nodeCapacity = std::max(nodeCapacity, state.nodeCount);
+        leafCapacity = std::max(leafCapacity, state.leafCount);
+        if (!queueFits) {
+            vkQueueWaitIdle(m_queue);
+            createQueueBuffer(std::max(state.queuePeak, m_queueCapacity * 2));
+        }
+    }
+
+    nodeBuffer.setCount(state.nodeCount);
+    leafBuffer.setCount(state.leafCount);
+
+    vmaInvalidateAllocation(m_allocator, m_torchAllocation, 0, VK_WHOLE_SIZE);
+    const TreeBuildTorch* torches = static_cast<const TreeBuildTorch*>(m_torchMapped);
+    result.torches.assign(torches, torches + std::min(state.torchCount, MAX_POINT_LIGHTS));
+    result.nodeCount = state.nodeCount;
+    result.leafCount = state.leafCount;
+    return result;
+}
+
+void GpuTreeBuilder::destroyQueueBuffer() {
+    if (m_queueBuffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(m_allocator, m_queueBuffer, m_queueAllocation);
+        m_queueBuffer = VK_NULL_HANDLE;
+        m_queueAllocation = VK_NULL_HANDLE;
+        m_queueCapacity = 0;
+    }
+}
+
+void GpuTreeBuilder::destroy() {
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    destroyQueueBuffer();
+    if (m_stateBuffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(m_allocator, m_stateBuffer, m_stateAllocation);
+        m_stateBuffer = VK_NULL_HANDLE;
+    }
+    if (m_torchBuffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(m_allocator, m_torchBuffer, m_torchAllocation);
+        m_torchBuffer = VK_NULL_HANDLE;
+    }
+
+    // destroying the pool frees the set
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyPipeline(m_device, m_seedPipeline, nullptr);
+    vkDestroyPipeline(m_device, m_levelPipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+    vkDestroyShaderModule(m_device, m_shader, nullptr);
+    vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_seedPipeline = VK_NULL_HANDLE;
+    m_levelPipeline = VK_NULL_HANDLE;
+    m_pipelineLayout = VK_NULL_HANDLE;
+    m_setLayout = VK_NULL_HANDLE;
+    m_shader = VK_NULL_HANDLE;
+    m_commandPool = VK_NULL_HANDLE;
+    m_device = VK_NULL_HANDLE;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vma/vk_mem_alloc.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "buffer.hpp"
+#include "tree.hpp"
+
+// Counters of a build, must match the BUILD_* indices in treebuild.slang
+struct TreeBuildState {
+    uint32_t nodeCount;
+    uint32_t leafCount;
+    uint32_t torchCount;
+    // most nodes queued for one level
+    uint32_t queuePeak;
+    uint32_t queueCount[2];
+};
+
+// Node queued for the next level, must match BuildNode in treebuild.slang
+struct TreeBuildNode {
+    float position[3];
+    uint32_t index;
+};
+
+// Torch leaf found by the build, must match TorchSite in treebuild.slang
+struct TreeBuildTorch {
+    float position[3];
+    uint32_t leafIndex;
+};
+
+// Must match TreeBuildConstants in treebuild.slang
+struct TreeBuildPushConstants {
+    float observer[3];
+    uint32_t depth;
+    uint32_t nodeCapacity;
+    uint32_t leafCapacity;
+    uint32_t queueCapacity;
+    uint32_t torchCapacity;
+    uint32_t inputQueue;
+    uint32_t groupCount;
+};
+
+struct TreeBuildResult {
+    uint32_t nodeCount = 0;
+    uint32_t leafCount = 0;
+    // centers of the torch voxels, for their point lights
+    std::vector<TreeBuildTorch> torches;
+    // builds it took until everything fit in the buffers
+    uint32_t passes = 0;
+    // submit to fence of the last pass
+    double milliseconds = 0.0;
+};
+
+// Builds the test terrain's 64tree with the compute shaders of treebuild.slang, straight into the node &
+// leaf buffers the ray marcher reads, instead of building it on the CPU & uploading it. The tree is the
+// same as TreeManager::createTestTree's, only the order of the nodes & leaves in the buffers differs.
+class GpuTreeBuilder {
+public:
+    // Workgroups per level, they stride over the level's nodes
+    static constexpr uint32_t groupCount = 4096;
+    // nodes, leaves, state, queues & torches
+    static constexpr uint32_t bindingCount = 5;
+
+    void init(VmaAllocator allocator, VkDevice device, uint32_t queueFamilyIndex, const std::string& shaderPath);
+
+    // Builds the tree around the observer, growing the buffers & building again until it fits.
+    // The buffers' counts are set to the built nodes & leaves
+    TreeBuildResult build(TreeNodeBuffer& nodeBuffer, TreeLeafBuffer& leafBuffer, vec3 observer);
+
+    void destroy();
+
+private:
+    VmaAllocator m_allocator = nullptr;
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    VkCommandPool m_commandPool = VK_NULL_HANDLE;
+
+    VkShaderModule m_shader = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_seedPipeline = VK_NULL_HANDLE;
+    VkPipeline m_levelPipeline = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    // host visible, read back after every pass
+    VkBuffer m_stateBuffer = VK_NULL_HANDLE;
+    VmaAllocation m_stateAllocation = VK_NULL_HANDLE;
+    void* m_stateMapped = nullptr;
+    VkBuffer m_torchBuffer = VK_NULL_HANDLE;
+    VmaAllocation m_torchAllocation = VK_NULL_HANDLE;
+    void* m_torchMapped = nullptr;
+    // both level queues, grown when a level didn't fit
+    VkBuffer m_queueBuffer = VK_NULL_HANDLE;
+    VmaAllocation m_queueAllocation = VK_NULL_HANDLE;
+    uint32_t m_queueCapacity = 0;
+
+    void createQueueBuffer(uint32_t capacity);
+    void writeDescriptors(VkBuffer nodes, VkBuffer leaves);
+    void recordBuild(VkCommandBuffer commandBuffer, TreeBuildPushConstants constants);
+    void destroyQueueBuffer();
+};
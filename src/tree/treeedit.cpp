@@ -0,0 +1,173 @@
+#include "treeedit.hpp"
+#include "compute.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+void GpuTreeEditor::init(VmaAllocator allocator, VkDevice device, const std::string& shaderPath, uint32_t framesInFlight) {
+    m_allocator = allocator;
+    m_device = device;
+
+    m_shader = createShaderModule(m_device, shaderPath, "tree edit");
+    m_setLayout = createStorageSetLayout(m_device, bindingCount, "tree edit");
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(TreeEditPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tree edit pipeline layout!");
+    }
+
+    m_pipeline = createComputePipeline(m_device, m_shader, m_pipelineLayout, "applyEdit", "tree edit");
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = bindingCount * framesInFlight;
+
+    VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.maxSets = framesInFlight;
+    descriptorPoolInfo.poolSizeCount = 1;
+    descriptorPoolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(m_device, &descriptorPoolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tree edit descriptor pool!");
+    }
+
+    // every frame in flight has its own brushes & readback, the CPU reads them after the frame's fence
+    m_frames.resize(framesInFlight);
+    for (FrameEdits& frame : m_frames) {
+        VkDescriptorSetAllocateInfo setInfo{};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = m_descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &m_setLayout;
+        if (vkAllocateDescriptorSets(m_device, &setInfo, &frame.descriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate tree edit descriptor set!");
+        }
+
+        createMappedBuffer(m_allocator, MAX_EDITS_PER_FRAME * sizeof(EditBrush), frame.brushBuffer, frame.brushAllocation,
+            frame.brushMapped, "tree edit brush");
+        createMappedBuffer(m_allocator, sizeof(uint32_t), frame.countBuffer, frame.countAllocation, frame.countMapped,
+            "tree edit request count");
+        createMappedBuffer(m_allocator, MAX_EDIT_REQUESTS * sizeof(EditRequest), frame.requestBuffer,
+            frame.requestAllocation, frame.requestMapped, "tree edit request");
+    }
+}
+
+void GpuTreeEditor::record(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkBuffer nodes, VkBuffer leaves,
+    const std::vector<EditBrush>& brushes) {
+    FrameEdits& frame = m_frames[frameIndex];
+    uint32_t brushCount = std::min(static_cast<uint32_t>(brushes.size()), MAX_EDITS_PER_FRAME);
+    frame.brushes.assign(brushes.begin(), brushes.begin() + brushCount);
+    if (brushCount == 0) {
+        return;
+    }
+
+    // the frame's fence signaled, the GPU is done with its previous brushes & requests
+    std::memcpy(frame.brushMapped, brushes.data(), brushCount * sizeof(EditBrush));
+    vmaFlushAllocation(m_allocator, frame.brushAllocation, 0, VK_WHOLE_SIZE);
+    *static_cast<uint32_t*>(frame.countMapped) = 0;
+    vmaFlushAllocation(m_allocator, frame.countAllocation, 0, VK_WHOLE_SIZE);
+
+    if (frame.nodes != nodes || frame.leaves != leaves) {
+        std::array<VkBuffer, bindingCount> buffers = { nodes, leaves, frame.brushBuffer, frame.countBuffer,
+            frame.requestBuffer };
+        writeStorageDescriptors(m_device, frame.descriptorSet, buffers.data(), bindingCount);
+        frame.nodes = nodes;
+        frame.leaves = leaves;
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &frame.descriptorSet,
+        0, nullptr);
+
+    // the leaves are edited in place
+    shaderReadBarrier(commandBuffer);
+
+    for (uint32_t i = 0; i < brushCount; i++) {
+        TreeEditPushConstants constants{
+            .brush = i,
+            .requestCapacity = MAX_EDIT_REQUESTS,
+        };
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+        uint32_t groups = editGroupCount(frame.brushes[i]);
+        vkCmdDispatch(commandBuffer, groups, groups, groups);
+        // overlapping brushes apply in order
+        computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    // the requests are read on the host after the fence, the leaves by the ray marcher
+    computeBarrier(commandBuffer, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_HOST_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+bool GpuTreeEditor::takeRequests(uint32_t frameIndex, std::vector<EditRequest>& requests,
+    std::vector<EditBrush>& overflowed) {
+    FrameEdits& frame = m_frames[frameIndex];
+    requests.clear();
+    overflowed.clear();
+    if (frame.brushes.empty()) {
+        return true;
+    }
+
+    vmaInvalidateAllocation(m_allocator, frame.countAllocation, 0, VK_WHOLE_SIZE);
+    uint32_t count = *static_cast<const uint32_t*>(frame.countMapped);
+    uint32_t stored = std::min(count, MAX_EDIT_REQUESTS);
+    if (stored > 0) {
+        vmaInvalidateAllocation(m_allocator, frame.requestAllocation, 0, stored * sizeof(EditRequest));
+        const EditRequest* mapped = static_cast<const EditRequest*>(frame.requestMapped);
+        requests.assign(mapped, mapped + stored);
+    }
+
+    bool fits = count <= MAX_EDIT_REQUESTS;
+    if (!fits) {
+        overflowed = frame.brushes;
+    }
+    frame.brushes.clear();
+    return fits;
+}
+
+void GpuTreeEditor::destroy() {
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    for (FrameEdits& frame : m_frames) {
+        if (frame.brushBuffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(m_allocator, frame.brushBuffer, frame.brushAllocation);
+        }
+        if (frame.countBuffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(m_allocator, frame.countBuffer, frame.countAllocation);
+        }
+        if (frame.requestBuffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(m_allocator, frame.requestBuffer, frame.requestAllocation);
+        }
+    }
+    m_frames.clear();
+
+    // destroying the pool frees the sets
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+    vkDestroyShaderModule(m_device, m_shader, nullptr);
+
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_pipeline = VK_NULL_HANDLE;
+    m_pipelineLayout = VK_NULL_HANDLE;
+    m_setLayout = VK_NULL_HANDLE;
+    m_shader = VK_NULL_HANDLE;
+    m_device = VK_NULL_HANDLE;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vma/vk_mem_alloc.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Must match EDIT_* in treeedit.slang
+const uint32_t EDIT_CARVE = 0;
+const uint32_t EDIT_FILL = 1;
+
+// Brushes are clamped to it, so one edit's dispatch stays a few hundred workgroups
+const float MAX_EDIT_RADIUS = 4.0f;
+// Brushes recorded per frame, the rest wait for the next one
+const uint32_t MAX_EDITS_PER_FRAME = 16;
+// Nodes a frame's edits can queue for the CPU, past it the CPU finds them itself
+const uint32_t MAX_EDIT_REQUESTS = 4096;
+
+// Sphere added to or removed from the tree, must match EditBrush in treeedit.slang
+struct EditBrush {
+    float center[3];
+    float radius;
+    uint32_t operation;
+    // MaterialType of filled voxels
+    uint32_t material;
+    uint32_t padding[2];
+};
+
+// Sparsity leaf an edit's surface passes through, it needs children the GPU can't allocate.
+// Must match EditRequest in treeedit.slang
+struct EditRequest {
+    float position[3];
+    uint32_t nodeIndex;
+    uint32_t depth;
+    uint32_t padding[3];
+};
+
+// Must match TreeEditConstants in treeedit.slang
+struct TreeEditPushConstants {
+    uint32_t brush;
+    uint32_t requestCapacity;
+};
+
+// Applies CSG brushes to the resident tree with the compute shader of treeedit.slang, updating the distances &
+// materials of the leaves in place instead of rebuilding them on the CPU & uploading them. Edits that need new
+// nodes are read back once the frame's fence signaled, for TreeManager::rebuildEditedNodes.
+class GpuTreeEditor {
+public:
+    // Cells of the finest voxel grid per workgroup & axis, must match applyEdit's numthreads
+    static constexpr uint32_t groupSize = 4;
+    // nodes, leaves, brushes, request count & requests
+    static constexpr uint32_t bindingCount = 5;
+
+    void init(VmaAllocator allocator, VkDevice device, const std::string& shaderPath, uint32_t framesInFlight);
+    bool isReady() const { return m_pipeline != VK_NULL_HANDLE; }
+
+    // Records the brushes into the frame's command buffer, before anything reads the tree. The frame's previous
+    // requests must have been taken
+    void record(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkBuffer nodes, VkBuffer leaves,
+        const std::vector<EditBrush>& brushes);
+
+    // Requests of the frame's edits, once its fence signaled. False if there were more than fit, requests then
+    // only holds those that did & the frame's brushes are returned in overflowed, for TreeManager::findEditRequests
+    bool takeRequests(uint32_t frameIndex, std::vector<EditRequest>& requests, std::vector<EditBrush>& overflowed);
+
+    void destroy();
+
+private:
+    struct FrameEdits {
+        VkBuffer brushBuffer = VK_NULL_HANDLE;
+        VmaAllocation brushAllocation = VK_NULL_HANDLE;
+        void* brushMapped = nullptr;
+        VkBuffer countBuffer = VK_NULL_HANDLE;
+        VmaAllocation countAllocation = VK_NULL_HANDLE;
+        void* countMapped = nullptr;
+        VkBuffer requestBuffer = VK_NULL_HANDLE;
+        VmaAllocation requestAllocation = VK_NULL_HANDLE;
+        void* requestMapped = nullptr;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        // tree buffers the set points at, they change when the tree's buffers grow
+        VkBuffer nodes = VK_NULL_HANDLE;
+        VkBuffer leaves = VK_NULL_HANDLE;
+        // recorded, not taken yet
+        std::vector<EditBrush> brushes;
+    };
+
+    VmaAllocator m_allocator = nullptr;
+    VkDevice m_device = VK_NULL_HANDLE;
+
+    VkShaderModule m_shader = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    std::vector<FrameEdits> m_frames;
+};
+
+// How far from the brush's center leaves change, same as editReach in treeedit.slang
+float editReach(const EditBrush& brush);
+// Workgroups of applyEdit per axis for a brush, enough for the cells of the finest voxel grid within its reach
+uint32_t editGroupCount(const EditBrush& brush);
@@ -2,7 +2,9 @@
 #include <vulkan/vulkan_raii.hpp>
 #include <vma/vk_mem_alloc.h>
 #include <glm/glm.hpp>
+#include <vector>
 
+// Must match FrameUniforms in shading.slang, laid out with std140 rules
 struct FrameUniforms {
     float time;
     float aperture;
@@ -13,42 +15,89 @@ struct FrameUniforms {
     float _pad0;  // padding
     glm::vec3 cameraDirection;
     float _pad1;  // padding
+
+    // foveated rendering, see FoveaSettings
+    glm::vec2 foveaCenter;
+    float foveaRadius;
+    float foveaFalloff;
+    uint32_t foveaLevels;
+
+    uint32_t frameNumber;
+    uint32_t checkerboard;
+    float _pad2;  // padding
+
+    glm::vec3 previousCameraPosition;
+    float _pad3;  // padding
+    glm::vec3 previousCameraDirection;
+    float _pad4;  // padding
+
+    glm::uvec2 renderSize;
+    uint32_t reprojectStart;
+    uint32_t coneStart;
+
+    // sun shadows are marched for one pixel in lightingScale x lightingScale, 1 shades every pixel
+    uint32_t lightingScale;
+    // queue the shadow rays for an indirect dispatch instead of tracing them in the trace pass
+    uint32_t wavefront;
+    // overlay the ray march steps per trace tile
+    uint32_t stepHeatmap;
+    // point lights in the tree's light buffer
+    uint32_t lightCount;
+
+    // device addresses of the tree's node & leaf buffers, TreeManager::getNodeAddress & getLeafAddress
+    VkDeviceAddress treeNodes;
+    VkDeviceAddress treeLeaves;
+};
+
+// Foveated rendering traces every pixel within radius of the center, & halves the density in x & y
+// for every ring of falloff further out, up to levels times. Distances are in image heights.
+struct FoveaSettings {
+    glm::vec2 center = { 0.5f, 0.5f };
+    float radius = 0.25f;
+    float falloff = 0.15f;
+    uint32_t levels = 0; // 0 traces every pixel
 };
 
+// One uniform buffer & descriptor set per frame in flight, so the CPU can write the next frame's
+// uniforms while the GPU is still reading the previous ones.
 class FrameDataManager {
 public:
     FrameDataManager() = default;
     ~FrameDataManager() = default;
 
     // Initialize everything
-    void create(const vk::raii::Device& device, VmaAllocator allocator);
+    void create(const vk::raii::Device& device, VmaAllocator allocator, uint32_t framesInFlight);
 
-    // Update time every frame
-    void update(FrameUniforms uniforms);
+    // Update the uniforms of a frame, only once that frame's fence has signaled
+    void update(uint32_t frameIndex, FrameUniforms uniforms);
 
     // Bind descriptor set in command buffer
     void bind(const vk::raii::CommandBuffer& commandBuffer,
-        const vk::raii::PipelineLayout& pipelineLayout);
+        const vk::raii::PipelineLayout& pipelineLayout, uint32_t frameIndex);
 
     // Get descriptor set layout for pipeline creation
     const vk::raii::DescriptorSetLayout& getDescriptorSetLayout() const {
         return m_descriptorSetLayout;
     }
 
-    vk::DescriptorSet getDescriptorSet() const {
-        return m_descriptorSet;
+    vk::DescriptorSet getDescriptorSet(uint32_t frameIndex) const {
+        return m_frames[frameIndex].descriptorSet;
     }
 
     // Cleanup
     void destroy();
 
 private:
+    struct Frame {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        void* mappedData = nullptr;
+        vk::DescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
     VmaAllocator m_allocator = VK_NULL_HANDLE;
-    VkBuffer m_buffer = VK_NULL_HANDLE;
-    VmaAllocation m_allocation = VK_NULL_HANDLE;
-    void* m_mappedData = nullptr;
+    std::vector<Frame> m_frames;
 
     vk::raii::DescriptorSetLayout m_descriptorSetLayout = nullptr;
     vk::raii::DescriptorPool m_descriptorPool = nullptr;
-    vk::DescriptorSet m_descriptorSet = VK_NULL_HANDLE;
 };
@@ -0,0 +1,135 @@
+#include "render.hpp"
+#include <cstring>
+#include <stdexcept>
+
+RenderPreset getRenderPreset(RenderQuality quality) {
+    switch (quality) {
+    case RenderQuality::Low:
+        return {
+            .specialization = { .primaryMaxSteps = 96, .shadowMaxSteps = 16, .samplesPerPixel = 1 },
+            .uniforms = { .maxDistance = 20000.0f, .epsilon = 0.0005f, .shadowMaxDistance = 250.0f, .shadowBias = 0.02f },
+        };
+    case RenderQuality::Medium:
+        return {
+            .specialization = { .primaryMaxSteps = 150, .shadowMaxSteps = 32, .samplesPerPixel = 1 },
+            .uniforms = { .maxDistance = 50000.0f, .epsilon = 0.0002f, .shadowMaxDistance = 500.0f, .shadowBias = 0.02f },
+        };
+    case RenderQuality::High:
+    default:
+        return {
+            .specialization = { .primaryMaxSteps = 200, .shadowMaxSteps = 50, .samplesPerPixel = 1 },
+            .uniforms = { .maxDistance = 100000.0f, .epsilon = 0.0001f, .shadowMaxDistance = 1000.0f, .shadowBias = 0.02f },
+        };
+    }
+}
+
+const char* getRenderQualityName(RenderQuality quality) {
+    switch (quality) {
+    case RenderQuality::Low: return "low";
+    case RenderQuality::Medium: return "medium";
+    case RenderQuality::High: return "high";
+    }
+    return "unknown";
+}
+
+void RenderDataManager::create(const vk::raii::Device& device, VmaAllocator allocator, uint32_t framesInFlight) {
+    m_allocator = allocator;
+    m_frames.resize(framesInFlight);
+
+    for (Frame& frame : m_frames) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = sizeof(RenderUniforms);
+        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+            VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        VmaAllocationInfo allocationInfo;
+        if (vmaCreateBuffer(allocator, &bufferInfo, &allocInfo,
+            &frame.buffer, &frame.allocation, &allocationInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create render uniform buffer!");
+        }
+
+        frame.mappedData = allocationInfo.pMappedData;
+
+        // start out with sane values, in case a frame is recorded before the first update
+        RenderUniforms defaults = getRenderPreset(RenderQuality::High).uniforms;
+        memcpy(frame.mappedData, &defaults, sizeof(RenderUniforms));
+    }
+
+    vk::DescriptorSetLayoutBinding uboLayoutBinding{};
+    uboLayoutBinding.binding = 0;
+    uboLayoutBinding.descriptorType = vk::DescriptorType::eUniformBuffer;
+    uboLayoutBinding.descriptorCount = 1;
+    uboLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &uboLayoutBinding;
+
+    m_descriptorSetLayout = device.createDescriptorSetLayout(layoutInfo);
+
+    vk::DescriptorPoolSize poolSize{};
+    poolSize.type = vk::DescriptorType::eUniformBuffer;
+    poolSize.descriptorCount = framesInFlight;
+
+    vk::DescriptorPoolCreateInfo poolInfo{};
+    poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = framesInFlight;
+
+    m_descriptorPool = device.createDescriptorPool(poolInfo);
+
+    for (Frame& frame : m_frames) {
+        vk::DescriptorSetAllocateInfo setAllocInfo{};
+        setAllocInfo.descriptorPool = *m_descriptorPool;
+        setAllocInfo.descriptorSetCount = 1;
+        setAllocInfo.pSetLayouts = &(*m_descriptorSetLayout);
+
+        VkDescriptorSet vkDescSet;
+        if (vkAllocateDescriptorSets(*device,
+            reinterpret_cast<const VkDescriptorSetAllocateInfo*>(&setAllocInfo),
+            &vkDescSet) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate render descriptor set");
+        }
+        frame.descriptorSet = vk::DescriptorSet(vkDescSet);
+
+        vk::DescriptorBufferInfo descriptorBufferInfo{};
+        descriptorBufferInfo.buffer = frame.buffer;
+        descriptorBufferInfo.offset = 0;
+        descriptorBufferInfo.range = sizeof(RenderUniforms);
+
+        vk::WriteDescriptorSet descriptorWrite{};
+        descriptorWrite.dstSet = frame.descriptorSet;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = vk::DescriptorType::eUniformBuffer;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &descriptorBufferInfo;
+
+        device.updateDescriptorSets(descriptorWrite, nullptr);
+    }
+}
+
+void RenderDataManager::update(uint32_t frameIndex, RenderUniforms uniforms) {
+    if (frameIndex < m_frames.size() && m_frames[frameIndex].mappedData) {
+        memcpy(m_frames[frameIndex].mappedData, &uniforms, sizeof(RenderUniforms));
+    }
+}
+
+void RenderDataManager::destroy() {
+    m_descriptorPool = nullptr;
+    m_descriptorSetLayout = nullptr;
+
+    for (Frame& frame : m_frames) {
+        if (frame.buffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(m_allocator, frame.buffer, frame.allocation);
+        }
+    }
+    m_frames.clear();
+}
@@ -1,46 +1,80 @@
 #pragma once
 #include <vulkan/vulkan_raii.hpp>
-#include <vk_mem_alloc.h>
+#include <vma/vk_mem_alloc.h>
+#include <cstdint>
+#include <vector>
 
+// Runtime ray march parameters, must match RenderUniforms in shading.slang
 struct RenderUniforms {
-    float maxSteps;
-	float maxDistance;
+    float maxDistance;
+    float epsilon;
+    float shadowMaxDistance;
+    float shadowBias;
 };
 
+// Ray march constants baked into the compute pipeline as specialization constants,
+// in constant_id order. Must match the constants in shading.slang
+struct RaymarchSpecialization {
+    uint32_t primaryMaxSteps = 200;
+    uint32_t shadowMaxSteps = 50;
+    uint32_t samplesPerPixel = 1;
+
+    std::vector<uint32_t> constants() const {
+        return { primaryMaxSteps, shadowMaxSteps, samplesPerPixel };
+    }
+
+    bool operator==(const RaymarchSpecialization&) const = default;
+};
+
+enum class RenderQuality {
+    Low,
+    Medium,
+    High,
+};
+
+struct RenderPreset {
+    RaymarchSpecialization specialization;
+    RenderUniforms uniforms;
+};
+
+RenderPreset getRenderPreset(RenderQuality quality);
+const char* getRenderQualityName(RenderQuality quality);
+
+// One uniform buffer & descriptor set per frame in flight, same as FrameDataManager
 class RenderDataManager {
 public:
     RenderDataManager() = default;
     ~RenderDataManager() = default;
 
     // Initialize everything
-    void create(const vk::raii::Device& device, VmaAllocator allocator);
-
-    // Update time every frame
-    void update(RenderUniforms uniforms);
+    void create(const vk::raii::Device& device, VmaAllocator allocator, uint32_t framesInFlight);
 
-    // Bind descriptor set in command buffer
-    void bind(const vk::raii::CommandBuffer& commandBuffer,
-        const vk::raii::PipelineLayout& pipelineLayout);
+    // Update the render settings of a frame, only once that frame's fence has signaled
+    void update(uint32_t frameIndex, RenderUniforms uniforms);
 
     // Get descriptor set layout for pipeline creation
     const vk::raii::DescriptorSetLayout& getDescriptorSetLayout() const {
         return m_descriptorSetLayout;
     }
 
-    vk::DescriptorSet getDescriptorSet() const {
-        return m_descriptorSet;
+    vk::DescriptorSet getDescriptorSet(uint32_t frameIndex) const {
+        return m_frames[frameIndex].descriptorSet;
     }
 
     // Cleanup
     void destroy();
 
 private:
+    struct Frame {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        void* mappedData = nullptr;
+        vk::DescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
     VmaAllocator m_allocator = VK_NULL_HANDLE;
-    VkBuffer m_buffer = VK_NULL_HANDLE;
-    VmaAllocation m_allocation = VK_NULL_HANDLE;
-    void* m_mappedData = nullptr;
+    std::vector<Frame> m_frames;
 
     vk::raii::DescriptorSetLayout m_descriptorSetLayout = nullptr;
     vk::raii::DescriptorPool m_descriptorPool = nullptr;
-    vk::DescriptorSet m_descriptorSet = VK_NULL_HANDLE;
 };
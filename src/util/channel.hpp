@@ -1,4 +1,8 @@
+#pragma once
+
+#include <condition_variable>
 #include <deque>
+#include <iterator>
 #include <mutex>
 #include <vector>
 #include <utility>
@@ -44,7 +48,7 @@ class Channel {
 
 		if (closed) return false;
 
-		queue.insert(queue.end(), values.begin(), values.end());
+		queue.insert(queue.end(), std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
 		readSignal.notify_all();
 		return true;
 	}
@@ -69,6 +73,7 @@ class Channel {
     }
 
     int size() {
+    	std::unique_lock<std::mutex> lock(mx);
     	return queue.size();
     }
 
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Minimal PNG writer for 8 bit RGBA images, no dependencies. The image data is stored in uncompressed
+// deflate blocks, files are about as big as the raw pixels but every viewer & image diff tool reads them.
+namespace png {
+
+inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(uint8_t(value >> 24));
+    out.push_back(uint8_t(value >> 16));
+    out.push_back(uint8_t(value >> 8));
+    out.push_back(uint8_t(value));
+}
+
+inline void appendChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data) {
+    appendBigEndian(out, uint32_t(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    // the crc covers the type & the data, not the length
+    appendBigEndian(out, crc32(out.data() + start, out.size() - start));
+}
+
+// Linear 8 bit channel to the sRGB encoded value the screen shows, the same piecewise curve as linearToSrgb
+// in present.slang & the sRGB swapchain formats
+inline uint8_t linearToSrgb(uint8_t linear) {
+    static const std::array<uint8_t, 256> table = [] {
+        std::array<uint8_t, 256> t{};
+        for (int i = 0; i < 256; i++) {
+            double c = i / 255.0;
+            double encoded = c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+            t[i] = uint8_t(encoded * 255.0 + 0.5);
+        }
+        return t;
+    }();
+    return table[linear];
+}
+
+// Encodes the color of pixelCount RGBA pixels read back from a linear UNORM image in place, alpha stays linear
+inline void encodeSrgb(uint8_t* rgba, size_t pixelCount) {
+    for (size_t i = 0; i < pixelCount; i++) {
+        for (size_t c = 0; c < 3; c++) {
+            rgba[i * 4 + c] = linearToSrgb(rgba[i * 4 + c]);
+        }
+    }
+}
+
+// rgba holds width * height pixels, rows top to bottom
+inline void write(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height) {
+    // every row starts with its filter type, 0 for none
+    std::vector<uint8_t> raw;
+    raw.reserve(size_t(width * 4 + 1) * height);
+    for (uint32_t y = 0; y < height; y++) {
+        raw.push_back(0);
+        const uint8_t* row = rgba + size_t(y) * width * 4;
+        raw.insert(raw.end(), row, row + size_t(width) * 4);
+    }
+
+    // zlib stream of stored deflate blocks, at most 65535 bytes each
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    size_t offset = 0;
+    do {
+        size_t size = std::min<size_t>(raw.size() - offset, 65535);
+        bool last = offset + size == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(uint8_t(size));
+        zlib.push_back(uint8_t(size >> 8));
+        zlib.push_back(uint8_t(~size));
+        zlib.push_back(uint8_t(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(zlib, (b << 16) | a);
+
+    std::vector<uint8_t> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    // 8 bits per channel, RGBA, deflate, no filter method extensions, not interlaced
+    header.insert(header.end(), { 8, 6, 0, 0, 0 });
+
+    std::vector<uint8_t> file = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    appendChunk(file, "IHDR", header);
+    appendChunk(file, "IDAT", zlib);
+    appendChunk(file, "IEND", {});
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open file for writing: " + path);
+    }
+    out.write(reinterpret_cast<const char*>(file.data()), file.size());
+}
+
+} // namespace png
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Sleeps on a 32 bit word until it changes, with futexes on Linux & std::atomic wait elsewhere
+namespace parking {
+
+inline void wait(std::atomic<uint32_t>& word, uint32_t expected) {
+#ifdef __linux__
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    word.wait(expected, std::memory_order_acquire);
+#endif
+}
+
+// wakes up to count of the threads waiting on word
+inline void wake(std::atomic<uint32_t>& word, uint32_t count) {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, std::min<uint32_t>(count, INT_MAX),
+        nullptr, nullptr, 0);
+#else
+    if (count == 1) {
+        word.notify_one();
+    } else {
+        word.notify_all();
+    }
+#endif
+}
+
+} // namespace parking
+
+// Bounded lock-free multi producer, multi consumer queue with the same send/receive/close semantics as Channel.
+// Every cell has a sequence number that says whose turn it is (Vyukov's bounded MPMC queue), a batch claims as
+// many ready cells as it can with one compare & swap. Threads with nothing to do spin a little, then park on a
+// futex. Senders wake as many receivers as they sent values, not all of them. Channel stays for queues that must
+// never block a sender, like the tree's build queue, whose workers send to themselves.
+template <typename T>
+class RingChannel {
+    static constexpr size_t cacheLine = 64;
+    // yields before parking, waking a parked thread costs a syscall on both sides
+    static constexpr int spinCount = 32;
+
+    struct Cell {
+        // position + 1 once a value for position was sent, position + capacity once it was received
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // Threads parked until the queue changes, every wake bumps epoch so a thread about to sleep doesn't miss it
+    struct Waiters {
+        alignas(cacheLine) std::atomic<uint32_t> epoch{0};
+        std::atomic<uint32_t> parked{0};
+
+        template <typename Ready>
+        void park(Ready ready) {
+            uint32_t seen = epoch.load(std::memory_order_acquire);
+            parked.fetch_add(1, std::memory_order_seq_cst);
+            // pairs with the fence in wake, either we see the change or the waker sees us
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ready()) {
+                parking::wait(epoch, seen);
+            }
+            parked.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void wake(uint32_t count) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint32_t sleeping = parked.load(std::memory_order_relaxed);
+            if (sleeping == 0) {
+                return;
+            }
+            epoch.fetch_add(1, std::memory_order_release);
+            parking::wake(epoch, std::min(count, sleeping));
+        }
+
+        void wakeAll() {
+            epoch.fetch_add(1, std::memory_order_release);
+            parking::wake(epoch, UINT32_MAX);
+        }
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+
+    // next position to send to & to receive from
+    alignas(cacheLine) std::atomic<size_t> tail{0};
+    alignas(cacheLine) std::atomic<size_t> head{0};
+    alignas(cacheLine) std::atomic<bool> closed{false};
+
+    Waiters readers;
+    Waiters writers;
+
+    // Claims up to max consecutive cells that are free for this lap & fills them with take(i)
+    template <typename Take>
+    size_t trySend(size_t max, Take take) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        size_t count;
+        for (;;) {
+            count = 0;
+            while (count < max && cells[(pos + count) & mask].sequence.load(std::memory_order_acquire) == pos + count) {
+                count++;
+            }
+            if (count == 0) {
+                size_t current = tail.load(std::memory_order_relaxed);
+                if (current == pos) {
+                    return 0; // full
+                }
+                pos = current;
+                continue;
+            }
+            if (tail.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            Cell& cell = cells[(pos + i) & mask];
+            cell.value = take(i);
+            cell.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        readers.wake(uint32_t(std::min<size_t>(count, UINT32_MAX)));
+        return count;
+    }
+
+    // Claims up to max consecutive cells that were sent to & hands their values to put
+    template <typename Put>
+    size_t tryReceive(size_t max, Put put) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        size_t count;
+        for (;;) {
+            count = 0;
+            while (count < max && cells[(pos + count) & mask].sequence.load(std::memory_order_acquire) == pos + count + 1) {
+                count++;
+            }
+            if (count == 0) {
+                size_t current = head.load(std::memory_order_relaxed);
+                if (current == pos) {
+                    return 0; // empty, or the sender of the next cell hasn't filled it yet
+                }
+                pos = current;
+                continue;
+            }
+            if (head.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            Cell& cell = cells[(pos + i) & mask];
+            put(std::move(cell.value));
+            cell.sequence.store(pos + i + mask + 1, std::memory_order_release);
+        }
+        writers.wake(uint32_t(std::min<size_t>(count, UINT32_MAX)));
+        return count;
+    }
+
+    // a claimed cell counts, its sender wakes the readers once it's filled
+    bool readable() const {
+        size_t h = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_acquire) != h || closed.load(std::memory_order_acquire);
+    }
+
+    bool writable() const {
+        size_t t = tail.load(std::memory_order_acquire);
+        return t < head.load(std::memory_order_acquire) + capacity() || closed.load(std::memory_order_acquire);
+    }
+
+    void backoff(Waiters& waiters, int& spins, bool reading) {
+        if (spins < spinCount) {
+            spins++;
+            std::this_thread::yield();
+            return;
+        }
+        if (reading) {
+            waiters.park([this]() { return readable(); });
+        } else {
+            waiters.park([this]() { return writable(); });
+        }
+    }
+
+public:
+    // capacity is rounded up to a power of 2
+    explicit RingChannel(size_t cap = 1024)
+        : cells(std::make_unique<Cell[]>(std::bit_ceil(std::max<size_t>(cap, 2))))
+        , mask(std::bit_ceil(std::max<size_t>(cap, 2)) - 1)
+    {
+        for (size_t i = 0; i <= mask; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingChannel(const RingChannel&) = delete;
+    RingChannel& operator=(const RingChannel&) = delete;
+
+    // send a value, waits while the queue is full, returns false if closed
+    bool send(T value) {
+        int spins = 0;
+        while (!closed.load(std::memory_order_acquire)) {
+            if (trySend(1, [&](size_t) { return std::move(value); }) > 0) {
+                return true;
+            }
+            backoff(writers, spins, false);
+        }
+        return false;
+    }
+
+    // sendMany sends the values in as few batches as there is room for, returns false if closed before all
+    // of them were sent
+    bool sendMany(const std::vector<T>& values) {
+        size_t sent = 0;
+        int spins = 0;
+        while (sent < values.size()) {
+            if (closed.load(std::memory_order_acquire)) {
+                return false;
+            }
+            size_t count = trySend(values.size() - sent, [&](size_t i) -> const T& { return values[sent + i]; });
+            if (count > 0) {
+                sent += count;
+                spins = 0;
+            } else {
+                backoff(writers, spins, false);
+            }
+        }
+        return true;
+    }
+
+    // receive the next value, waits while the queue is empty, returns false once closed & empty
+    bool receive(T& out) {
+        return receiveWith(1, [&](T&& value) { out = std::move(value); }) > 0;
+    }
+
+    // receiveMany appends up to max values to out, waits while the queue is empty, returns 0 once closed & empty
+    size_t receiveMany(std::vector<T>& out, size_t max) {
+        return receiveWith(max, [&](T&& value) { out.push_back(std::move(value)); });
+    }
+
+    // approximate while others send & receive
+    size_t size() const {
+        size_t h = head.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_acquire);
+        return t > h ? t - h : 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    // close the queue & unblock all sends & receives, values already sent can still be received
+    void close() {
+        closed.store(true, std::memory_order_release);
+        readers.wakeAll();
+        writers.wakeAll();
+    }
+
+private:
+    template <typename Put>
+    size_t receiveWith(size_t max, Put put) {
+        int spins = 0;
+        for (;;) {
+            size_t count = tryReceive(max, put);
+            if (count > 0) {
+                return count;
+            }
+            // values sent before closing are still handed out
+            if (closed.load(std::memory_order_acquire) && size() == 0) {
+                return 0;
+            }
+            backoff(readers, spins, true);
+        }
+    }
+};
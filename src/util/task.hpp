@@ -0,0 +1,406 @@
+#pragma once
+
+#include "channel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Coroutines for the per-frame CPU work: Task is a lazily started coroutine, Scheduler resumes coroutines on its
+// worker threads & runs blocking calls (fence waits, file reads) on threads of their own, TaskGraph runs stages
+// once the stages they depend on are done. Both queues are Channels, workers that resume a coroutine which
+// schedules another one send to themselves, so they must never block on a full queue.
+
+template <typename T = void>
+class Task;
+
+namespace task_detail {
+
+struct PromiseBase {
+    // resumed once the task is done, the coroutine that awaited it
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr exception;
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            return handle.promise().continuation;
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    void return_value(T result) { value = std::move(result); }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+};
+
+} // namespace task_detail
+
+// Coroutine that starts when it's awaited & resumes its awaiter when it's done, on whatever thread finished it.
+// Exceptions are rethrown in the awaiter
+template <typename T>
+class [[nodiscard]] Task {
+public:
+    using promise_type = task_detail::Promise<T>;
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return !handle || handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        if (handle.promise().exception) {
+            std::rethrow_exception(handle.promise().exception);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*handle.promise().value);
+        }
+    }
+
+private:
+    friend promise_type;
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace task_detail {
+
+template <typename T>
+Task<T> Promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+} // namespace task_detail
+
+class Scheduler;
+
+// Runs a blocking call on the scheduler's blocking threads & resumes the awaiting coroutine on a worker with
+// its result, so waiting on the GPU or the disk doesn't hold up a worker
+template <typename Call>
+class BlockingAwaitable {
+    using Result = std::invoke_result_t<Call>;
+    using Stored = std::conditional_t<std::is_void_v<Result>, std::monostate, Result>;
+
+    Scheduler& scheduler;
+    Call call;
+    std::optional<Stored> result;
+    std::exception_ptr exception;
+
+public:
+    BlockingAwaitable(Scheduler& scheduler, Call call) : scheduler(scheduler), call(std::move(call)) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> awaiting);
+
+    Result await_resume() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+        if constexpr (!std::is_void_v<Result>) {
+            return std::move(*result);
+        }
+    }
+};
+
+class Scheduler {
+    Channel<std::coroutine_handle<>> ready;
+    Channel<std::function<void()>> blockingCalls;
+    std::vector<std::thread> workers;
+    std::vector<std::thread> blockingThreads;
+
+public:
+    // 0 workers uses every core
+    explicit Scheduler(unsigned int workerCount = 0, unsigned int blockingCount = 1) {
+        if (workerCount == 0) workerCount = std::thread::hardware_concurrency();
+        if (workerCount == 0) workerCount = 4;
+
+        workers.reserve(workerCount);
+        for (unsigned int i = 0; i < workerCount; i++) {
+            workers.emplace_back([this]() {
+                std::coroutine_handle<> handle;
+                while (ready.receive(handle)) {
+                    handle.resume();
+                }
+            });
+        }
+        blockingThreads.reserve(blockingCount);
+        for (unsigned int i = 0; i < std::max(blockingCount, 1u); i++) {
+            blockingThreads.emplace_back([this]() {
+                std::function<void()> call;
+                while (blockingCalls.receive(call)) {
+                    call();
+                }
+            });
+        }
+    }
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    ~Scheduler() {
+        ready.close();
+        blockingCalls.close();
+        for (std::thread& thread : workers) {
+            thread.join();
+        }
+        for (std::thread& thread : blockingThreads) {
+            thread.join();
+        }
+    }
+
+    unsigned int workerCount() const { return workers.size(); }
+
+    // resume the coroutine on a worker
+    void post(std::coroutine_handle<> handle) { ready.send(handle); }
+
+    // run the call on a blocking thread
+    void runBlocking(std::function<void()> call) { blockingCalls.send(std::move(call)); }
+
+    // co_await scheduler.schedule() continues the coroutine on a worker
+    auto schedule() {
+        struct ScheduleAwaitable {
+            Scheduler& scheduler;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> awaiting) { scheduler.post(awaiting); }
+            void await_resume() const noexcept {}
+        };
+        return ScheduleAwaitable{ *this };
+    }
+
+    // co_await scheduler.blocking(call) runs call on a blocking thread & continues with its result on a worker
+    template <typename Call>
+    BlockingAwaitable<Call> blocking(Call call) {
+        return BlockingAwaitable<Call>(*this, std::move(call));
+    }
+};
+
+template <typename Call>
+void BlockingAwaitable<Call>::await_suspend(std::coroutine_handle<> awaiting) {
+    scheduler.runBlocking([this, awaiting]() {
+        try {
+            if constexpr (std::is_void_v<Result>) {
+                call();
+                result.emplace();
+            } else {
+                result.emplace(call());
+            }
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        scheduler.post(awaiting);
+    });
+}
+
+// co_await readFile(scheduler, path) reads the whole file on a blocking thread
+inline auto readFile(Scheduler& scheduler, std::string path) {
+    return scheduler.blocking([path = std::move(path)]() {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        std::vector<char> data(file.tellg());
+        file.seekg(0);
+        file.read(data.data(), data.size());
+        return data;
+    });
+}
+
+// co_await writeFile(scheduler, path, data) replaces the file on a blocking thread
+inline auto writeFile(Scheduler& scheduler, std::string path, std::vector<char> data) {
+    return scheduler.blocking([path = std::move(path), data = std::move(data)]() {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open() || !file.write(data.data(), data.size())) {
+            throw std::runtime_error("Failed to write file: " + path);
+        }
+    });
+}
+
+// Stages that run once the stages they depend on are done, independent stages overlap on the scheduler's
+// workers. Stages with Affinity::Main run on the thread calling run, for GLFW & anything else that has to stay
+// on the main thread. Stages are plain functions or coroutines returning Task<>, a coroutine continues on a
+// worker after awaiting something that resumes there, like a fence.
+class TaskGraph {
+public:
+    using StageId = uint32_t;
+    enum class Affinity { Worker, Main };
+
+    template <typename Body>
+    StageId add(std::string name, Body body, std::vector<StageId> dependencies = {},
+        Affinity affinity = Affinity::Worker) {
+        Stage& stage = stages.emplace_back();
+        stage.name = std::move(name);
+        stage.affinity = affinity;
+        if constexpr (std::is_same_v<std::invoke_result_t<Body&>, Task<>>) {
+            stage.body = std::move(body);
+        } else {
+            stage.body = [body = std::move(body)]() mutable { return callFunction(body); };
+        }
+
+        StageId id = stages.size() - 1;
+        stage.dependencyCount = dependencies.size();
+        for (StageId dependency : dependencies) {
+            stages[dependency].dependents.push_back(id);
+        }
+        return id;
+    }
+
+    // Runs every stage once & returns when all of them are done. Rethrows the first exception a stage threw,
+    // the stages that hadn't started by then are skipped
+    void run(Scheduler& scheduler) {
+        if (stages.empty()) {
+            return;
+        }
+        this->scheduler = &scheduler;
+        mainQueue = std::make_unique<Channel<std::coroutine_handle<>>>();
+        remaining = stages.size();
+        cancelled = false;
+        exception = nullptr;
+        for (Stage& stage : stages) {
+            stage.pending = stage.dependencyCount;
+        }
+
+        for (StageId id = 0; id < stages.size(); id++) {
+            if (stages[id].dependencyCount == 0) {
+                start(id);
+            }
+        }
+        // the last stage to finish closes the queue
+        std::coroutine_handle<> handle;
+        while (mainQueue->receive(handle)) {
+            handle.resume();
+        }
+
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    // Skips the stages that haven't started yet, e.g. once the frame turned out to have nothing to render
+    void cancel() { cancelled = true; }
+    bool isCancelled() const { return cancelled; }
+
+private:
+    struct Stage {
+        std::string name;
+        std::function<Task<>()> body;
+        Affinity affinity = Affinity::Worker;
+        std::vector<StageId> dependents;
+        uint32_t dependencyCount = 0;
+        std::atomic<uint32_t> pending{0};
+    };
+
+    // Fire & forget coroutine of a stage, destroys itself when done
+    struct StageRun {
+        struct promise_type {
+            StageRun get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    // deque, stages never move once added
+    std::deque<Stage> stages;
+    Scheduler* scheduler = nullptr;
+    std::unique_ptr<Channel<std::coroutine_handle<>>> mainQueue;
+    std::atomic<size_t> remaining{0};
+    std::atomic<bool> cancelled{false};
+    std::mutex exceptionMutex;
+    std::exception_ptr exception;
+
+    template <typename Body>
+    static Task<> callFunction(Body& body) {
+        body();
+        co_return;
+    }
+
+    static StageRun runStage(TaskGraph& graph, StageId id) {
+        if (!graph.cancelled) {
+            try {
+                co_await graph.stages[id].body();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(graph.exceptionMutex);
+                if (!graph.exception) {
+                    graph.exception = std::current_exception();
+                }
+                graph.cancelled = true;
+            }
+        }
+        graph.finish(id);
+    }
+
+    void start(StageId id) {
+        std::coroutine_handle<> handle = runStage(*this, id).handle;
+        if (stages[id].affinity == Affinity::Main) {
+            mainQueue->send(handle);
+        } else {
+            scheduler->post(handle);
+        }
+    }
+
+    void finish(StageId id) {
+        for (StageId dependent : stages[id].dependents) {
+            if (--stages[dependent].pending == 0) {
+                start(dependent);
+            }
+        }
+        if (--remaining == 0) {
+            mainQueue->close();
+        }
+    }
+};
@@ -0,0 +1,227 @@
+// Runs small TaskGraphs on a Scheduler & checks the order stages run in, cancel(), exceptions thrown by
+// worker stages & that Affinity::Main stages run on the thread calling run. Header only, no GPU needed.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "task.hpp"
+
+// Simple test macros
+#define TEST(name) void test_##name()
+#define RUN_TEST(name) do { \
+    std::cout << "Running " #name "... "; \
+    test_##name(); \
+    std::cout << "PASSED" << std::endl; \
+} while(0)
+
+#define ASSERT_EQ(actual, expected) do { \
+    if ((actual) != (expected)) { \
+        std::cerr << "FAILED: " << #actual << " != " << #expected \
+                  << " (got " << (actual) << ", expected " << (expected) << ")" << std::endl; \
+        std::exit(1); \
+    } \
+} while(0)
+
+#define ASSERT_TRUE(condition) do { \
+    if (!(condition)) { \
+        std::cerr << "FAILED: " << #condition << std::endl; \
+        std::exit(1); \
+    } \
+} while(0)
+
+// repeats the timing dependent tests, a race rarely shows up in a single run
+constexpr int RUNS = 200;
+
+// Order in which stages finished, shared by every stage of a graph
+struct Log {
+    std::mutex mutex;
+    std::vector<std::string> names;
+
+    void push(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        names.push_back(name);
+    }
+
+    int indexOf(const std::string& name) const {
+        for (size_t i = 0; i < names.size(); i++) {
+            if (names[i] == name) {
+                return int(i);
+            }
+        }
+        return -1;
+    }
+};
+
+TEST(run_dependencyOrder) {
+    Scheduler scheduler(4);
+    for (int run = 0; run < RUNS; run++) {
+        Log log;
+        TaskGraph graph;
+        // a diamond, b & c overlap, plus a chain off to the side
+        auto a = graph.add("a", [&]() { log.push("a"); });
+        auto b = graph.add("b", [&]() { log.push("b"); }, { a });
+        auto c = graph.add("c", [&]() { log.push("c"); }, { a });
+        graph.add("d", [&]() { log.push("d"); }, { b, c });
+        auto e = graph.add("e", [&]() { log.push("e"); });
+        graph.add("f", [&]() { log.push("f"); }, { e });
+
+        graph.run(scheduler);
+
+        ASSERT_EQ(log.names.size(), size_t(6));
+        ASSERT_TRUE(log.indexOf("a") < log.indexOf("b"));
+        ASSERT_TRUE(log.indexOf("a") < log.indexOf("c"));
+        ASSERT_TRUE(log.indexOf("b") < log.indexOf("d"));
+        ASSERT_TRUE(log.indexOf("c") < log.indexOf("d"));
+        ASSERT_TRUE(log.indexOf("e") < log.indexOf("f"));
+    }
+}
+
+TEST(run_coroutineStageResumesDependents) {
+    Scheduler scheduler(2);
+    Log log;
+    TaskGraph graph;
+    // finishes on a worker after the blocking call, its dependent only starts then
+    auto load = graph.add("load", [&]() -> Task<> {
+        int value = co_await scheduler.blocking([]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            return 42;
+        });
+        log.push("load " + std::to_string(value));
+    });
+    graph.add("use", [&]() { log.push("use"); }, { load });
+
+    graph.run(scheduler);
+
+    ASSERT_EQ(log.names.size(), size_t(2));
+    ASSERT_EQ(log.names[0], std::string("load 42"));
+    ASSERT_EQ(log.names[1], std::string("use"));
+}
+
+TEST(run_reusesGraph) {
+    Scheduler scheduler(2);
+    std::atomic<int> count{0};
+    TaskGraph graph;
+    auto a = graph.add("a", [&]() { count++; });
+    graph.add("b", [&]() { count++; }, { a });
+
+    for (int run = 0; run < 10; run++) {
+        graph.run(scheduler);
+    }
+    ASSERT_EQ(count.load(), 20);
+}
+
+TEST(cancel_skipsStagesNotStarted) {
+    Scheduler scheduler(4);
+    for (int run = 0; run < RUNS; run++) {
+        Log log;
+        TaskGraph graph;
+        auto check = graph.add("check", [&]() {
+            log.push("check");
+            graph.cancel();
+        });
+        auto record = graph.add("record", [&]() { log.push("record"); }, { check });
+        graph.add("submit", [&]() { log.push("submit"); }, { record }, TaskGraph::Affinity::Main);
+
+        graph.run(scheduler);
+
+        ASSERT_TRUE(graph.isCancelled());
+        ASSERT_EQ(log.names.size(), size_t(1));
+        ASSERT_EQ(log.names[0], std::string("check"));
+    }
+
+    // a cancelled run doesn't carry over into the next one
+    TaskGraph graph;
+    bool cancelNow = true;
+    std::atomic<int> count{0};
+    auto first = graph.add("first", [&]() {
+        if (cancelNow) graph.cancel();
+    });
+    graph.add("second", [&]() { count++; }, { first });
+    graph.run(scheduler);
+    ASSERT_EQ(count.load(), 0);
+    cancelNow = false;
+    graph.run(scheduler);
+    ASSERT_TRUE(!graph.isCancelled());
+    ASSERT_EQ(count.load(), 1);
+}
+
+TEST(run_rethrowsWorkerException) {
+    Scheduler scheduler(4);
+    for (int run = 0; run < RUNS; run++) {
+        std::atomic<bool> dependentRan{false};
+        TaskGraph graph;
+        auto failing = graph.add("failing", []() { throw std::runtime_error("stage failed"); });
+        graph.add("dependent", [&]() { dependentRan = true; }, { failing });
+        // independent of the failing stage, may or may not have started
+        graph.add("other", []() {});
+
+        bool caught = false;
+        try {
+            graph.run(scheduler);
+        } catch (const std::runtime_error& error) {
+            caught = std::string(error.what()) == "stage failed";
+        }
+        ASSERT_TRUE(caught);
+        ASSERT_TRUE(!dependentRan);
+    }
+}
+
+TEST(run_rethrowsExceptionAfterAwait) {
+    Scheduler scheduler(2);
+    TaskGraph graph;
+    // thrown by the blocking call, rethrown in the coroutine on a worker & from there out of run
+    graph.add("read", [&]() -> Task<> {
+        co_await readFile(scheduler, "does/not/exist.bin");
+    });
+
+    bool caught = false;
+    try {
+        graph.run(scheduler);
+    } catch (const std::runtime_error& error) {
+        caught = std::string(error.what()).starts_with("Failed to open file");
+    }
+    ASSERT_TRUE(caught);
+}
+
+TEST(affinity_mainRunsOnCallingThread) {
+    Scheduler scheduler(4);
+    std::thread::id mainThread = std::this_thread::get_id();
+    for (int run = 0; run < RUNS; run++) {
+        std::thread::id inputThread, workerThread, presentThread;
+        TaskGraph graph;
+        auto input = graph.add("input", [&]() { inputThread = std::this_thread::get_id(); },
+            {}, TaskGraph::Affinity::Main);
+        auto work = graph.add("work", [&]() { workerThread = std::this_thread::get_id(); }, { input });
+        // depends on a worker stage, so it gets sent back to the main thread from a worker
+        graph.add("present", [&]() { presentThread = std::this_thread::get_id(); },
+            { work }, TaskGraph::Affinity::Main);
+
+        graph.run(scheduler);
+
+        ASSERT_TRUE(inputThread == mainThread);
+        ASSERT_TRUE(workerThread != mainThread);
+        ASSERT_TRUE(presentThread == mainThread);
+    }
+}
+
+int main() {
+    std::cout << "=== Running Task Graph Tests ===" << std::endl;
+
+    RUN_TEST(run_dependencyOrder);
+    RUN_TEST(run_coroutineStageResumesDependents);
+    RUN_TEST(run_reusesGraph);
+    RUN_TEST(cancel_skipsStagesNotStarted);
+    RUN_TEST(run_rethrowsWorkerException);
+    RUN_TEST(run_rethrowsExceptionAfterAwait);
+    RUN_TEST(affinity_mainRunsOnCallingThread);
+
+    std::cout << std::endl << "=== All Tests Passed ===" << std::endl;
+    return 0;
+}
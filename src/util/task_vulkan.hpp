@@ -0,0 +1,30 @@
+#pragma once
+
+#include "task.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// Awaitables for GPU completion, the waits run on the scheduler's blocking threads & the coroutine continues on a
+// worker with the VkResult of the wait
+
+// co_await waitFence(scheduler, device, fence) resumes once the fence signaled
+inline auto waitFence(Scheduler& scheduler, VkDevice device, VkFence fence, uint64_t timeout = UINT64_MAX) {
+    return scheduler.blocking([device, fence, timeout]() {
+        return vkWaitForFences(device, 1, &fence, VK_TRUE, timeout);
+    });
+}
+
+// co_await waitTimeline(scheduler, device, semaphore, value) resumes once the timeline semaphore reached value
+inline auto waitTimeline(Scheduler& scheduler, VkDevice device, VkSemaphore semaphore, uint64_t value,
+    uint64_t timeout = UINT64_MAX) {
+    return scheduler.blocking([device, semaphore, value, timeout]() {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &semaphore;
+        waitInfo.pValues = &value;
+        return vkWaitSemaphores(device, &waitInfo, timeout);
+    });
+}
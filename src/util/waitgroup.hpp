@@ -1,3 +1,7 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 
 class WaitGroup {
@@ -9,6 +13,8 @@ public:
     void add(int n) { count += n; }
 
     void done() {
+        // notify under the lock, so a waiter can't miss the wakeup or return & destroy us mid-notify
+        std::lock_guard<std::mutex> lock(mx);
         if (--count == 0) {
             cv.notify_all();
         }
@@ -2,6 +2,7 @@
 #include "vulkan/vulkan.hpp"
 
 #include <iostream>
+#include <string>
 #include <GLFW/glfw3.h>
 
 VulkanContext::VulkanContext() {
@@ -42,7 +43,7 @@ void VulkanContext::cleanup() {
     }
 }
 
-void VulkanContext::createInstance(bool enableValidation) {
+void VulkanContext::createInstance(bool enableValidation, bool headless) {
     VULKAN_HPP_DEFAULT_DISPATCHER.init(context.getDispatcher()->vkGetInstanceProcAddr);
 
     vk::ApplicationInfo appInfo{
@@ -59,7 +60,10 @@ void VulkanContext::createInstance(bool enableValidation) {
     }
 
     uint32_t glfwExtensionCount = 0;
-    auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char** glfwExtensions = nullptr;
+    if (!headless) {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    }
 
     vk::InstanceCreateInfo createInfo{
         .pApplicationInfo = &appInfo,
@@ -98,14 +102,24 @@ void VulkanContext::createLogicalDevice() {
 
     presentIndex = graphicsIndex;
 
+    // optional, the swapchain falls back to a blit without it
+    storageWriteWithoutFormat = physicalDevice.getFeatures().shaderStorageImageWriteWithoutFormat;
+    // optional, the tree buffers grow by copying to a bigger buffer without it
+    sparseBinding = physicalDevice.getFeatures().sparseBinding &&
+        (queueFamilyProperties[graphicsIndex].queueFlags & vk::QueueFlagBits::eSparseBinding);
+
     vk::PhysicalDeviceFeatures deviceFeatures {
+    	.shaderStorageImageWriteWithoutFormat = storageWriteWithoutFormat ? vk::True : vk::False,
     	.shaderInt64 = vk::True,
+    	.sparseBinding = sparseBinding ? vk::True : vk::False,
     };
 
     vk::PhysicalDeviceVulkan12Features vulkan12Features{
     	.storageBuffer8BitAccess = vk::True,
         .uniformAndStorageBuffer8BitAccess = vk::True,
         .shaderInt8 = vk::True,
+        // the ray marcher reads the tree buffers through their addresses, core since 1.3
+        .bufferDeviceAddress = vk::True,
     };
 
     vk::PhysicalDeviceVulkan13Features vulkan13Features{
@@ -121,12 +135,28 @@ void VulkanContext::createLogicalDevice() {
         .pQueuePriorities = &queuePriority
     };
 
+    // nothing is presented without a surface
+    std::vector<const char*> extensions = deviceExtensions;
+    if (!surfaceHandle) {
+        std::erase_if(extensions, [](const char* name) { return std::string(name) == VK_KHR_SWAPCHAIN_EXTENSION_NAME; });
+    }
+
+    // optional, the tree coarsens against VMA's estimate without it
+    memoryBudgetSupported = false;
+    for (const vk::ExtensionProperties& extension : physicalDevice.enumerateDeviceExtensionProperties()) {
+        if (std::string(extension.extensionName.data()) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) {
+            memoryBudgetSupported = true;
+            extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            break;
+        }
+    }
+
     vk::DeviceCreateInfo deviceCreateInfo{
         .pNext = &vulkan13Features,
         .queueCreateInfoCount = 1,
         .pQueueCreateInfos = &queueCreateInfo,
-        .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
-        .ppEnabledExtensionNames = deviceExtensions.data(),
+        .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
+        .ppEnabledExtensionNames = extensions.data(),
         .pEnabledFeatures = &deviceFeatures,
     };
 
@@ -146,9 +176,32 @@ void VulkanContext::createAllocator() {
         .instance = *instance,
         .vulkanApiVersion = VK_API_VERSION_1_4
     };
+    if (memoryBudgetSupported) {
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
+    // memory of buffers with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+    allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
 
     VkResult result = vmaCreateAllocator(&allocatorInfo, &allocator);
     if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to create VMA allocator");
     }
 }
+
+VulkanContext::MemoryBudget VulkanContext::getMemoryBudget(uint32_t frameNumber) const {
+    vmaSetCurrentFrameIndex(allocator, frameNumber);
+
+    const VkPhysicalDeviceMemoryProperties* properties = nullptr;
+    vmaGetMemoryProperties(allocator, &properties);
+    std::vector<VmaBudget> budgets(properties->memoryHeapCount);
+    vmaGetHeapBudgets(allocator, budgets.data());
+
+    MemoryBudget total;
+    for (uint32_t heap = 0; heap < properties->memoryHeapCount; heap++) {
+        if (properties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            total.usage += budgets[heap].usage;
+            total.budget += budgets[heap].budget;
+        }
+    }
+    return total;
+}
@@ -14,8 +14,10 @@ public:
     VulkanContext(VulkanContext&&) = delete;
     VulkanContext& operator=(VulkanContext&&) = delete;
 
+	// VK_NULL_HANDLE creates a headless device without the swapchain extension
 	void init(VkSurfaceKHR surface);
-	void createInstance(bool enableValidation = true);
+	// headless skips the window system extensions GLFW asks for, so it runs without a display
+	void createInstance(bool enableValidation = true, bool headless = false);
 	void cleanup();
 
 	// Getters for core objects
@@ -29,6 +31,20 @@ public:
 
     uint32_t getGraphicsQueueIndex() const { return graphicsIndex; }
     uint32_t getPresentQueueIndex() const { return presentIndex; }
+    // storage images can be written without a format in the shader, needed to write to BGRA swapchain images
+    bool supportsStorageWriteWithoutFormat() const { return storageWriteWithoutFormat; }
+    // tree buffers bind memory to a reserved address range as they grow, see TreeBuffer
+    bool supportsSparseBinding() const { return sparseBinding; }
+    // VK_EXT_memory_budget is enabled, without it VMA estimates the budget from the heap sizes & its own allocations
+    bool supportsMemoryBudget() const { return memoryBudgetSupported; }
+
+    // Device local memory over all heaps, in bytes
+    struct MemoryBudget {
+        VkDeviceSize usage = 0;
+        VkDeviceSize budget = 0;
+    };
+    // frameNumber lets VMA refresh the budget it caches from the driver
+    MemoryBudget getMemoryBudget(uint32_t frameNumber) const;
 
 
     uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const;
@@ -44,6 +60,9 @@ private:
     vk::raii::Queue presentQueue = nullptr;
     uint32_t graphicsIndex = 0;
     uint32_t presentIndex = 0;
+    bool storageWriteWithoutFormat = false;
+    bool memoryBudgetSupported = false;
+    bool sparseBinding = false;
 
     VkSurfaceKHR surfaceHandle = VK_NULL_HANDLE; // non-owning handle to the surface, for queue selection
 
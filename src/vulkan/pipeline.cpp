@@ -8,7 +8,8 @@ RenderPipeline::~RenderPipeline() {
 
 void RenderPipeline::cleanup() {
     graphicsPipeline = nullptr;
-    computePipeline = nullptr;
+    computeVariants.clear();
+    computeShader = nullptr;
 }
 
 static std::vector<char> readFile(const std::string& filename) {
@@ -35,20 +36,55 @@ vk::raii::ShaderModule RenderPipeline::loadShaderModule(VulkanContext& context,
 void RenderPipeline::createComputePipeline(
 	VulkanContext& context,
 	const std::string& shaderPath,
-	vk::PipelineLayout pipelineLayout
+	vk::PipelineLayout pipelineLayout,
+	const vk::raii::PipelineCache* pipelineCache,
+	const std::vector<uint32_t>& specializationConstants
 ) {
-    vk::raii::ShaderModule shaderModule = loadShaderModule(context, shaderPath);
+    computeContext = &context;
+    computeLayout = pipelineLayout;
+    computeCache = pipelineCache;
+    computeVariants.clear();
+    computeShader = loadShaderModule(context, shaderPath);
+
+    getComputePipeline(specializationConstants);
+}
+
+const vk::raii::Pipeline& RenderPipeline::getComputePipeline(const std::vector<uint32_t>& specializationConstants, const std::string& entryPoint) {
+    auto key = std::make_pair(entryPoint, specializationConstants);
+    auto it = computeVariants.find(key);
+    if (it != computeVariants.end()) {
+        return it->second;
+    }
+
+    if (computeContext == nullptr) {
+        throw std::runtime_error("createComputePipeline has to be called before requesting compute pipeline variants");
+    }
+
+    std::vector<vk::SpecializationMapEntry> entries;
+    for (uint32_t i = 0; i < specializationConstants.size(); i++) {
+        entries.push_back({ .constantID = i, .offset = uint32_t(i * sizeof(uint32_t)), .size = sizeof(uint32_t) });
+    }
+
+    vk::SpecializationInfo specializationInfo{
+        .mapEntryCount = static_cast<uint32_t>(entries.size()),
+        .pMapEntries = entries.data(),
+        .dataSize = specializationConstants.size() * sizeof(uint32_t),
+        .pData = specializationConstants.data()
+    };
 
     vk::ComputePipelineCreateInfo pipelineInfo{
         .stage = {
             .stage = vk::ShaderStageFlagBits::eCompute,
-            .module = *shaderModule,
-            .pName = "computeMain"
+            .module = *computeShader,
+            .pName = entryPoint.c_str(),
+            .pSpecializationInfo = entries.empty() ? nullptr : &specializationInfo
         },
-        .layout = pipelineLayout
+        .layout = computeLayout
     };
 
-    computePipeline = vk::raii::Pipeline(context.getDevice(), nullptr, pipelineInfo);
+    auto [inserted, _] = computeVariants.emplace(std::move(key),
+        vk::raii::Pipeline(computeContext->getDevice(), computeCache, pipelineInfo));
+    return inserted->second;
 }
 
 
@@ -58,7 +94,8 @@ void RenderPipeline::createGraphicsPipeline(
     vk::PipelineLayout pipelineLayout,
     vk::Format colorFormat,
     vk::VertexInputBindingDescription bindingDescription,
-    std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions
+    std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions,
+    const vk::raii::PipelineCache* pipelineCache
 ) {
     vk::raii::ShaderModule shaderModule= loadShaderModule(context, shaderPath);
 
@@ -130,5 +167,5 @@ void RenderPipeline::createGraphicsPipeline(
         .layout = pipelineLayout
     };
 
-    graphicsPipeline = vk::raii::Pipeline(context.getDevice(), nullptr, pipelineInfo);
+    graphicsPipeline = vk::raii::Pipeline(context.getDevice(), pipelineCache, pipelineInfo);
 }
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "vulkan/vulkan_raii.hpp"
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "context.hpp"
 
@@ -18,23 +22,40 @@ public:
         vk::PipelineLayout pipelineLayout,
         vk::Format colorFormat,
         vk::VertexInputBindingDescription bindingDescription,
-        std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions
+        std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions,
+        const vk::raii::PipelineCache* pipelineCache = nullptr
     );
 
+    // Loads the compute shader & compiles the variant for the given specialization constants.
+    // An empty list compiles the shader's default values.
     void createComputePipeline(
         VulkanContext& context,
         const std::string& shaderPath,
-        vk::PipelineLayout pipelineLayout
+        vk::PipelineLayout pipelineLayout,
+        const vk::raii::PipelineCache* pipelineCache = nullptr,
+        const std::vector<uint32_t>& specializationConstants = {}
     );
 
     void cleanup();
 
     const vk::raii::Pipeline& getGraphicsPipeline() const { return graphicsPipeline; }
-    const vk::raii::Pipeline& getComputePipeline() const { return computePipeline; }
+
+    // Compute pipeline variant for an entry point of the compute shader & the given specialization
+    // constants (constant_id 0..n-1, 4 bytes each). All entry points share the compute pipeline layout.
+    // Variants are compiled on first use & kept, so switching back & forth between them is free.
+    const vk::raii::Pipeline& getComputePipeline(
+        const std::vector<uint32_t>& specializationConstants = {},
+        const std::string& entryPoint = "computeMain"
+    );
 
 private:
     vk::raii::ShaderModule loadShaderModule(VulkanContext& context, const std::string& filepath);
 
     vk::raii::Pipeline graphicsPipeline = nullptr;
-    vk::raii::Pipeline computePipeline = nullptr;
+
+    VulkanContext* computeContext = nullptr;
+    vk::PipelineLayout computeLayout = nullptr;
+    const vk::raii::PipelineCache* computeCache = nullptr;
+    vk::raii::ShaderModule computeShader = nullptr;
+    std::map<std::pair<std::string, std::vector<uint32_t>>, vk::raii::Pipeline> computeVariants;
 };
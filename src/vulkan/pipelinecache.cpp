@@ -0,0 +1,118 @@
+#include "pipelinecache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+static const char pipelineCacheMagic[8] = { 'A', 'M', 'P', 'S', 'O', 'C', '0', '1' };
+
+PipelineCache::FileHeader PipelineCache::makeHeader(VulkanContext& context, uint64_t dataSize) {
+	vk::PhysicalDeviceProperties properties = context.getPhysicalDevice().getProperties();
+
+	FileHeader header{};
+	std::memcpy(header.magic, pipelineCacheMagic, sizeof(header.magic));
+	header.vendorID = properties.vendorID;
+	header.deviceID = properties.deviceID;
+	header.driverVersion = properties.driverVersion;
+	std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+	header.dataSize = dataSize;
+	return header;
+}
+
+void PipelineCache::load(VulkanContext& context, const std::string& cachePath) {
+	path = cachePath;
+
+	std::vector<char> data;
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (file.is_open()) {
+		uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+		file.seekg(0);
+
+		FileHeader expected = makeHeader(context, 0);
+		FileHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		bool valid = file.good() &&
+			std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+			header.vendorID == expected.vendorID &&
+			header.deviceID == expected.deviceID &&
+			header.driverVersion == expected.driverVersion &&
+			std::memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+		// save writes the header & exactly dataSize bytes, anything else is a truncated or corrupt file & the
+		// size can't be trusted to allocate
+		bool complete = valid && fileSize >= sizeof(header) && header.dataSize == fileSize - sizeof(header);
+
+		if (complete) {
+			data.resize(header.dataSize);
+			file.read(data.data(), data.size());
+			if (!file.good()) {
+				data.clear();
+				complete = false;
+			}
+		}
+
+		if (complete) {
+			std::cout << "Loaded pipeline cache: " << data.size() << " bytes" << std::endl;
+		} else if (!valid) {
+			std::cout << "Ignoring pipeline cache " << path << ", it's from another device or driver" << std::endl;
+		} else {
+			std::cout << "Ignoring pipeline cache " << path << ", it's truncated or corrupt" << std::endl;
+		}
+	}
+
+	vk::PipelineCacheCreateInfo createInfo{
+		.initialDataSize = data.size(),
+		.pInitialData = data.empty() ? nullptr : data.data(),
+	};
+
+	try {
+		cache = vk::raii::PipelineCache(context.getDevice(), createInfo);
+	}
+	catch (const vk::SystemError& e) {
+		// the driver is allowed to reject the data, start over with an empty cache
+		std::cout << "Pipeline cache rejected by the driver: " << e.what() << std::endl;
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+		cache = vk::raii::PipelineCache(context.getDevice(), createInfo);
+	}
+}
+
+void PipelineCache::save(VulkanContext& context) const {
+	if (!*cache || path.empty()) {
+		return;
+	}
+
+	std::vector<uint8_t> data = cache.getData();
+	FileHeader header = makeHeader(context, data.size());
+
+	// write to a temporary file first, a crash halfway through shouldn't leave a broken cache behind
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cout << "Failed to write pipeline cache to " << tempPath << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!file.good()) {
+			std::cout << "Failed to write pipeline cache to " << tempPath << std::endl;
+			return;
+		}
+	}
+
+	std::remove(path.c_str());
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+		std::cout << "Failed to move pipeline cache to " << path << std::endl;
+		return;
+	}
+
+	std::cout << "Saved pipeline cache: " << data.size() << " bytes" << std::endl;
+}
+
+void PipelineCache::destroy() {
+	cache = nullptr;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <string>
+
+#include "context.hpp"
+
+// Wraps a VkPipelineCache that persists between runs, so driver shader compilation is only paid once.
+// The file is prefixed with the vendor, device, driver version & cache UUID it was created with,
+// a file from another device or driver is ignored and the cache starts out empty.
+class PipelineCache {
+public:
+	PipelineCache() = default;
+	~PipelineCache() = default;
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	void load(VulkanContext& context, const std::string& path);
+	// writes the current contents, including pipelines created since load
+	void save(VulkanContext& context) const;
+	void destroy();
+
+	const vk::raii::PipelineCache& get() const { return cache; }
+
+private:
+	struct FileHeader {
+		char magic[8];
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+	};
+
+	vk::raii::PipelineCache cache = nullptr;
+	std::string path;
+
+	static FileHeader makeHeader(VulkanContext& context, uint64_t dataSize);
+};
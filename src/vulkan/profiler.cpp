@@ -0,0 +1,173 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+void GpuProfiler::create(VulkanContext& context, uint32_t framesInFlight, uint32_t maxScopesPerFrame, size_t history) {
+    maxScopes = maxScopesPerFrame;
+    historySize = history;
+    frames.assign(framesInFlight, FrameSlot{});
+    currentFrame = 0;
+
+    const vk::raii::PhysicalDevice& physicalDevice = context.getPhysicalDevice();
+    vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+    auto queueFamilies = physicalDevice.getQueueFamilyProperties();
+    uint32_t validBits = queueFamilies[context.getGraphicsQueueIndex()].timestampValidBits;
+
+    if (validBits == 0 || properties.limits.timestampPeriod <= 0.0f) {
+        std::cout << "GPU profiler disabled, graphics queue has no timestamp support" << std::endl;
+        enabled = false;
+        return;
+    }
+
+    timestampPeriodNs = properties.limits.timestampPeriod;
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    vk::QueryPoolCreateInfo poolInfo{
+        .queryType = vk::QueryType::eTimestamp,
+        .queryCount = framesInFlight * maxScopes * 2,
+    };
+    queryPool = vk::raii::QueryPool(context.getDevice(), poolInfo);
+    enabled = true;
+}
+
+void GpuProfiler::destroy() {
+    queryPool = nullptr;
+    frames.clear();
+    passes.clear();
+    enabled = false;
+}
+
+void GpuProfiler::beginFrame(const vk::raii::CommandBuffer& cmd, uint32_t frameIndex) {
+    if (!enabled) return;
+
+    currentFrame = frameIndex % frames.size();
+    collect(currentFrame);
+
+    cmd.resetQueryPool(*queryPool, currentFrame * maxScopes * 2, maxScopes * 2);
+    frames[currentFrame].scopes.clear();
+}
+
+uint32_t GpuProfiler::beginScope(const vk::raii::CommandBuffer& cmd, const std::string& name) {
+    if (!enabled) return invalidScope;
+
+    FrameSlot& frame = frames[currentFrame];
+    if (frame.scopes.size() >= maxScopes) {
+        return invalidScope; // out of queries, this scope goes unmeasured
+    }
+
+    uint32_t firstQuery = (currentFrame * maxScopes + frame.scopes.size()) * 2;
+    frame.scopes.push_back(ScopeRecord{ .pass = findPass(name), .firstQuery = firstQuery });
+    frame.pending = true;
+
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *queryPool, firstQuery);
+    return frame.scopes.size() - 1;
+}
+
+void GpuProfiler::endScope(const vk::raii::CommandBuffer& cmd, uint32_t scope) {
+    if (!enabled || scope == invalidScope) return;
+
+    const ScopeRecord& record = frames[currentFrame].scopes[scope];
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *queryPool, record.firstQuery + 1);
+}
+
+void GpuProfiler::collect(uint32_t frameIndex) {
+    FrameSlot& frame = frames[frameIndex];
+    if (!frame.pending || frame.scopes.empty()) {
+        return;
+    }
+    frame.pending = false;
+
+    uint32_t firstQuery = frameIndex * maxScopes * 2;
+    uint32_t queryCount = frame.scopes.size() * 2;
+
+    // no wait flag, the frame's fence has signaled so the results are there. If they somehow aren't,
+    // dropping one frame of samples beats stalling the CPU.
+    auto [result, timestamps] = queryPool.getResults<uint64_t>(
+        firstQuery, queryCount, queryCount * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        return;
+    }
+
+    for (const ScopeRecord& record : frame.scopes) {
+        uint64_t begin = timestamps[record.firstQuery - firstQuery] & timestampMask;
+        uint64_t end = timestamps[record.firstQuery - firstQuery + 1] & timestampMask;
+        uint64_t ticks = (end - begin) & timestampMask;
+        addSample(passes[record.pass].name, double(ticks) * timestampPeriodNs * 1e-6);
+    }
+}
+
+uint32_t GpuProfiler::findPass(const std::string& name) {
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        if (passes[i].name == name) {
+            return i;
+        }
+    }
+
+    passes.push_back(PassHistory{ .name = name, .samples = std::vector<double>(historySize) });
+    return passes.size() - 1;
+}
+
+void GpuProfiler::addSample(const std::string& name, double milliseconds) {
+    if (historySize == 0) return;
+
+    PassHistory& pass = passes[findPass(name)];
+    pass.samples[pass.next] = milliseconds;
+    pass.next = (pass.next + 1) % historySize;
+    pass.count = std::min(pass.count + 1, historySize);
+    pass.last = milliseconds;
+}
+
+GpuPassStats GpuProfiler::computeStats(const PassHistory& pass) const {
+    GpuPassStats stats{ .name = pass.name, .last = pass.last, .samples = pass.count };
+    if (pass.count == 0) {
+        return stats;
+    }
+
+    std::vector<double> sorted(pass.samples.begin(), pass.samples.begin() + pass.count);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (double sample : sorted) sum += sample;
+
+    size_t p99Index = std::min(sorted.size() - 1, size_t(std::ceil(sorted.size() * 0.99)) - 1);
+
+    stats.min = sorted.front();
+    stats.avg = sum / sorted.size();
+    stats.p99 = sorted[p99Index];
+    return stats;
+}
+
+GpuPassStats GpuProfiler::getStats(const std::string& name) const {
+    for (const PassHistory& pass : passes) {
+        if (pass.name == name) {
+            return computeStats(pass);
+        }
+    }
+    return GpuPassStats{ .name = name };
+}
+
+std::vector<GpuPassStats> GpuProfiler::getAllStats() const {
+    std::vector<GpuPassStats> stats;
+    stats.reserve(passes.size());
+    for (const PassHistory& pass : passes) {
+        stats.push_back(computeStats(pass));
+    }
+    return stats;
+}
+
+std::string GpuProfiler::summary() const {
+    if (passes.empty()) {
+        return enabled ? "GPU (ms min/avg/p99): no samples yet" : "GPU profiler disabled";
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3) << "GPU (ms min/avg/p99):";
+    for (const GpuPassStats& stats : getAllStats()) {
+        out << " | " << stats.name << " " << stats.min << "/" << stats.avg << "/" << stats.p99;
+    }
+    return out.str();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "context.hpp"
+
+// Timing statistics for one pass over the recorded history, in milliseconds
+struct GpuPassStats {
+    std::string name;
+    double last = 0.0;
+    double min = 0.0;
+    double avg = 0.0;
+    double p99 = 0.0;
+    size_t samples = 0;
+};
+
+// GpuProfiler records timestamp queries around passes in the frame command buffer.
+// Every frame in flight has its own slice of the query pool, results of a slice are read back
+// the next time that frame index comes around, after its fence was waited on, so reading never stalls.
+// Works on any device with timestamp support on the graphics queue (including lavapipe),
+// and turns itself into a no-op everywhere else.
+class GpuProfiler {
+public:
+    GpuProfiler() = default;
+    ~GpuProfiler() = default;
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    void create(VulkanContext& context, uint32_t framesInFlight, uint32_t maxScopesPerFrame = 32, size_t historySize = 240);
+    void destroy();
+
+    bool isEnabled() const { return enabled; }
+
+    // Call first thing in a frame's command buffer, after the frame's fence was waited on.
+    // Collects the results this frame slot recorded last time & resets its queries.
+    void beginFrame(const vk::raii::CommandBuffer& cmd, uint32_t frameIndex);
+
+    // Timestamps around the commands recorded in between, returns the scope id for endScope
+    uint32_t beginScope(const vk::raii::CommandBuffer& cmd, const std::string& name);
+    void endScope(const vk::raii::CommandBuffer& cmd, uint32_t scope);
+
+    // RAII helper, ends the scope when it goes out of scope
+    class Scope {
+    public:
+        Scope(GpuProfiler& profiler, const vk::raii::CommandBuffer& cmd, const std::string& name)
+            : profiler(profiler), cmd(cmd), scope(profiler.beginScope(cmd, name)) {}
+        ~Scope() { profiler.endScope(cmd, scope); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        GpuProfiler& profiler;
+        const vk::raii::CommandBuffer& cmd;
+        uint32_t scope;
+    };
+
+    // Adds a timing measured elsewhere (e.g. one-off upload submissions) to a pass' history
+    void addSample(const std::string& name, double milliseconds);
+
+    GpuPassStats getStats(const std::string& name) const;
+    // all passes, in the order they were first recorded
+    std::vector<GpuPassStats> getAllStats() const;
+
+    // One line with min/avg/p99 per pass, for the periodic log print
+    std::string summary() const;
+
+private:
+    static constexpr uint32_t invalidScope = UINT32_MAX;
+
+    struct PassHistory {
+        std::string name;
+        std::vector<double> samples; // ring buffer
+        size_t next = 0;
+        size_t count = 0;
+        double last = 0.0;
+    };
+
+    struct ScopeRecord {
+        uint32_t pass;
+        uint32_t firstQuery;
+    };
+
+    struct FrameSlot {
+        std::vector<ScopeRecord> scopes;
+        bool pending = false; // queries were written & not yet read back
+    };
+
+    vk::raii::QueryPool queryPool = nullptr;
+    bool enabled = false;
+
+    uint32_t maxScopes = 0;
+    size_t historySize = 0;
+    double timestampPeriodNs = 1.0;
+    uint64_t timestampMask = ~0ull;
+
+    std::vector<FrameSlot> frames;
+    uint32_t currentFrame = 0;
+
+    std::vector<PassHistory> passes;
+
+    uint32_t findPass(const std::string& name);
+    void collect(uint32_t frameIndex);
+    GpuPassStats computeStats(const PassHistory& pass) const;
+};
@@ -1,12 +1,22 @@
 #include "swapchain.hpp"
 #include <iostream>
 
+const char* getPresentPathName(PresentPath path) {
+    switch (path) {
+        case PresentPath::Storage: return "storage";
+        case PresentPath::Blit: return "blit";
+        case PresentPath::Raster: return "raster";
+    }
+    return "unknown";
+}
+
 SwapChainManager::~SwapChainManager() {
     cleanupSwapChain();
 }
 
-void SwapChainManager::init(VulkanContext& ctx, int width, int height, VkSurfaceKHR surface) {
+void SwapChainManager::init(VulkanContext& ctx, int width, int height, VkSurfaceKHR surface, PresentPath preferred) {
     this->surface = surface;
+    preferredPresentPath = preferred;
 
     std::cout << "creating swapchain" << std::endl;
     createSwapChain(ctx, width, height);
@@ -29,6 +39,35 @@ void SwapChainManager::createSwapChain(VulkanContext& ctx, int width, int height
         }
     }
 
+    vk::ImageUsageFlags imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+    presentPath = PresentPath::Raster;
+
+    // sRGB formats can't be storage images, the present pass encodes sRGB itself into a UNORM one
+    if (preferredPresentPath == PresentPath::Storage && ctx.supportsStorageWriteWithoutFormat() &&
+        (capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eStorage)) {
+        for (const auto& format : formats) {
+            bool unorm = format.format == vk::Format::eB8G8R8A8Unorm || format.format == vk::Format::eR8G8B8A8Unorm;
+            if (unorm && format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear &&
+                (ctx.getPhysicalDevice().getFormatProperties(format.format).optimalTilingFeatures &
+                    vk::FormatFeatureFlagBits::eStorageImage)) {
+                swapChainSurfaceFormat = format;
+                imageUsage |= vk::ImageUsageFlagBits::eStorage;
+                presentPath = PresentPath::Storage;
+                break;
+            }
+        }
+    }
+    // the blit converts to sRGB on its own
+    if (presentPath == PresentPath::Raster && preferredPresentPath != PresentPath::Raster &&
+        (capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst) &&
+        (ctx.getPhysicalDevice().getFormatProperties(swapChainSurfaceFormat.format).optimalTilingFeatures &
+            vk::FormatFeatureFlagBits::eBlitDst)) {
+        imageUsage |= vk::ImageUsageFlagBits::eTransferDst;
+        presentPath = PresentPath::Blit;
+    }
+    std::cout << "present path: " << getPresentPathName(presentPath) << " (" << vk::to_string(swapChainSurfaceFormat.format)
+        << ")" << std::endl;
+
     swapChainExtent = {
         std::clamp(static_cast<uint32_t>(width), capabilities.minImageExtent.width, capabilities.maxImageExtent.width),
         std::clamp(static_cast<uint32_t>(height), capabilities.minImageExtent.height, capabilities.maxImageExtent.height)
@@ -44,7 +83,7 @@ void SwapChainManager::createSwapChain(VulkanContext& ctx, int width, int height
         .imageColorSpace = swapChainSurfaceFormat.colorSpace,
         .imageExtent = swapChainExtent,
         .imageArrayLayers = 1,
-        .imageUsage = vk::ImageUsageFlagBits::eColorAttachment,
+        .imageUsage = imageUsage,
         .imageSharingMode = vk::SharingMode::eExclusive,
         .preTransform = capabilities.currentTransform,
         .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
@@ -7,12 +7,25 @@
 
 #include "context.hpp"
 
+// How the compute image gets into the swapchain image, in order of preference
+enum class PresentPath {
+    // a compute pass writes straight into swapchain images created with storage usage
+    Storage,
+    // vkCmdBlitImage scales & converts the compute image into the swapchain image
+    Blit,
+    // a fullscreen quad samples the compute image, works with any surface
+    Raster,
+};
+
+const char* getPresentPathName(PresentPath path);
+
 class SwapChainManager {
 public:
 	SwapChainManager() = default;
     ~SwapChainManager();
 
-    void init(VulkanContext& ctx, int width, int height, VkSurfaceKHR surface);
+    // preferred is used if the surface & device support it, otherwise the next path that they do
+    void init(VulkanContext& ctx, int width, int height, VkSurfaceKHR surface, PresentPath preferred = PresentPath::Storage);
 
     void createSwapChain(VulkanContext& ctx, int width, int height);
     void recreateSwapChain(VulkanContext& ctx, int width, int height);
@@ -24,6 +37,7 @@ public:
     const std::vector<vk::raii::ImageView>& getSwapChainImageViews() const;
     vk::SurfaceFormatKHR getSwapChainSurfaceFormat();
     vk::Extent2D getSwapChainExtent();
+    PresentPath getPresentPath() const { return presentPath; }
 
 private:
 	vk::raii::SwapchainKHR swapChain = nullptr;
@@ -31,6 +45,8 @@ private:
 	vk::SurfaceFormatKHR swapChainSurfaceFormat;
 	vk::Extent2D swapChainExtent;
 	std::vector<vk::raii::ImageView> swapChainImageViews;
+    PresentPath preferredPresentPath = PresentPath::Storage;
+    PresentPath presentPath = PresentPath::Raster;
 
     VkSurfaceKHR surface = VK_NULL_HANDLE; // non-owning handle to the surface
 };
@@ -37,8 +37,10 @@ public:
     const vk::raii::Semaphore& getCurrentPresentSemaphore() const {
         return presentCompleteSemaphores[semaphoreIndex];
     }
-    const vk::raii::Semaphore& getCurrentRenderSemaphore() const {
-        return renderFinishedSemaphores[semaphoreIndex];
+    // The render semaphore is waited on by present, which only finishes once the image is acquired again.
+    // With more than 1 frame in flight it has to belong to the swapchain image, not the frame.
+    const vk::raii::Semaphore& getRenderSemaphore(uint32_t imageIndex) const {
+        return renderFinishedSemaphores[imageIndex];
     }
 
 private: